@@ -21,17 +21,175 @@
 #  endif
 #endif
 
+/* Barriers.
+ *
+ * rbarr()/wbarr()/rwbarr() are the explicit barriers of the public API.
+ *
+ * MMIO_PRE_READ(), MMIO_POST_READ(V) and MMIO_PRE_WRITE() give the ordering
+ * implied by each (non-relaxed) read or write.  A read completes before
+ * any following access to normal memory (eg. a DMA buffer the read status
+ * says is ready).  A write is preceded by any earlier writes to normal memory
+ * (eg. a DMA descriptor the written doorbell points to).
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__SSE2__))
+
+/* Uncached accesses are not reordered with each other or with normal memory,
+ * so the implied ordering only needs to stop the compiler.
+ * sfence is still needed to flush write combining buffers.
+ */
+#  define rbarr()  __asm__ __volatile__ ("lfence" ::: "memory")
+#  define wbarr()  __asm__ __volatile__ ("sfence" ::: "memory")
+#  define rwbarr() __asm__ __volatile__ ("mfence" ::: "memory")
+
+#  define MMIO_PRE_READ()   do{}while(0)
+#  define MMIO_POST_READ(V) __asm__ __volatile__ ("" ::: "memory")
+#  define MMIO_PRE_WRITE()  __asm__ __volatile__ ("" ::: "memory")
+
+#elif defined(__GNUC__) && defined(__aarch64__)
+
+/* Device memory accesses to one device are kept in order,
+ * but not with respect to normal memory.
+ */
+#  define rbarr()  __asm__ __volatile__ ("dsb ld" ::: "memory")
+#  define wbarr()  __asm__ __volatile__ ("dsb st" ::: "memory")
+#  define rwbarr() __asm__ __volatile__ ("dsb sy" ::: "memory")
+
+#  define MMIO_PRE_READ()   do{}while(0)
+#  define MMIO_POST_READ(V) __asm__ __volatile__ ("dmb oshld" ::: "memory")
+#  define MMIO_PRE_WRITE()  __asm__ __volatile__ ("dmb oshst" ::: "memory")
+
+#elif defined(__GNUC__) && (defined(__powerpc__) || defined(__PPC__) || defined(_ARCH_PPC))
+
+/* As with the Linux kernel in_*()/out_*().  The trap which is never taken
+ * depends on the value read, so the isync waits for the read to complete.
+ */
+#  define rbarr()  __asm__ __volatile__ ("sync" ::: "memory")
+#  define wbarr()  __asm__ __volatile__ ("sync" ::: "memory")
+#  define rwbarr() __asm__ __volatile__ ("sync" ::: "memory")
+
+#  define MMIO_PRE_READ()   __asm__ __volatile__ ("sync" ::: "memory")
+#  define MMIO_POST_READ(V) __asm__ __volatile__ ("twi 0,%0,0; isync" :: "r"(V) : "memory")
+#  define MMIO_PRE_WRITE()  __asm__ __volatile__ ("sync" ::: "memory")
+
+#elif defined(__GNUC__)
+
+/* Unknown architecture.  A full barrier everywhere. */
+#  define rbarr()  __sync_synchronize()
+#  define wbarr()  __sync_synchronize()
+#  define rwbarr() __sync_synchronize()
+
+#  define MMIO_PRE_READ()   do{}while(0)
+#  define MMIO_POST_READ(V) __sync_synchronize()
+#  define MMIO_PRE_WRITE()  __sync_synchronize()
+
+#else
+
+#  define rbarr()  do{}while(0)
+#  define wbarr()  do{}while(0)
+#  define rwbarr() do{}while(0)
+
+#  define MMIO_PRE_READ()   do{}while(0)
+#  define MMIO_POST_READ(V) do{}while(0)
+#  define MMIO_PRE_WRITE()  do{}while(0)
+
+#endif
+
+/** @brief Defined when the T_ioread#_relaxed and T_iowrite#_relaxed variants are available */
+#define EPICSMMIO_HAS_RELAXED 1
+
 /** @ingroup mmio
  *@{
  */
 
+/** @brief Read a single byte without implied ordering.
+ */
+INLINE
+epicsUInt8
+ioread8_relaxed(volatile void* addr)
+{
+    return *(volatile epicsUInt8*)(addr);
+}
+
+/** @brief Write a single byte without implied ordering.
+ */
+INLINE
+void
+iowrite8_relaxed(volatile void* addr, epicsUInt8 val)
+{
+    *(volatile epicsUInt8*)(addr) = val;
+}
+
+/** @brief Read two bytes in host order without implied ordering.
+ * Not byte swapping
+ */
+INLINE
+epicsUInt16
+nat_ioread16_relaxed(volatile void* addr)
+{
+    return *(volatile epicsUInt16*)(addr);
+}
+
+/** @brief Write two byte in host order without implied ordering.
+ * Not byte swapping
+ */
+INLINE
+void
+nat_iowrite16_relaxed(volatile void* addr, epicsUInt16 val)
+{
+    *(volatile epicsUInt16*)(addr) = val;
+}
+
+/** @brief Read four bytes in host order without implied ordering.
+ * Not byte swapping
+ */
+INLINE
+epicsUInt32
+nat_ioread32_relaxed(volatile void* addr)
+{
+    return *(volatile epicsUInt32*)(addr);
+}
+
+/** @brief Write four byte in host order without implied ordering.
+ * Not byte swapping
+ */
+INLINE
+void
+nat_iowrite32_relaxed(volatile void* addr, epicsUInt32 val)
+{
+    *(volatile epicsUInt32*)(addr) = val;
+}
+
+/** @brief Read eight bytes in host order without implied ordering.
+ * Not byte swapping
+ */
+INLINE
+epicsUInt64
+nat_ioread64_relaxed(volatile void* addr)
+{
+    return *(volatile epicsUInt64*)(addr);
+}
+
+/** @brief Write eight bytes in host order without implied ordering.
+ * Not byte swapping
+ */
+INLINE
+void
+nat_iowrite64_relaxed(volatile void* addr, epicsUInt64 val)
+{
+    *(volatile epicsUInt64*)(addr) = val;
+}
+
 /** @brief Read a single byte.
  */
 INLINE
 epicsUInt8
 ioread8(volatile void* addr)
 {
-    return *(volatile epicsUInt8*)(addr);
+    epicsUInt8 val;
+    MMIO_PRE_READ();
+    val = ioread8_relaxed(addr);
+    MMIO_POST_READ(val);
+    return val;
 }
 
 /** @brief Write a single byte.
@@ -40,7 +198,8 @@ INLINE
 void
 iowrite8(volatile void* addr, epicsUInt8 val)
 {
-    *(volatile epicsUInt8*)(addr) = val;
+    MMIO_PRE_WRITE();
+    iowrite8_relaxed(addr, val);
 }
 
 /** @brief Read two bytes in host order.
@@ -50,7 +209,11 @@ INLINE
 epicsUInt16
 nat_ioread16(volatile void* addr)
 {
-    return *(volatile epicsUInt16*)(addr);
+    epicsUInt16 val;
+    MMIO_PRE_READ();
+    val = nat_ioread16_relaxed(addr);
+    MMIO_POST_READ(val);
+    return val;
 }
 
 /** @brief Write two byte in host order.
@@ -60,7 +223,8 @@ INLINE
 void
 nat_iowrite16(volatile void* addr, epicsUInt16 val)
 {
-    *(volatile epicsUInt16*)(addr) = val;
+    MMIO_PRE_WRITE();
+    nat_iowrite16_relaxed(addr, val);
 }
 
 /** @brief Read four bytes in host order.
@@ -70,7 +234,11 @@ INLINE
 epicsUInt32
 nat_ioread32(volatile void* addr)
 {
-    return *(volatile epicsUInt32*)(addr);
+    epicsUInt32 val;
+    MMIO_PRE_READ();
+    val = nat_ioread32_relaxed(addr);
+    MMIO_POST_READ(val);
+    return val;
 }
 
 /** @brief Write four byte in host order.
@@ -80,9 +248,56 @@ INLINE
 void
 nat_iowrite32(volatile void* addr, epicsUInt32 val)
 {
-    *(volatile epicsUInt32*)(addr) = val;
+    MMIO_PRE_WRITE();
+    nat_iowrite32_relaxed(addr, val);
+}
+
+/** @brief Read eight bytes in host order.
+ * Not byte swapping
+ */
+INLINE
+epicsUInt64
+nat_ioread64(volatile void* addr)
+{
+    epicsUInt64 val;
+    MMIO_PRE_READ();
+    val = nat_ioread64_relaxed(addr);
+    MMIO_POST_READ(val);
+    return val;
+}
+
+/** @brief Write eight bytes in host order.
+ * Not byte swapping
+ */
+INLINE
+void
+nat_iowrite64(volatile void* addr, epicsUInt64 val)
+{
+    MMIO_PRE_WRITE();
+    nat_iowrite64_relaxed(addr, val);
+}
+
+/** @brief Unconditional eight byte swap
+ */
+INLINE
+epicsUInt64
+bswap64(epicsUInt64 value)
+{
+    return (((epicsUInt64)(value) & 0x00000000000000ffull) << 56) |
+           (((epicsUInt64)(value) & 0x000000000000ff00ull) << 40) |
+           (((epicsUInt64)(value) & 0x0000000000ff0000ull) << 24) |
+           (((epicsUInt64)(value) & 0x00000000ff000000ull) << 8)  |
+           (((epicsUInt64)(value) & 0x000000ff00000000ull) >> 8)  |
+           (((epicsUInt64)(value) & 0x0000ff0000000000ull) >> 24) |
+           (((epicsUInt64)(value) & 0x00ff000000000000ull) >> 40) |
+           (((epicsUInt64)(value) & 0xff00000000000000ull) >> 56);
 }
 
+/** @brief Defined when the T_ioread64 and T_iowrite64 operations are available */
+#define EPICSMMIO_HAS_64 1
+
+/** @} */
+
 #if EPICS_BYTE_ORDER == EPICS_ENDIAN_BIG
 
 /** @ingroup mmio
@@ -117,6 +332,26 @@ bswap32(epicsUInt32 value)
 #  define le_iowrite16(A,D) nat_iowrite16(A,bswap16(D))
 #  define le_iowrite32(A,D) nat_iowrite32(A,bswap32(D))
 
+#  define be_ioread16_relaxed(A)    nat_ioread16_relaxed(A)
+#  define be_ioread32_relaxed(A)    nat_ioread32_relaxed(A)
+#  define be_iowrite16_relaxed(A,D) nat_iowrite16_relaxed(A,D)
+#  define be_iowrite32_relaxed(A,D) nat_iowrite32_relaxed(A,D)
+
+#  define le_ioread16_relaxed(A)    bswap16(nat_ioread16_relaxed(A))
+#  define le_ioread32_relaxed(A)    bswap32(nat_ioread32_relaxed(A))
+#  define le_iowrite16_relaxed(A,D) nat_iowrite16_relaxed(A,bswap16(D))
+#  define le_iowrite32_relaxed(A,D) nat_iowrite32_relaxed(A,bswap32(D))
+
+#  define be_ioread64(A)    nat_ioread64(A)
+#  define be_iowrite64(A,D) nat_iowrite64(A,D)
+#  define le_ioread64(A)    bswap64(nat_ioread64(A))
+#  define le_iowrite64(A,D) nat_iowrite64(A,bswap64(D))
+
+#  define be_ioread64_relaxed(A)    nat_ioread64_relaxed(A)
+#  define be_iowrite64_relaxed(A,D) nat_iowrite64_relaxed(A,D)
+#  define le_ioread64_relaxed(A)    bswap64(nat_ioread64_relaxed(A))
+#  define le_iowrite64_relaxed(A,D) nat_iowrite64_relaxed(A,bswap64(D))
+
 /** @} */
 
 #elif EPICS_BYTE_ORDER == EPICS_ENDIAN_LITTLE
@@ -147,6 +382,26 @@ bswap32(epicsUInt32 value)
 #  define le_iowrite16(A,D) nat_iowrite16(A,D)
 #  define le_iowrite32(A,D) nat_iowrite32(A,D)
 
+#  define be_ioread16_relaxed(A)    bswap16(nat_ioread16_relaxed(A))
+#  define be_ioread32_relaxed(A)    bswap32(nat_ioread32_relaxed(A))
+#  define be_iowrite16_relaxed(A,D) nat_iowrite16_relaxed(A,bswap16(D))
+#  define be_iowrite32_relaxed(A,D) nat_iowrite32_relaxed(A,bswap32(D))
+
+#  define le_ioread16_relaxed(A)    nat_ioread16_relaxed(A)
+#  define le_ioread32_relaxed(A)    nat_ioread32_relaxed(A)
+#  define le_iowrite16_relaxed(A,D) nat_iowrite16_relaxed(A,D)
+#  define le_iowrite32_relaxed(A,D) nat_iowrite32_relaxed(A,D)
+
+#  define be_ioread64(A)    bswap64(nat_ioread64(A))
+#  define be_iowrite64(A,D) nat_iowrite64(A,bswap64(D))
+#  define le_ioread64(A)    nat_ioread64(A)
+#  define le_iowrite64(A,D) nat_iowrite64(A,D)
+
+#  define be_ioread64_relaxed(A)    bswap64(nat_ioread64_relaxed(A))
+#  define be_iowrite64_relaxed(A,D) nat_iowrite64_relaxed(A,bswap64(D))
+#  define le_ioread64_relaxed(A)    nat_ioread64_relaxed(A)
+#  define le_iowrite64_relaxed(A,D) nat_iowrite64_relaxed(A,D)
+
 /** @} */
 
 #else
@@ -183,25 +438,32 @@ bswap32(epicsUInt32 value)
 /** @def le_iowrite32
  *  @brief Write four byte in little endian order.
  */
-
-/** @ingroup mmio
- *@{
+/** @def be_ioread64
+ *  @brief Read eight bytes in big endian order.
+ */
+/** @def be_iowrite64
+ *  @brief Write eight bytes in big endian order.
+ */
+/** @def le_ioread64
+ *  @brief Read eight bytes in little endian order.
+ */
+/** @def le_iowrite64
+ *  @brief Write eight bytes in little endian order.
  */
 
-/** @brief Explicit read memory barrier
+/** @def rbarr
+ *  @brief Explicit read memory barrier
  * Prevents reordering of reads around it.
  */
-#define rbarr()  do{}while(0)
-/** @brief Explicit write memory barrier
+/** @def wbarr
+ *  @brief Explicit write memory barrier
  * Prevents reordering of writes around it.
+ * Also flushes write combining buffers.
  */
-#define wbarr()  do{}while(0)
-/** @brief Explicit read/write memory barrier
+/** @def rwbarr
+ *  @brief Explicit read/write memory barrier
  * Prevents reordering of reads or writes around it.
  */
-#define rwbarr() do{}while(0)
-
-/** @} */
 
 /** @defgroup mmio Memory Mapped I/O
  *
@@ -209,7 +471,7 @@ bswap32(epicsUInt32 value)
  *
  *This files defines a set of macros for access to Memory Mapped I/O
  *
- *They are named T_ioread# and T_iowrite# where # can be 8, 16, or 32.
+ *They are named T_ioread# and T_iowrite# where # can be 8, 16, 32, or 64.
  *'T' can either be 'le', 'be', or 'nat' (except ioread8 and
  *iowrite8).
  *
@@ -218,6 +480,7 @@ bswap32(epicsUInt32 value)
  *
  *@li Width.  A 16 bit operation will not be broken into two 8 bit operations,
  *           or one half of a 32 bit operation.
+ *           On 32-bit hosts a 64 bit operation may be broken into two 32 bit operations.
  *
  *@li Order.  Writes to two different registers will not be reordered.
  *           This only applies to MMIO operations, not between MMIO and
@@ -271,6 +534,20 @@ bswap32(epicsUInt32 value)
  *Software accessing VME must @b not do conditional swapping.
  *
  *@note All read and write operations have an implicit read or write barrier.
+ *
+ *@section mmiorelax Relaxed operations
+ *
+ *T_ioread#_relaxed and T_iowrite#_relaxed are the same operations without
+ *the implicit barrier.  They may be reordered with respect to normal memory,
+ *and on some architectures (eg. PowerPC) with respect to other relaxed operations.
+ *This is useful in loops accessing many registers, where one explicit barrier
+ *at the end is sufficient.
+ *
+ @code
+  for(i=0; i<N; i++)
+      buf[i] = le_ioread32_relaxed(base+4*i);
+  rbarr();
+ @endcode
  */
 
 #endif /* EPICSMMIODEF_H */
@@ -179,5 +179,22 @@ void sysPciOutLong (UINT32 *addr, UINT32 data);
 #define wbarr()  VX_MEM_BARRIER_W()
 #define rwbarr() VX_MEM_BARRIER_RW()
 
+/* No cheaper unordered access, so the relaxed operations are the same */
+#define EPICSMMIO_HAS_RELAXED 1
+#define ioread8_relaxed           ioread8
+#define iowrite8_relaxed          iowrite8
+#define nat_ioread16_relaxed      nat_ioread16
+#define nat_ioread32_relaxed      nat_ioread32
+#define nat_iowrite16_relaxed     nat_iowrite16
+#define nat_iowrite32_relaxed     nat_iowrite32
+#define be_ioread16_relaxed       be_ioread16
+#define be_ioread32_relaxed       be_ioread32
+#define be_iowrite16_relaxed      be_iowrite16
+#define be_iowrite32_relaxed      be_iowrite32
+#define le_ioread16_relaxed       le_ioread16
+#define le_ioread32_relaxed       le_ioread32
+#define le_iowrite16_relaxed      le_iowrite16
+#define le_iowrite32_relaxed      le_iowrite32
+
 #endif /* CPU_FAMILY */
 #endif /* EPICSMMIO_H */
@@ -33,11 +33,18 @@ myioc_LIBS += explorepci epicspci
 @b INP/OUT link strings may contain the following components
 
 @li "bar=#" (default: 0)
-@li "offset=#" in bytes (default: 0)
-@li "mask=#" bit mask (default: 0 aka. no mask)
+@li "offset=#" in bytes, up to 64-bit for BARs of 4GB or larger (default: 0)
+@li "mask=#" bit mask, up to 64-bit (default: 0 aka. no mask)
 @li "shift=#" in bits (default: 0)
 @li "step=#" in bytes (default: read size.  eg Read32 defaults to step=4)
 @li "initread=1|0" bool (default: 1 for .OUT recordtypes, 0 otherwise)
+@li "block=name" read through a snapshot shared with other records (default: none) @ref exploreblock
+@li "async=1|0" access the device from a worker thread (default: 0) @ref exploreasync
+@li "wc=1|0" use a write-combining mapping of the BAR, if available (default: 0).  See DEVLIB_MAP_WC.
+    Every write is followed by a write barrier, which flushes the write-combining buffer.
+@li "aslo=#" slope for waveform FTVL=DOUBLE (default: 1.0) @ref exploredouble
+@li "aoff=#" offset for waveform FTVL=DOUBLE (default: 0.0)
+@li "signed=1|0" registers hold two's complement values, for waveform FTVL=DOUBLE (default: 0)
 
 
 For record types: @b longout, @b bo, @b mbbo, @b mbboDirect, @b ao
@@ -65,17 +72,80 @@ The @b ao record type also accepts
 
 @li Explore WriteF32 LSB
 @li Explore WriteF32 MSB
+@li Explore WriteF64 LSB
+@li Explore WriteF64 MSB
 
 The @b ai record type also accepts
 
 @li Explore ReadF32 LSB
 @li Explore ReadF32 MSB
+@li Explore ReadF64 LSB
+@li Explore ReadF64 MSB
+
+With EPICS Base >=3.16.1, and exploreSupport64.dbd added to the IOC,
+the @b int64in and @b int64out record types accept all of the above integer Read or Write @b DTYP, and also
+
+@li Explore Read64 NAT
+@li Explore Read64 LSB
+@li Explore Read64 MSB
+@li Explore Write64 NAT
+@li Explore Write64 LSB
+@li Explore Write64 MSB
+
+These access the register with a single 64-bit operation, which is one PCIe transaction on 64-bit hosts,
+so a counter or timestamp is read consistently.  @b block= is not supported with 64-bit registers.
 
 The @b waveform record type accepts both integer Read and Write @b DTYP.
+FTVL=INT64 and UINT64 are supported with EPICS Base >=3.16.1, and are intended for use with the 64-bit @b DTYP.
 The @b step= link option may be applied to change how the address counter is incremented.
 The default step size is the read size (eg. 4 for Read32).
 A step size of 0 will read the base address @b NELM times.
 
+The @b aai record type accepts the integer Read @b DTYP, and @b aao the integer Write @b DTYP,
+with the same options and FTVL as @b waveform.
+With @b async=1 an @b aai record keeps a second buffer, which the worker fills.
+On completion this buffer is exchanged with BPTR instead of being copied, which avoids
+a second copy of large captures.  With EPICS Base older than 3.16.1 the buffer is copied into BPTR.
+
+@subsection exploredouble Waveform FTVL=DOUBLE
+
+With FTVL=DOUBLE integer registers are converted to and from engineering units.
+eg. to read a buffer of signed 16-bit ADC samples as volts.
+
+@code
+record(waveform, "$(P)adc") {
+  field(DTYP, "Explore Read16 LSB")
+  field(INP , "@$(DEV) bar=1 offset=0x1000 signed=1 aslo=3.0517578125e-4 aoff=0")
+  field(NELM, "4096")
+  field(FTVL, "DOUBLE")
+}
+@endcode
+
+A read stores VAL = raw*aslo + aoff.  A write stores raw = (VAL-aoff)/aslo, rounded to the nearest integer,
+and clipped to the range of the field.  NaN is written as 0.
+With @b mask= and/or @b shift= the field is the bits selected by them,
+and with @b signed=1 its highest bit is the sign bit.  eg. "mask=0xfff0 shift=4 signed=1" is a signed 12-bit field.
+
+Unlike FTVL=FLOAT, which copies the bits of 32-bit float registers, FTVL=DOUBLE always converts a numeric value.
+
+@section exploreblock Shared snapshot
+
+Input records on the same device and BAR which give the same @b block= name
+share one snapshot.  Only the member registers are read, each with the width of its @b DTYP,
+and adjacent members of the same width are read as a single burst.
+Each record decodes its value from the snapshot.
+The snapshot is refreshed when a member processes and has already used the current snapshot,
+so members should have the same @b SCAN rate.
+Not supported for output records, or for @b waveform and @b aai records.
+
+@section exploreasync Asynchronous access
+
+With @b async=1 a record queues its device access to a worker thread,
+and completes processing (@b PACT cleared) once the access is done.
+There is one worker thread for each device, so accesses to a device are done in order,
+and a slow device does not hold up scan threads or other devices.
+The @b initread= access is always synchronous.
+
 @section exploreirq PCI Interrupt
 
 Limited support of PCI interrupts is available on Linux only.
@@ -84,6 +154,50 @@ will be processed each time an interrupt occurs.
 
 This requires that a UIO kernel module be installed.
 
+@section explorepcie PCI Express Status
+
+Records with DTYP="Explore PCIe" report the link and error status of a PCI Express device,
+read from its configuration space.  @b longin and @b bi record types are supported.
+
+@code
+record(longin, "$(P)LinkWidth") {
+  field(DTYP, "Explore PCIe")
+  field(INP , "@8:0.0 param=width")
+  field(SCAN, "1 second")
+  field(LOLO, "8")
+  field(LLSV, "MAJOR")
+}
+record(bi, "$(P)LinkDegraded") {
+  field(DTYP, "Explore PCIe")
+  field(INP , "@8:0.0 param=degraded")
+  field(SCAN, "1 second")
+  field(OSV , "MAJOR")
+}
+@endcode
+
+@b param= is one of:
+
+@li "speed" Current link speed.  1 is 2.5 GT/s (Gen1), 2 is 5 GT/s, 3 is 8 GT/s, etc.
+@li "width" Negotiated link width.  eg. 8 for x8
+@li "maxspeed", "maxwidth" Capability of the device
+@li "degraded" 1 when the link is slower or narrower than the capability of the device
+@li "devsta", "linksta" Raw Device and Link Status registers
+@li "correrr", "nonfatalerr", "fatalerr" Error detected bits of the Device Status register
+@li "cor", "uncor" Raw AER Correctable and Uncorrectable Error Status registers
+@li "fatal" AER Uncorrectable Error Status bits whose Severity bit is set (fatal errors)
+@li "corcnt", "uncorcnt" Count of AER error status bits seen set
+
+Note that "degraded" is also set when a device is in a slot which is slower or narrower than the device.
+
+All records of one device share a single block read of configuration space, and the decoding of it.
+As with @ref exploreblock the read is repeated when a record has already seen the current result,
+so records of one device should have the same @b SCAN rate.
+
+Error status bits stay set until cleared.
+By default they are not cleared, and the counters only count bits which were not set on the previous read.
+With @b clear=1 on any record of a device, status bits found set are cleared after each read,
+and are counted again when the device next reports the same error.
+
 @section explorefrib FRIB Specific
 
 The DTYP="Explore FRIB Flash" support implements a FRIB specific protocol
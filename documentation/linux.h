@@ -39,6 +39,89 @@ Also, devices supporting version 2.3 or greater of PCI standard can make use
 of the standard master interrupt enable/status bits in the control and status
 registers.
 
+@section linuxenum Device enumeration
+
+During initialization all devices under /sys/bus/pci/devices are listed.
+By default every attribute of each device is read at this time.
+With many devices, startup may be faster by setting, before the first PCI search,
+
+@code
+var devPCIEnumThreads 4
+@endcode
+
+Then only the vendor, device, subsystem, and class IDs are read, using up to this many threads.
+The IRQ, BARs, and driver name of a device are read when it is first found by a search.
+
+The device table may also be saved to a file, and loaded on the next start instead of reading sysfs.
+This is enabled by setting an environment variable before the first PCI search.
+
+@code
+epicsEnvSet("DEVLIB2_PCI_CACHE", "/var/tmp/ioc-pci.cache")
+@endcode
+
+The file is used only if the current boot id, the listings of /sys/bus/pci/devices and /sys/bus/pci/slots,
+and for each device the BAR assignments, bound driver, and creation of its sysfs entries
+match those recorded when it was written.  Otherwise the bus is enumerated and the file replaced.
+So the file is not used after a device is re-scanned, eg. following an FPGA reload, or bound to another driver.
+devPCIRescan() removes the file.
+
+For testing, all paths under /sys and /dev may be prefixed by setting $DEVLIB2_PCI_ROOT.
+The testApp/pcienumbench program generates synthetic trees with this layout,
+and times initialization, searches, and devPCIShow() with 10 to 5000 devices.
+
+@code
+pcienumbench            # 10, 100, 1000, 5000 devices
+pcienumbench -t 4 1000  # with devPCIEnumThreads=4
+pcienumbench -g /tmp/fakepci 100
+DEVLIB2_PCI_ROOT=/tmp/fakepci lspcix
+@endcode
+
+@section linuxisr Interrupt dispatch
+
+By default one thread is created for each device with connected ISRs,
+which waits for interrupts on the /dev/uio# file of the device
+and calls every ISR of that device for each interrupt.
+Disconnecting the last ISR of a device stops its thread without waiting
+for another interrupt.
+With many devices, a pool of threads may instead wait for interrupts
+from all devices by setting, before any ISR is connected,
+
+@code
+var devPCIISRThreads 2
+@endcode
+
+The ISRs of one device are never called concurrently,
+and are called in the order they were connected.
+
+By default each ISR is called with epicsInterruptLock() held,
+which on Linux is a single process-wide lock.
+An ISR connected with the DEVLIB_ISR_DEVLOCK option is instead only serialized
+with other ISRs of the same device, so that ISRs of different devices may run in parallel.
+
+@section linuxhotplug Hotplug
+
+Devices added or removed after initialization, eg. by PCIe hotplug or a Thunderbolt enclosure,
+are found by an explicit rescan, from code or the IOC shell.
+
+@code
+devPCIRescan
+@endcode
+
+Only the changes are read.  Devices which are still present keep their entries,
+so previously found epicsPCIDevice pointers stay valid.
+A removed device can no longer be found or have ISRs connected.
+Its entry is kept, but interrupts are no longer waited for.
+
+Rescan may instead be automatic by setting, before the first PCI search,
+
+@code
+var devPCIHotplug 1
+@endcode
+
+A thread then listens for kernel uevents, and rescans once a burst of PCI add or remove events has ended.
+Code which must react to a change registers a callback with devPCIHotplugRegister().
+It is called after each rescan with every device added or removed.
+
 @section udev UDEV rules
 
 To allow IOCs to run with minimal privlages it is advisable to change the permissions
@@ -51,6 +134,14 @@ When attempting to make use of a PCI devices, devlib2 will attempt to access sev
 
 The "resource*" files exist one for each BAR.
 devPCIToLocalAddr() will first attempt to open the corresponding file.
+devPCIMapWindow() maps only the pages of this file which cover the requested window.
+As "/dev/uio#" can only map whole regions, without this file the whole BAR is mapped.
+
+@li /sys/bus/pci/devices/000:BB:DD.F/resource#_wc
+
+Exists for prefetchable BARs.
+When the DEVLIB_MAP_WC flag is given devPCIToLocalAddr() will first attempt to map this file,
+and fall back to the normal mapping if it can not.
 
 @li /sys/bus/pci/devices/000:BB:DD.F/uio:uio#  (Linux <= 2.6.28)
 @li /sys/bus/pci/devices/000:BB:DD.F/uio/uio#  (Linux >= 2.6.32)
@@ -92,6 +183,27 @@ udevadm test -a add /bus/pci/devices/0000:0b:00.0
 udevadm test -a add $(udevadm info -q path -n /dev/uio0)
 @endcode
 
+@section linuxsim Simulated PCI bus
+
+For testing without hardware, the "sim" bus driver presents devices listed in a description file.
+Each BAR is backed by shared memory, and interrupts are injected from software.
+
+@code
+# [domain:]bus:device.function key=value ...
+1:0.0 vendor=0x10ee device=0x7011 class=0xff0000 bar0=0x1000 bar2=0x100000 slot=3
+@endcode
+
+Load one or more files, and select the driver, before iocInit.
+
+@code
+devLibPCISimLoad("sim.txt")
+devLibPCIUse("sim")
+@endcode
+
+An interrupt is injected with "devLibPCISimInterrupt('1:0.0')" from the shell,
+devLibPCISimInterrupt(),
+or by writing a count to the eventfd returned by devLibPCISimEventFD().
+
 @section linuxrefs References
 
 More information on writing UIO kernel modules can be found:
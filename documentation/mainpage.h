@@ -84,6 +84,13 @@ the width and order of accesses.
 
 @li @ref mmio "API Docmentation"
 
+Transfers of many registers, with conversion of byte order,
+are provided by devLibMMIO.h in all versions.
+devLibMMIO.h also provides the relaxed (T_ioread#_relaxed) and 64-bit (T_ioread64)
+single register operations where the epicsMMIO.h in use does not.
+
+@li @ref mmiobulk "Bulk API Documentation"
+
 @section changelog Changelog
 
 @subsection ver2c 2.12 (January 2024)
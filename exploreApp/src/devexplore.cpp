@@ -8,9 +8,15 @@
 #include <stdexcept>
 #include <memory>
 #include <sstream>
+#include <vector>
+#include <map>
+#include <deque>
+#include <set>
+#include <algorithm>
 
 #include <string.h>
 #include <errno.h>
+#include <math.h>
 
 #include <epicsVersion.h>
 #include <epicsStdlib.h>
@@ -30,6 +36,9 @@
 #include <errlog.h>
 #include <epicsMutex.h>
 #include <epicsGuard.h>
+#include <epicsEvent.h>
+#include <epicsThread.h>
+#include <callback.h>
 
 #include <dbCommon.h>
 #include <longoutRecord.h>
@@ -43,12 +52,28 @@
 #include <boRecord.h>
 #include <aoRecord.h>
 #include <waveformRecord.h>
+#include <aaiRecord.h>
+#include <aaoRecord.h>
 #include <devSup.h>
 #include <epicsExport.h>
 
 #include <epicsMMIO.h>
 
+#include "devlibversion.h"
 #include "devLibPCI.h"
+#include "devLibMMIO.h"
+
+// int64in/int64out and INT64/UINT64 waveforms
+#if EPICS_VERSION_INT>=VERSION_INT(3,16,1,0)
+#  define EXPLORE_INT64
+#  include <int64inRecord.h>
+#  include <int64outRecord.h>
+#endif
+
+// aai record re-reads BPTR on each access, so device support may change it
+#if EPICS_VERSION_INT>=VERSION_INT(3,16,1,0)
+#  define EXPLORE_SWAP_BPTR
+#endif
 
 #define epicsExportSharedSymbols
 #include "devexplore.h"
@@ -59,8 +84,9 @@ epicsShareExtern
 const epicsUInt32 exploreTestSize;
 
 
+// 8 byte aligned for 64-bit registers
 static
-volatile epicsUInt32 exploreTestRegion[1024];
+volatile epicsUInt64 exploreTestRegion[512];
 
 volatile void * const exploreTestBase = (volatile void*)exploreTestRegion;
 const epicsUInt32 exploreTestSize = sizeof(exploreTestRegion);
@@ -72,6 +98,22 @@ union punny32 {
     epicsFloat32 fval;
 };
 
+union punny64 {
+    epicsUInt64 ival;
+    epicsFloat64 fval;
+};
+
+// IEEE float register of a given size
+template<int SIZE> struct realpun;
+template<> struct realpun<4> {
+    static epicsFloat64 get(epicsUInt64 v) { punny32 P; P.ival = (epicsUInt32)v; return P.fval; }
+    static epicsUInt64 put(epicsFloat64 v) { punny32 P; P.fval = (epicsFloat32)v; return P.ival; }
+};
+template<> struct realpun<8> {
+    static epicsFloat64 get(epicsUInt64 v) { punny64 P; P.ival = v; return P.fval; }
+    static epicsUInt64 put(epicsFloat64 v) { punny64 P; P.fval = v; return P.ival; }
+};
+
 // value conversion
 //  cast different integer sizes using C rules
 //  type pun int to/from float
@@ -82,6 +124,9 @@ struct castval<epicsFloat32,FROM> { static epicsFloat32 op(FROM v) {punny32 P; P
 template<typename TO>
 struct castval<TO,epicsFloat32> { static TO op(epicsFloat32 v) {punny32 P; P.fval = v; return P.ival;} };
 
+struct block;
+struct worker;
+
 struct priv {
 
     epicsMutex lock;
@@ -89,7 +134,7 @@ struct priv {
     std::string pciname;
     unsigned bar;
     // offset of first element within BAR
-    epicsUInt32 offset;
+    epicsUInt64 offset;
     // step between elements (waveform only)
     epicsInt32 step;
 
@@ -103,92 +148,510 @@ struct priv {
     } ord;
 
     unsigned vshift;
-    epicsUInt32 vmask;
+    epicsUInt64 vmask;
+
+    // FTVL=DOUBLE conversion.  VAL = raw*aslo + aoff
+    epicsFloat64 aslo, aoff;
+    // raw value is two's complement
+    bool issigned;
 
     volatile void *base;
-    epicsUInt32 barsize;
+    epicsUInt64 barsize;
+    // BAR mapped with write combining (wc=1)
+    bool wc;
 
     bool initread;
 
-    priv() :bar(0u), offset(0u), step(0), valsize(1), ord(NAT), vshift(0u), vmask(0u), base(0), initread(false) {}
+    // shared snapshot, or NULL to read directly
+    block *blk;
+    // generation of the snapshot last used by this record
+    mutable epicsUInt32 blkgen;
+
+    // async=1 requested
+    bool async;
+    // device worker, or NULL to access from the processing thread
+    worker *wrk;
+    CALLBACK cb;
+
+    // Operation run by the worker while PACT is set.
+    // The a* members pass arguments and results between
+    // record processing and the worker.
+    void (*aop)(priv*);
+    epicsUInt64 aval;
+    epicsUInt32 acount;
+    epicsEnum16 aftvl;
+    std::vector<char> abuf;
+    std::string aerr;
+    // aai with async=1.  Second buffer, which the worker fills
+    // while the record holds the first in BPTR.
+    void *spare;
+
+    priv(unsigned vsize, ORD o) :bar(0u), offset(0u), step(vsize), valsize(vsize), ord(o), vshift(0u), vmask(0u)
+      ,aslo(1.0), aoff(0.0), issigned(false), base(0), barsize(0u), wc(false), initread(false), blk(0), blkgen(0u)
+      ,async(false), wrk(0), cb(), aop(0), aval(0u), acount(0u), aftvl(0u), spare(0)
+    {}
+
+    // queue aop to the device worker.  Caller returns with PACT set
+    void start(dbCommon *prec, void (*op)(priv*));
+    // on re-process, re-throw any error from the worker
+    void finish() const
+    {
+        if(!aerr.empty())
+            throw std::runtime_error(aerr);
+    }
+};
 
-    epicsUInt32 readraw(epicsUInt32 off=0) const
+// Performs register access for records with async=1.
+// One thread per PCI device, so that access to a slow device
+// stalls neither the scan threads nor other devices, while
+// access to each device stays in the order requested.
+struct worker : public epicsThreadRunable {
+    epicsMutex lock;
+    epicsEvent wakeup;
+    std::deque<dbCommon*> queue;
+    epicsThread thread;
+
+    explicit worker(const std::string& name)
+        :thread(*this, name.c_str(),
+                epicsThreadGetStackSize(epicsThreadStackSmall),
+                epicsThreadPriorityMedium)
     {
-        volatile char *addr = (volatile char*)base+offset+off;
-        epicsUInt32 OV = -1;
-        switch(valsize) {
-        case 1: OV = ioread8(addr); break;
-        case 2: switch(ord) {
-            case NAT: OV = nat_ioread16(addr); break;
-            case BE:  OV = be_ioread16(addr); break;
-            case LE:  OV = le_ioread16(addr); break;
+        thread.start();
+    }
+    virtual ~worker() {}
+
+    void request(dbCommon *prec)
+    {
+        {
+            Guard G(lock);
+            queue.push_back(prec);
+        }
+        wakeup.signal();
+    }
+
+    virtual void run()
+    {
+        Guard G(lock);
+        while(true) {
+            if(queue.empty()) {
+                UnGuard U(G);
+                wakeup.wait();
+                continue;
+            }
+            dbCommon *prec = queue.front();
+            queue.pop_front();
+
+            UnGuard U(G);
+            priv *pvt = static_cast<priv*>(prec->dpvt);
+            try {
+                Guard P(pvt->lock);
+                pvt->aerr.clear();
+                (*pvt->aop)(pvt);
+            } catch(std::exception& e) {
+                pvt->aerr = e.what();
+                if(pvt->aerr.empty())
+                    pvt->aerr = "Error";
             }
-            break;
-        case 4: switch(ord) {
-            case NAT: OV = nat_ioread32(addr); break;
-            case BE:  OV = be_ioread32(addr); break;
-            case LE:  OV = le_ioread32(addr); break;
+            // PACT stays set until the callback runs, so a full
+            // callback queue must not drop the completion.  Retry.
+            // Equivalent to callbackRequestProcessCallback(), which
+            // does not return a status with all Base versions.
+            callbackSetProcess(&pvt->cb, prec->prio, prec);
+            for(unsigned n=0; callbackRequest(&pvt->cb); n++) {
+                if(n==0)
+                    errlogPrintf("%s: callback queue full, retrying completion\n", prec->name);
+                epicsThreadSleep(0.01);
             }
-            break;
         }
-        return OV;
+    }
+};
+
+void priv::start(dbCommon *prec, void (*op)(priv*))
+{
+    aop = op;
+    prec->pact = 1;
+    wrk->request(prec);
+}
+
+typedef std::map<std::string, worker*> workers_t;
+workers_t workers;
+epicsMutex workersLock;
+
+worker *getWorker(const std::string& pciname)
+{
+    Guard G(workersLock);
+    workers_t::const_iterator it(workers.find(pciname));
+    if(it!=workers.end())
+        return it->second;
+    std::auto_ptr<worker> wrk(new worker("explore:"+pciname));
+    workers[pciname] = wrk.get();
+    return wrk.release();
+}
+
+// A set of registers read together into a snapshot,
+// which is shared by all records naming the same "block=".
+// Only the member registers are read, each with its own width.
+struct block {
+    epicsMutex lock;
+
+    const std::string name;
+    std::string pciname;
+    unsigned bar;
+
+    volatile void *base;
+    epicsUInt64 barsize;
+
+    // window within BAR covering all members.  start is 8 byte aligned
+    epicsUInt64 start, end;
+
+    // distinct member registers, as (offset, size), in order of address
+    typedef std::set<std::pair<epicsUInt64, unsigned> > members_t;
+    members_t members;
+
+    // incremented by each refresh()
+    epicsUInt32 gen;
+    bool valid;
+
+    std::vector<char> storage;
+    // start of window in snapshot.  cache line aligned within storage
+    char *snap;
+
+    enum {CacheLine = 64};
+
+    explicit block(const std::string& name)
+        :name(name), bar(0u), base(0), barsize(0u), start(0u), end(0u), gen(0u), valid(false), snap(0)
+    {}
+
+    // extend window to include a new member
+    void add(const priv *pvt)
+    {
+        Guard G(lock);
+        epicsUInt64 mstart = pvt->offset&~(epicsUInt64)7u,
+                    mend   = pvt->offset+pvt->valsize;
+        if(!base) {
+            pciname = pvt->pciname;
+            bar = pvt->bar;
+            base = pvt->base;
+            barsize = pvt->barsize;
+            start = mstart;
+            end = mend;
+        } else if(pciname!=pvt->pciname || bar!=pvt->bar) {
+            throw std::runtime_error(SB()<<"block "<<name<<" already used with "<<pciname<<" bar="<<bar);
+        } else {
+            if(mstart<start) start = mstart;
+            if(mend>end) end = mend;
+        }
+        if(end>barsize)
+            throw std::runtime_error(SB()<<"block "<<name<<" extends beyond end of bar");
+
+        members.insert(std::make_pair(pvt->offset, pvt->valsize));
+
+        storage.resize(end-start+CacheLine);
+        size_t pad = (CacheLine - ((size_t)&storage[0])%CacheLine)%CacheLine;
+        snap = &storage[pad];
+        valid = false;
+    }
+
+    // caller must lock.
+    // Adjacent members of the same width are read with one bulk transfer.
+    void refresh()
+    {
+        members_t::const_iterator it(members.begin()), E(members.end());
+        while(it!=E) {
+            epicsUInt64 off = it->first;
+            unsigned size = it->second;
+            size_t count = 1u;
+            for(++it; it!=E && it->second==size && it->first==off+count*size; ++it)
+                count++;
+
+            volatile char *reg = (volatile char*)base+off;
+            char *dst = snap+(off-start);
+            switch(size) {
+            case 1: ioread8_block(reg, (epicsUInt8*)dst, count); break;
+            case 2: nat_ioread16_block(reg, (epicsUInt16*)dst, count); break;
+            case 4: nat_ioread32_block(reg, (epicsUInt32*)dst, count); break;
+            }
+        }
+        gen++;
+        valid = true;
+    }
+};
+
+typedef std::map<std::string, block*> blocks_t;
+blocks_t blocks;
+epicsMutex blocksLock;
+
+block *getBlock(const std::string& name)
+{
+    Guard G(blocksLock);
+    blocks_t::const_iterator it(blocks.find(name));
+    if(it!=blocks.end())
+        return it->second;
+    std::auto_ptr<block> blk(new block(name));
+    blocks[name] = blk.get();
+    return blk.release();
+}
+
+// unsigned integer type holding a register value
+template<int SIZE> struct valtype { typedef epicsUInt32 type; };
+template<> struct valtype<8> { typedef epicsUInt64 type; };
+
+// single register access of a given size and byte order.
+// Selected at compile time so that the inner loops of
+// readArray()/writeArray() reduce to a single load/store (+swap)
+template<int SIZE, priv::ORD ord>
+struct ioaccess;
+
+template<priv::ORD ord>
+struct ioaccess<1, ord> {
+    static epicsUInt32 read(volatile void *addr) { return ioread8(addr); }
+    static void write(volatile void *addr, epicsUInt32 V) { iowrite8(addr, V); }
+};
+template<>
+struct ioaccess<2, priv::NAT> {
+    static epicsUInt32 read(volatile void *addr) { return nat_ioread16(addr); }
+    static void write(volatile void *addr, epicsUInt32 V) { nat_iowrite16(addr, V); }
+};
+template<>
+struct ioaccess<2, priv::BE> {
+    static epicsUInt32 read(volatile void *addr) { return be_ioread16(addr); }
+    static void write(volatile void *addr, epicsUInt32 V) { be_iowrite16(addr, V); }
+};
+template<>
+struct ioaccess<2, priv::LE> {
+    static epicsUInt32 read(volatile void *addr) { return le_ioread16(addr); }
+    static void write(volatile void *addr, epicsUInt32 V) { le_iowrite16(addr, V); }
+};
+template<>
+struct ioaccess<4, priv::NAT> {
+    static epicsUInt32 read(volatile void *addr) { return nat_ioread32(addr); }
+    static void write(volatile void *addr, epicsUInt32 V) { nat_iowrite32(addr, V); }
+};
+template<>
+struct ioaccess<4, priv::BE> {
+    static epicsUInt32 read(volatile void *addr) { return be_ioread32(addr); }
+    static void write(volatile void *addr, epicsUInt32 V) { be_iowrite32(addr, V); }
+};
+template<>
+struct ioaccess<4, priv::LE> {
+    static epicsUInt32 read(volatile void *addr) { return le_ioread32(addr); }
+    static void write(volatile void *addr, epicsUInt32 V) { le_iowrite32(addr, V); }
+};
+// a single 64-bit transaction (on 64-bit hosts)
+template<>
+struct ioaccess<8, priv::NAT> {
+    static epicsUInt64 read(volatile void *addr) { return nat_ioread64(addr); }
+    static void write(volatile void *addr, epicsUInt64 V) { nat_iowrite64(addr, V); }
+};
+template<>
+struct ioaccess<8, priv::BE> {
+    static epicsUInt64 read(volatile void *addr) { return be_ioread64(addr); }
+    static void write(volatile void *addr, epicsUInt64 V) { be_iowrite64(addr, V); }
+};
+template<>
+struct ioaccess<8, priv::LE> {
+    static epicsUInt64 read(volatile void *addr) { return le_ioread64(addr); }
+    static void write(volatile void *addr, epicsUInt64 V) { le_iowrite64(addr, V); }
+};
+
+// unsigned integer type of a register
+template<int SIZE> struct rawtype;
+template<> struct rawtype<1> { typedef epicsUInt8  type; };
+template<> struct rawtype<2> { typedef epicsUInt16 type; };
+template<> struct rawtype<4> { typedef epicsUInt32 type; };
+template<> struct rawtype<8> { typedef epicsUInt64 type; };
+
+// signed integer type of a register
+template<int SIZE> struct signedtype;
+template<> struct signedtype<1> { typedef epicsInt8  type; };
+template<> struct signedtype<2> { typedef epicsInt16 type; };
+template<> struct signedtype<4> { typedef epicsInt32 type; };
+template<> struct signedtype<8> { typedef epicsInt64 type; };
+
+// range of a field of 'bits' width, as the nearest doubles which do not exceed it.
+// The maximum of a 64-bit field would round up to a power of 2.
+epicsFloat64 fieldMin(unsigned bits, bool issigned)
+{
+    return issigned ? -ldexp(1.0, bits-1) : 0.0;
+}
+epicsFloat64 fieldMax(unsigned bits, bool issigned)
+{
+    if(issigned)
+        bits--;
+    epicsFloat64 lim = ldexp(1.0, bits);
+    return bits<=53 ? lim-1.0 : lim-ldexp(1.0, bits-53);
+}
+
+// transfer of adjacent registers of a given size and byte order
+template<int SIZE, priv::ORD ord>
+struct bulkaccess;
+
+template<priv::ORD ord>
+struct bulkaccess<1, ord> {
+    static void read(volatile void *addr, epicsUInt8 *buf, size_t n) { ioread8_block(addr, buf, n); }
+    static void write(volatile void *addr, const epicsUInt8 *buf, size_t n) { iowrite8_block(addr, buf, n); }
+};
+template<>
+struct bulkaccess<2, priv::NAT> {
+    static void read(volatile void *addr, epicsUInt16 *buf, size_t n) { nat_ioread16_block(addr, buf, n); }
+    static void write(volatile void *addr, const epicsUInt16 *buf, size_t n) { nat_iowrite16_block(addr, buf, n); }
+};
+template<>
+struct bulkaccess<2, priv::BE> {
+    static void read(volatile void *addr, epicsUInt16 *buf, size_t n) { be_ioread16_block(addr, buf, n); }
+    static void write(volatile void *addr, const epicsUInt16 *buf, size_t n) { be_iowrite16_block(addr, buf, n); }
+};
+template<>
+struct bulkaccess<2, priv::LE> {
+    static void read(volatile void *addr, epicsUInt16 *buf, size_t n) { le_ioread16_block(addr, buf, n); }
+    static void write(volatile void *addr, const epicsUInt16 *buf, size_t n) { le_iowrite16_block(addr, buf, n); }
+};
+template<>
+struct bulkaccess<4, priv::NAT> {
+    static void read(volatile void *addr, epicsUInt32 *buf, size_t n) { nat_ioread32_block(addr, buf, n); }
+    static void write(volatile void *addr, const epicsUInt32 *buf, size_t n) { nat_iowrite32_block(addr, buf, n); }
+};
+template<>
+struct bulkaccess<4, priv::BE> {
+    static void read(volatile void *addr, epicsUInt32 *buf, size_t n) { be_ioread32_block(addr, buf, n); }
+    static void write(volatile void *addr, const epicsUInt32 *buf, size_t n) { be_iowrite32_block(addr, buf, n); }
+};
+template<>
+struct bulkaccess<4, priv::LE> {
+    static void read(volatile void *addr, epicsUInt32 *buf, size_t n) { le_ioread32_block(addr, buf, n); }
+    static void write(volatile void *addr, const epicsUInt32 *buf, size_t n) { le_iowrite32_block(addr, buf, n); }
+};
+template<>
+struct bulkaccess<8, priv::NAT> {
+    static void read(volatile void *addr, epicsUInt64 *buf, size_t n) { nat_ioread64_block(addr, buf, n); }
+    static void write(volatile void *addr, const epicsUInt64 *buf, size_t n) { nat_iowrite64_block(addr, buf, n); }
+};
+template<>
+struct bulkaccess<8, priv::BE> {
+    static void read(volatile void *addr, epicsUInt64 *buf, size_t n) { be_ioread64_block(addr, buf, n); }
+    static void write(volatile void *addr, const epicsUInt64 *buf, size_t n) { be_iowrite64_block(addr, buf, n); }
+};
+template<>
+struct bulkaccess<8, priv::LE> {
+    static void read(volatile void *addr, epicsUInt64 *buf, size_t n) { le_ioread64_block(addr, buf, n); }
+    static void write(volatile void *addr, const epicsUInt64 *buf, size_t n) { le_iowrite64_block(addr, buf, n); }
+};
+
+// template parameter name must not collide with priv::ord
+template<int SIZE, priv::ORD END>
+struct privT : public priv {
+    typedef ioaccess<SIZE, END> io;
+    typedef typename valtype<SIZE>::type val_t;
+
+    privT() :priv(SIZE, END) {}
+
+    val_t readraw(epicsUInt64 off=0) const
+    {
+        return io::read((volatile char*)base+offset+off);
+    }
+
+    // read from the shared snapshot, which is refreshed
+    // when this record has already seen the current one.
+    val_t readcached(epicsUInt64 off=0) const
+    {
+        Guard G(blk->lock);
+        if(!blk->valid || blkgen==blk->gen)
+            blk->refresh();
+        blkgen = blk->gen;
+        return io::read(blk->snap+(offset+off-blk->start));
     }
 
-    epicsUInt32 read(epicsUInt32 off=0) const
+    val_t read(epicsUInt64 off=0) const
     {
-        epicsUInt32 OV(readraw(off));
-        if(vmask) OV &= vmask;
+        val_t OV(blk ? readcached(off) : readraw(off));
+        if(vmask) OV &= (val_t)vmask;
         OV >>= vshift;
         return OV;
     }
 
+    typedef typename rawtype<SIZE>::type raw_t;
+    typedef typename signedtype<SIZE>::type sraw_t;
+
+    // Registers are adjacent, and values are stored w/o bit-field or conversion
     template<typename VAL>
-    unsigned readArray(VAL *val, unsigned count) const
+    bool isBlock() const
     {
-        epicsUInt32 addr = 0,
+        return sizeof(VAL)==SIZE && step==SIZE && !vmask && !vshift && !blk;
+    }
+
+    // number of whole elements between offset+off and the end of the BAR
+    unsigned blockCount(unsigned count, epicsUInt64 off) const
+    {
+        if(off>=barsize-offset)
+            return 0;
+        epicsUInt64 avail = (barsize-offset-off)/SIZE;
+        return count<avail ? count : avail;
+    }
+
+    unsigned readBlock(raw_t *val, unsigned count, epicsUInt64 off) const
+    {
+        count = blockCount(count, off);
+        bulkaccess<SIZE,END>::read((volatile char*)base+offset+off, val, count);
+        return count;
+    }
+
+    unsigned writeBlock(const raw_t *val, unsigned count, epicsUInt64 off)
+    {
+        count = blockCount(count, off);
+        bulkaccess<SIZE,END>::write((volatile char*)base+offset+off, val, count);
+        flush();
+        return count;
+    }
+
+    // 'off' is the byte offset of the first element, relative to offset=
+    template<typename VAL>
+    unsigned readArray(VAL *val, unsigned count, epicsUInt64 off=0) const
+    {
+        if(isBlock<VAL>())
+            return readBlock((raw_t*)val, count, off);
+
+        epicsUInt64 addr = off,
                     end  = barsize-offset;
         unsigned i;
         for(i=0; i<count && addr<end; i++, addr+=step)
         {
-            epicsUInt32 OV = read(addr);
-            *val++ = castval<VAL,epicsUInt32>::op(OV);
+            val_t OV = read(addr);
+            *val++ = castval<VAL,val_t>::op(OV);
         }
         return i;
     }
 
     template<typename VAL>
-    void write(VAL val, epicsUInt32 off=0)
+    void write(VAL val, epicsUInt64 off=0)
     {
         volatile char *addr = (volatile char*)base+offset+off;
-        epicsUInt32 V = castval<epicsUInt32,VAL>::op(val)<<vshift;
+        val_t V = castval<val_t,VAL>::op(val)<<vshift;
 
         if(vmask) {
             // Do RMW
-            V &= vmask;
-            V |= readraw(off)&(~vmask);
+            V &= (val_t)vmask;
+            V |= readraw(off)&(val_t)(~vmask);
         }
 
-        switch(valsize) {
-        case 1: iowrite8(addr, V); break;
-        case 2: switch(ord) {
-            case NAT: nat_iowrite16(addr, V); break;
-            case BE:  be_iowrite16(addr, V); break;
-            case LE:  le_iowrite16(addr, V); break;
-            }
-            break;
-        case 4: switch(ord) {
-            case NAT: nat_iowrite32(addr, V); break;
-            case BE:  be_iowrite32(addr, V); break;
-            case LE:  le_iowrite32(addr, V); break;
-            }
-            break;
-        }
+        io::write(addr, V);
+        flush();
+    }
+
+    // push out writes held in a write combining buffer,
+    // so that each record write reaches the device when processing completes
+    void flush() const
+    {
+        if(wc)
+            EXPLORE_WC_FLUSH();
     }
 
     template<typename VAL>
-    unsigned writeArray(const VAL *val, unsigned count)
+    unsigned writeArray(const VAL *val, unsigned count, epicsUInt64 off=0)
     {
-        epicsUInt32 addr = 0,
+        if(isBlock<VAL>())
+            return writeBlock((const raw_t*)val, count, off);
+
+        epicsUInt64 addr = off,
                     end  = barsize-offset;
 
         unsigned i;
@@ -198,6 +661,89 @@ struct priv {
         }
         return i;
     }
+
+    // FTVL=DOUBLE.  Registers are transferred a chunk at a time,
+    // and converted in a separate loop over the chunk, which the compiler can vectorize.
+    enum {ScaleChunk = 256};
+
+    // width in bits of the value after mask= and shift=
+    unsigned fieldBits() const
+    {
+        epicsUInt64 M = (vmask ? (epicsUInt64)(raw_t)vmask : (epicsUInt64)(raw_t)~raw_t(0u)) >> vshift;
+        unsigned bits = 0;
+        for(; M; M>>=1)
+            bits++;
+        return bits ? bits : 1u;
+    }
+
+    unsigned readScaled(epicsFloat64 *val, unsigned count) const
+    {
+        raw_t raw[ScaleChunk];
+        const unsigned bits = fieldBits();
+        // sign bit of the field
+        const raw_t sbit = raw_t(1u)<<(bits-1);
+        unsigned i = 0;
+        while(i<count) {
+            unsigned n = count-i<(unsigned)ScaleChunk ? count-i : (unsigned)ScaleChunk;
+            unsigned got = readArray(raw, n, (epicsUInt64)i*step);
+            if(issigned) {
+                if(bits<8*SIZE) {
+                    // sign extend
+                    for(unsigned k=0; k<got; k++)
+                        raw[k] = (raw_t)((raw[k]^sbit)-sbit);
+                }
+                toDouble((const sraw_t*)raw, val+i, got);
+            } else
+                toDouble(raw, val+i, got);
+            i += got;
+            if(got<n)
+                break;
+        }
+        return i;
+    }
+
+    unsigned writeScaled(const epicsFloat64 *val, unsigned count)
+    {
+        raw_t raw[ScaleChunk];
+        unsigned i = 0;
+        while(i<count) {
+            unsigned n = count-i<(unsigned)ScaleChunk ? count-i : (unsigned)ScaleChunk;
+            if(issigned)
+                fromDouble(val+i, (sraw_t*)raw, n);
+            else
+                fromDouble(val+i, raw, n);
+            unsigned put = writeArray((const raw_t*)raw, n, (epicsUInt64)i*step);
+            i += put;
+            if(put<n)
+                break;
+        }
+        return i;
+    }
+
+    template<typename INT>
+    void toDouble(const INT *raw, epicsFloat64 *val, unsigned n) const
+    {
+        const epicsFloat64 slo = aslo, off = aoff;
+        for(unsigned k=0; k<n; k++)
+            val[k] = raw[k]*slo + off;
+    }
+
+    // round to nearest and clip to the range of the field.  NaN is written as 0
+    template<typename INT>
+    void fromDouble(const epicsFloat64 *val, INT *raw, unsigned n) const
+    {
+        const unsigned bits = fieldBits();
+        const epicsFloat64 rslo = aslo ? 1.0/aslo : 1.0, off = aoff,
+                           lo = fieldMin(bits, issigned), hi = fieldMax(bits, issigned);
+        for(unsigned k=0; k<n; k++) {
+            epicsFloat64 R = (val[k]-off)*rslo;
+            R += R<0.0 ? -0.5 : 0.5;
+            R = R==R ? R : 0.0;
+            R = R<lo ? lo : R;
+            R = R>hi ? hi : R;
+            raw[k] = (INT)R; // truncate
+        }
+    }
 };
 
 static const epicsPCIID anypci[] = {
@@ -205,19 +751,18 @@ static const epicsPCIID anypci[] = {
     DEVPCI_END
 };
 
-priv *parseLink(dbCommon *prec, const DBEntry& ent, unsigned vsize, priv::ORD ord)
+void parseLink(priv *pvt, dbCommon *prec, const DBEntry& ent)
 {
-    std::auto_ptr<priv> pvt(new priv);
-    pvt->valsize = vsize;
-    pvt->step = vsize;
-    pvt->ord = ord;
-
     DBLINK *link = ent.getDevLink();
     if(link->type!=INST_IO)
         throw std::logic_error("No INST_IO");
 
     // auto read on initialization for output records
-    pvt->initread = strcmp(ent.pentry()->pflddes->name, "OUT")==0;
+    const bool isout = strcmp(ent.pentry()->pflddes->name, "OUT")==0;
+    pvt->initread = isout;
+
+    // devPCIToLocalAddr() options
+    unsigned mapopt = 0;
 
     std::string linkstr(link->value.instio.string);
 
@@ -254,15 +799,28 @@ priv *parseLink(dbCommon *prec, const DBEntry& ent, unsigned vsize, priv::ORD or
         if(optname=="bar") {
             pvt->bar = parseU32(optval);
         } else if(optname=="offset") {
-            pvt->offset = parseU32(optval);
+            pvt->offset = parseU64(optval);
         } else if(optname=="step") {
             pvt->step = parseU32(optval);
         } else if(optname=="mask") {
-            pvt->vmask = parseU32(optval);
+            pvt->vmask = parseU64(optval);
         } else if(optname=="shift") {
             pvt->vshift = parseU32(optval);
         } else if(optname=="initread") {
             pvt->initread = parseU32(optval)!=0;
+        } else if(optname=="block") {
+            pvt->blk = getBlock(optval);
+        } else if(optname=="aslo") {
+            pvt->aslo = parseF64(optval);
+        } else if(optname=="aoff") {
+            pvt->aoff = parseF64(optval);
+        } else if(optname=="signed") {
+            pvt->issigned = parseU32(optval)!=0;
+        } else if(optname=="async") {
+            pvt->async = parseU32(optval)!=0;
+        } else if(optname=="wc") {
+            if((pvt->wc = parseU32(optval)!=0))
+                mapopt |= DEVLIB_MAP_WC;
         } else {
             throw std::runtime_error(SB()<<"Unknown option '"<<optname<<"'");
         }
@@ -278,13 +836,18 @@ priv *parseLink(dbCommon *prec, const DBEntry& ent, unsigned vsize, priv::ORD or
                  <<" shift="<<pvt->vshift
                  <<" size="<<pvt->valsize
                  <<" ord="<<(int)pvt->ord
+                 <<" block="<<(pvt->blk ? pvt->blk->name : std::string("<none>"))
+                 <<" async="<<pvt->async
+                 <<" aslo="<<pvt->aslo
+                 <<" aoff="<<pvt->aoff
+                 <<" signed="<<pvt->issigned
                  <<"\n";
     }
 
     if(pdev) {
-        if(devPCIToLocalAddr(pdev, pvt->bar, &pvt->base, 0))
+        if(devPCIToLocalAddr(pdev, pvt->bar, &pvt->base, mapopt))
             throw std::runtime_error(SB()<<prec->name<<" Failed to map bar "<<pvt->bar);
-        if(devPCIBarLen(pdev, pvt->bar, &pvt->barsize))
+        if(devPCIBarLen64(pdev, pvt->bar, &pvt->barsize))
             throw std::runtime_error(SB()<<prec->name<<" Failed to find size of bar "<<pvt->bar);
     } else {
         // testing mode
@@ -295,15 +858,27 @@ priv *parseLink(dbCommon *prec, const DBEntry& ent, unsigned vsize, priv::ORD or
     if(pvt->offset>=pvt->barsize || pvt->offset+pvt->valsize>pvt->barsize)
         throw std::runtime_error(SB()<<prec->name<<" offset "<<pvt->offset<<" out of range");
 
-    return pvt.release();
+    if(pvt->blk && pvt->valsize>4)
+        throw std::runtime_error(SB()<<prec->name<<" block= not supported for 64-bit registers");
+
+    if(pvt->blk && isout)
+        throw std::runtime_error(SB()<<prec->name<<" block= not supported for output records");
 }
 
 template<int SIZE, priv::ORD ord>
-long explore_init_record(dbCommon *prec)
+long explore_init_record(dbCommon *prec, bool blockok=true)
 {
     try {
         DBEntry ent(prec);
-        std::auto_ptr<priv> pvt(parseLink(prec, ent, SIZE, ord));
+        std::auto_ptr<privT<SIZE,ord> > pvt(new privT<SIZE,ord>);
+        parseLink(pvt.get(), prec, ent);
+
+        // only join the block once the record is known to be a member
+        if(pvt->blk) {
+            if(!blockok)
+                throw std::runtime_error("block= not supported for this record type");
+            pvt->blk->add(pvt.get());
+        }
 
         prec->dpvt = pvt.release();
         return 0;
@@ -313,33 +888,90 @@ long explore_init_record(dbCommon *prec)
     }
 }
 
-#define TRY if(!prec->dpvt) return 0; priv *pvt = static_cast<priv*>(prec->dpvt); (void)pvt; try
+#define TRY if(!prec->dpvt) return 0; privT<SIZE,ord> *pvt = static_cast<privT<SIZE,ord>*>(prec->dpvt); (void)pvt; try
 #define CATCH() catch(std::exception& e) { std::cerr<<prec->name<<" Error : "<<e.what()<<"\n"; (void)recGblSetSevr(prec, COMM_ALARM, INVALID_ALARM); return 0; }
 
+// worker operations for async=1
+
+template<int SIZE, priv::ORD ord>
+void async_read(priv *p)
+{
+    p->aval = static_cast<privT<SIZE,ord>*>(p)->read();
+}
+
+template<int SIZE, priv::ORD ord>
+void async_write(priv *p)
+{
+    static_cast<privT<SIZE,ord>*>(p)->write(p->aval);
+}
+
+// Read a scalar, directly or through the device worker.
+// Returns false when the worker has been started (PACT set).
+template<int SIZE, priv::ORD ord>
+bool readScalar(dbCommon *prec, privT<SIZE,ord> *pvt, epicsUInt64 *val)
+{
+    if(!pvt->wrk) {
+        Guard G(pvt->lock);
+        *val = pvt->read();
+    } else if(!prec->pact) {
+        pvt->start(prec, &async_read<SIZE,ord>);
+        return false;
+    } else {
+        pvt->finish();
+        *val = pvt->aval;
+    }
+    return true;
+}
+
+template<int SIZE, priv::ORD ord>
+bool writeScalar(dbCommon *prec, privT<SIZE,ord> *pvt, epicsUInt64 val)
+{
+    if(!pvt->wrk) {
+        Guard G(pvt->lock);
+        pvt->write(val);
+    } else if(!prec->pact) {
+        pvt->aval = val;
+        pvt->start(prec, &async_write<SIZE,ord>);
+        return false;
+    } else {
+        pvt->finish();
+    }
+    return true;
+}
+
+// attach the device worker after any initread, which is always synchronous
+void startAsync(dbCommon *prec)
+{
+    priv *pvt = static_cast<priv*>(prec->dpvt);
+    if(pvt && pvt->async)
+        pvt->wrk = getWorker(pvt->pciname);
+}
+
 // integer to/from VAL
 
-template<typename REC>
+template<typename REC, int SIZE, priv::ORD ord>
 long explore_read_int_val(REC *prec)
 {
     TRY {
-        Guard G(pvt->lock);
-        prec->val = pvt->read();
+        epicsUInt64 val;
+        if(!readScalar<SIZE,ord>((dbCommon*)prec, pvt, &val))
+            return 0;
+        prec->val = val;
         if(prec->tpro>1) {
-            errlogPrintf("%s: read %08x -> VAL=%08x\n", prec->name, (unsigned)pvt->offset, (unsigned)prec->val);
+            errlogPrintf("%s: read %08llx -> VAL=%08llx\n", prec->name, (unsigned long long)pvt->offset, (unsigned long long)val);
         }
         return 0;
     } CATCH()
 }
 
-template<typename REC>
+template<typename REC, int SIZE, priv::ORD ord>
 long explore_write_int_val(REC *prec)
 {
     TRY {
-        Guard G(pvt->lock);
-        if(prec->tpro>1) {
-            errlogPrintf("%s: write %08x <- VAL=%08x\n", prec->name, (unsigned)pvt->offset, (unsigned)prec->val);
+        if(prec->tpro>1 && !prec->pact) {
+            errlogPrintf("%s: write %08llx <- VAL=%08llx\n", prec->name, (unsigned long long)pvt->offset, (unsigned long long)prec->val);
         }
-        pvt->write(prec->val);
+        (void)writeScalar<SIZE,ord>((dbCommon*)prec, pvt, prec->val);
         return 0;
     } CATCH()
 }
@@ -350,34 +982,37 @@ long explore_init_record_int_val(REC *prec)
     long ret = explore_init_record<SIZE,ord>((dbCommon*)prec);
     priv *pvt = static_cast<priv*>(prec->dpvt);
     if(ret==0 && pvt->initread)
-        ret = explore_read_int_val(prec);
+        ret = explore_read_int_val<REC,SIZE,ord>(prec);
+    if(ret==0)
+        startAsync((dbCommon*)prec);
     return ret;
 }
 
 // integer to/from RVAL
 
-template<typename REC>
+template<typename REC, int SIZE, priv::ORD ord>
 long explore_read_int_rval(REC *prec)
 {
     TRY {
-        Guard G(pvt->lock);
-        prec->rval = pvt->read();
+        epicsUInt64 val;
+        if(!readScalar<SIZE,ord>((dbCommon*)prec, pvt, &val))
+            return 0;
+        prec->rval = val;
         if(prec->tpro>1) {
-            errlogPrintf("%s: read %08x -> RVAL=%08x\n", prec->name, (unsigned)pvt->offset, (unsigned)prec->rval);
+            errlogPrintf("%s: read %08llx -> RVAL=%08x\n", prec->name, (unsigned long long)pvt->offset, (unsigned)prec->rval);
         }
         return 0;
     } CATCH()
 }
 
-template<typename REC>
+template<typename REC, int SIZE, priv::ORD ord>
 long explore_write_int_rval(REC *prec)
 {
     TRY {
-        Guard G(pvt->lock);
-        if(prec->tpro>1) {
-            errlogPrintf("%s: write %08x <- VAL=%08x\n", prec->name, (unsigned)pvt->offset, (unsigned)prec->rval);
+        if(prec->tpro>1 && !prec->pact) {
+            errlogPrintf("%s: write %08llx <- VAL=%08x\n", prec->name, (unsigned long long)pvt->offset, (unsigned)prec->rval);
         }
-        pvt->write(prec->rval);
+        (void)writeScalar<SIZE,ord>((dbCommon*)prec, pvt, prec->rval);
         return 0;
     } CATCH()
 }
@@ -388,25 +1023,24 @@ long explore_init_record_int_rval(REC *prec)
     long ret = explore_init_record<SIZE,ord>((dbCommon*)prec);
     priv *pvt = static_cast<priv*>(prec->dpvt);
     if(ret==0 && pvt->initread)
-        ret = explore_read_int_rval(prec);
+        ret = explore_read_int_rval<REC,SIZE,ord>(prec);
+    if(ret==0)
+        startAsync((dbCommon*)prec);
     return ret;
 }
 
 // float to/from VAL
 
-template<typename REC>
+template<typename REC, int SIZE, priv::ORD ord>
 long explore_read_real_val(REC *prec)
 {
 
     TRY {
-        punny32 pun;
+        epicsUInt64 ival;
+        if(!readScalar<SIZE,ord>((dbCommon*)prec, pvt, &ival))
+            return 0;
 
-        epicsUInt32 ival;
-        {
-            Guard G(pvt->lock);
-            ival = pun.ival = pvt->read();
-        }
-        epicsFloat64 dval = pun.fval;
+        epicsFloat64 dval = realpun<SIZE>::get(ival);
         dval += prec->roff;
         if(prec->aslo) dval *= prec->aslo;
         dval += prec->aoff;
@@ -416,18 +1050,17 @@ long explore_read_real_val(REC *prec)
         prec->val = dval;
 
         if(prec->tpro>1) {
-            errlogPrintf("%s: read %08x -> %08x -> VAL=%g\n", prec->name, (unsigned)pvt->offset, (unsigned)ival, prec->val);
+            errlogPrintf("%s: read %08llx -> %08llx -> VAL=%g\n", prec->name, (unsigned long long)pvt->offset, (unsigned long long)ival, prec->val);
         }
 
         return 2;
     } CATCH()
 }
 
-template<typename REC>
+template<typename REC, int SIZE, priv::ORD ord>
 long explore_write_real_val(REC *prec)
 {
     TRY {
-        punny32 pun;
         epicsFloat64 dval = prec->val;
 
         dval -= prec->eoff;
@@ -435,14 +1068,13 @@ long explore_write_real_val(REC *prec)
         dval -= prec->aoff;
         if(prec->aslo) dval /= prec->aslo;
         dval -= prec->roff;
-        pun.fval = (epicsFloat32)dval;
+        epicsUInt64 ival = realpun<SIZE>::put(dval);
 
-        if(prec->tpro>1) {
-            errlogPrintf("%s: write %08x <- %08x <- VAL=%g\n", prec->name, (unsigned)pvt->offset, (unsigned)pun.ival, prec->val);
+        if(prec->tpro>1 && !prec->pact) {
+            errlogPrintf("%s: write %08llx <- %08llx <- VAL=%g\n", prec->name, (unsigned long long)pvt->offset, (unsigned long long)ival, prec->val);
         }
 
-        Guard G(pvt->lock);
-        pvt->write(pun.ival);
+        (void)writeScalar<SIZE,ord>((dbCommon*)prec, pvt, ival);
 
         return 0;
     } CATCH()
@@ -454,47 +1086,146 @@ long explore_init_record_real_val(REC *prec)
     long ret = explore_init_record<SIZE,ord>((dbCommon*)prec);
     priv *pvt = static_cast<priv*>(prec->dpvt);
     if(ret==0 && pvt->initread)
-        ret = explore_read_real_val(prec);
+        ret = explore_read_real_val<REC,SIZE,ord>(prec);
+    if(ret==0)
+        startAsync((dbCommon*)prec);
     return ret;
 }
 
-// Read into Waveform
+// Waveform
 
-long explore_read_wf(waveformRecord *prec)
+// size of one element, or 0 if FTVL is not supported
+size_t ftvlSize(epicsEnum16 ftvl)
+{
+    switch(ftvl) {
+    case menuFtypeCHAR  :
+    case menuFtypeUCHAR : return 1;
+    case menuFtypeSHORT :
+    case menuFtypeUSHORT: return 2;
+    case menuFtypeLONG  :
+    case menuFtypeULONG : return 4;
+#ifdef EXPLORE_INT64
+    case menuFtypeINT64 :
+    case menuFtypeUINT64: return 8;
+#endif
+    case menuFtypeFLOAT : return 4;
+    case menuFtypeDOUBLE: return 8;
+    default:              return 0;
+    }
+}
+
+template<int SIZE, priv::ORD ord>
+epicsUInt32 readFTVL(privT<SIZE,ord> *pvt, epicsEnum16 ftvl, void *buf, epicsUInt32 count)
+{
+    switch(ftvl) {
+    case menuFtypeCHAR  :
+    case menuFtypeUCHAR : return pvt->readArray((epicsUInt8*)  buf, count);
+    case menuFtypeSHORT :
+    case menuFtypeUSHORT: return pvt->readArray((epicsUInt16*) buf, count);
+    case menuFtypeLONG  :
+    case menuFtypeULONG : return pvt->readArray((epicsUInt32*) buf, count);
+#ifdef EXPLORE_INT64
+    case menuFtypeINT64 :
+    case menuFtypeUINT64: return pvt->readArray((epicsUInt64*) buf, count);
+#endif
+    case menuFtypeFLOAT : return pvt->readArray((epicsFloat32*)buf, count);
+    case menuFtypeDOUBLE: return pvt->readScaled((epicsFloat64*)buf, count);
+    default:              return 0;
+    }
+}
+
+template<int SIZE, priv::ORD ord>
+epicsUInt32 writeFTVL(privT<SIZE,ord> *pvt, epicsEnum16 ftvl, const void *buf, epicsUInt32 count)
+{
+    switch(ftvl) {
+    case menuFtypeCHAR  :
+    case menuFtypeUCHAR : return pvt->writeArray((const epicsUInt8*)  buf, count);
+    case menuFtypeSHORT :
+    case menuFtypeUSHORT: return pvt->writeArray((const epicsUInt16*) buf, count);
+    case menuFtypeLONG  :
+    case menuFtypeULONG : return pvt->writeArray((const epicsUInt32*) buf, count);
+#ifdef EXPLORE_INT64
+    case menuFtypeINT64 :
+    case menuFtypeUINT64: return pvt->writeArray((const epicsUInt64*) buf, count);
+#endif
+    case menuFtypeFLOAT : return pvt->writeArray((const epicsFloat32*)buf, count);
+    case menuFtypeDOUBLE: return pvt->writeScaled((const epicsFloat64*)buf, count);
+    default:              return 0;
+    }
+}
+
+// async=1 waveforms are staged through priv::abuf so that the worker
+// never touches BPTR, which is only accessed with the record locked.
+
+template<int SIZE, priv::ORD ord>
+void async_read_wf(priv *p)
+{
+    p->acount = readFTVL(static_cast<privT<SIZE,ord>*>(p), p->aftvl,
+                         p->abuf.empty() ? NULL : &p->abuf[0], p->acount);
+}
+
+template<int SIZE, priv::ORD ord>
+void async_write_wf(priv *p)
+{
+    p->aval = writeFTVL(static_cast<privT<SIZE,ord>*>(p), p->aftvl,
+                        p->abuf.empty() ? NULL : &p->abuf[0], p->acount);
+}
+
+template<typename REC, int SIZE, priv::ORD ord>
+long explore_read_wf(REC *prec)
 {
     TRY {
-        Guard G(pvt->lock);
-        switch(prec->ftvl) {
-        case menuFtypeCHAR  :
-        case menuFtypeUCHAR : prec->nord = pvt->readArray((epicsUInt8*)  prec->bptr, prec->nelm); break;
-        case menuFtypeSHORT :
-        case menuFtypeUSHORT: prec->nord = pvt->readArray((epicsUInt16*) prec->bptr, prec->nelm); break;
-        case menuFtypeLONG  :
-        case menuFtypeULONG : prec->nord = pvt->readArray((epicsUInt32*) prec->bptr, prec->nelm); break;
-        case menuFtypeFLOAT : prec->nord = pvt->readArray((epicsFloat32*)prec->bptr, prec->nelm); break;
-        default:
+        size_t esize = ftvlSize(prec->ftvl);
+        if(!esize) {
             (void)recGblSetSevr(prec, READ_ALARM, INVALID_ALARM);
+
+        } else if(!pvt->wrk) {
+            Guard G(pvt->lock);
+            prec->nord = readFTVL(pvt, prec->ftvl, prec->bptr, prec->nelm);
+
+        } else if(!prec->pact) {
+            pvt->aftvl = prec->ftvl;
+            pvt->acount = prec->nelm;
+            pvt->abuf.resize(prec->nelm*esize);
+            pvt->start((dbCommon*)prec, &async_read_wf<SIZE,ord>);
+
+        } else {
+            pvt->finish();
+            if(pvt->acount)
+                memcpy(prec->bptr, &pvt->abuf[0], pvt->acount*esize);
+            prec->nord = pvt->acount;
         }
 
         return 0;
     } CATCH()
 }
 
-long explore_write_wf(waveformRecord *prec)
+template<typename REC, int SIZE, priv::ORD ord>
+long explore_write_wf(REC *prec)
 {
     TRY {
-        Guard G(pvt->lock);
-        unsigned nwritten = 0;
-        switch(prec->ftvl) {
-        case menuFtypeCHAR  :
-        case menuFtypeUCHAR : nwritten = pvt->writeArray((epicsUInt8*)  prec->bptr, prec->nord); break;
-        case menuFtypeSHORT :
-        case menuFtypeUSHORT: nwritten = pvt->writeArray((epicsUInt16*) prec->bptr, prec->nord); break;
-        case menuFtypeLONG  :
-        case menuFtypeULONG : nwritten = pvt->writeArray((epicsUInt32*) prec->bptr, prec->nord); break;
-        case menuFtypeFLOAT : nwritten = pvt->writeArray((epicsFloat32*)prec->bptr, prec->nord); break;
-        default:
+        size_t esize = ftvlSize(prec->ftvl);
+        epicsUInt32 nwritten = 0;
+        if(!esize) {
             (void)recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
+            return 0;
+
+        } else if(!pvt->wrk) {
+            Guard G(pvt->lock);
+            nwritten = writeFTVL(pvt, prec->ftvl, prec->bptr, prec->nord);
+
+        } else if(!prec->pact) {
+            pvt->aftvl = prec->ftvl;
+            pvt->acount = prec->nord;
+            pvt->abuf.resize(prec->nord*esize);
+            if(prec->nord)
+                memcpy(&pvt->abuf[0], prec->bptr, prec->nord*esize);
+            pvt->start((dbCommon*)prec, &async_write_wf<SIZE,ord>);
+            return 0;
+
+        } else {
+            pvt->finish();
+            nwritten = pvt->aval;
         }
         if(nwritten!=prec->nord)
             (void)recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
@@ -502,16 +1233,97 @@ long explore_write_wf(waveformRecord *prec)
     } CATCH()
 }
 
-template<int SIZE, priv::ORD ord>
-long explore_init_record_wf(waveformRecord *prec)
+template<typename REC, int SIZE, priv::ORD ord>
+long explore_init_record_wf(REC *prec)
 {
-    long ret = explore_init_record<SIZE,ord>((dbCommon*)prec);
+    long ret = explore_init_record<SIZE,ord>((dbCommon*)prec, false);
     priv *pvt = static_cast<priv*>(prec->dpvt);
     if(ret==0 && pvt->initread)
-        ret = explore_read_wf(prec);
+        ret = explore_read_wf<REC,SIZE,ord>(prec);
+    if(ret==0)
+        startAsync((dbCommon*)prec);
+    return ret;
+}
+
+// aai.  As waveform, except that async=1 reads are not copied.
+// The worker fills priv::spare, which is then exchanged with BPTR.
+
+template<int SIZE, priv::ORD ord>
+void async_read_aai(priv *p)
+{
+    p->acount = readFTVL(static_cast<privT<SIZE,ord>*>(p), p->aftvl, p->spare, p->acount);
+}
+
+template<typename REC, int SIZE, priv::ORD ord>
+long explore_read_aai(REC *prec)
+{
+    TRY {
+        if(!pvt->wrk || !pvt->spare) {
+            return explore_read_wf<REC,SIZE,ord>(prec);
+
+        } else if(!prec->pact) {
+            pvt->aftvl = prec->ftvl;
+            pvt->acount = prec->nelm;
+            pvt->start((dbCommon*)prec, &async_read_aai<SIZE,ord>);
+
+        } else {
+            pvt->finish();
+#ifdef EXPLORE_SWAP_BPTR
+            std::swap(prec->bptr, pvt->spare);
+#else
+            if(pvt->acount)
+                memcpy(prec->bptr, pvt->spare, pvt->acount*ftvlSize(prec->ftvl));
+#endif
+            prec->nord = pvt->acount;
+        }
+
+        return 0;
+    } CATCH()
+}
+
+// Called before the record allocates BPTR, so that both buffers are ours
+template<typename REC, int SIZE, priv::ORD ord>
+long explore_init_record_aai(REC *prec)
+{
+    long ret = explore_init_record<SIZE,ord>((dbCommon*)prec, false);
+    priv *pvt = static_cast<priv*>(prec->dpvt);
+    size_t esize = ftvlSize(prec->ftvl);
+    if(ret==0 && esize) {
+        size_t nelm = prec->nelm ? prec->nelm : 1u;
+        if(!prec->bptr)
+            prec->bptr = callocMustSucceed(nelm, esize, "explore aai buffer");
+        if(pvt->async)
+            pvt->spare = callocMustSucceed(nelm, esize, "explore aai buffer");
+    }
+    if(ret==0 && pvt->initread && prec->bptr)
+        ret = explore_read_wf<REC,SIZE,ord>(prec);
+    if(ret==0)
+        startAsync((dbCommon*)prec);
     return ret;
 }
 
+// aao.  Also called before the record allocates BPTR, which initread=1 fills.
+template<typename REC, int SIZE, priv::ORD ord>
+long explore_init_record_aao(REC *prec)
+{
+    long ret = explore_init_record<SIZE,ord>((dbCommon*)prec, false);
+    priv *pvt = static_cast<priv*>(prec->dpvt);
+    size_t esize = ftvlSize(prec->ftvl);
+    if(ret==0 && esize && !prec->bptr)
+        prec->bptr = callocMustSucceed(prec->nelm ? prec->nelm : 1u, esize, "explore aao buffer");
+    if(ret==0 && pvt->initread && prec->bptr)
+        ret = explore_read_wf<REC,SIZE,ord>(prec);
+    if(ret==0)
+        startAsync((dbCommon*)prec);
+    return ret;
+}
+
+template<typename REC, int SIZE, priv::ORD ord>
+long explore_write_aao(REC *prec)
+{
+    return explore_write_wf<REC,SIZE,ord>(prec);
+}
+
 
 template<typename REC>
 struct dset6 {
@@ -529,7 +1341,7 @@ struct dset6 {
 extern "C" {
 
 #define SUP(NAME, REC, OP, DIR, SIZE, END) static dset6<REC##Record> NAME = \
-  {6, NULL, NULL, &explore_init_record_##OP<REC##Record,SIZE,END>, NULL, &explore_##DIR##_##OP<REC##Record>, NULL}; \
+  {6, NULL, NULL, &explore_init_record_##OP<REC##Record,SIZE,END>, NULL, &explore_##DIR##_##OP<REC##Record,SIZE,END>, NULL}; \
     epicsExportAddress(dset, NAME)
 
 SUP(devExploreLiReadU8,     longin, int_val, read, 1, priv::NAT);
@@ -618,24 +1430,88 @@ SUP(devExploreAiReadF32MSB, ai, real_val, read, 4, priv::BE);
 SUP(devExploreAoWriteF32LSB, ao, real_val, write, 4, priv::LE);
 SUP(devExploreAoWriteF32MSB, ao, real_val, write, 4, priv::BE);
 
+SUP(devExploreAiReadF64LSB, ai, real_val, read, 8, priv::LE);
+SUP(devExploreAiReadF64MSB, ai, real_val, read, 8, priv::BE);
+
+SUP(devExploreAoWriteF64LSB, ao, real_val, write, 8, priv::LE);
+SUP(devExploreAoWriteF64MSB, ao, real_val, write, 8, priv::BE);
+
+#ifdef EXPLORE_INT64
+SUP(devExploreI64iReadU8,     int64in, int_val, read, 1, priv::NAT);
+SUP(devExploreI64iReadU16NAT, int64in, int_val, read, 2, priv::NAT);
+SUP(devExploreI64iReadU16LSB, int64in, int_val, read, 2, priv::LE);
+SUP(devExploreI64iReadU16MSB, int64in, int_val, read, 2, priv::BE);
+SUP(devExploreI64iReadU32NAT, int64in, int_val, read, 4, priv::NAT);
+SUP(devExploreI64iReadU32LSB, int64in, int_val, read, 4, priv::LE);
+SUP(devExploreI64iReadU32MSB, int64in, int_val, read, 4, priv::BE);
+SUP(devExploreI64iReadU64NAT, int64in, int_val, read, 8, priv::NAT);
+SUP(devExploreI64iReadU64LSB, int64in, int_val, read, 8, priv::LE);
+SUP(devExploreI64iReadU64MSB, int64in, int_val, read, 8, priv::BE);
+
+SUP(devExploreI64oWriteU8,     int64out, int_val, write, 1, priv::NAT);
+SUP(devExploreI64oWriteU16NAT, int64out, int_val, write, 2, priv::NAT);
+SUP(devExploreI64oWriteU16LSB, int64out, int_val, write, 2, priv::LE);
+SUP(devExploreI64oWriteU16MSB, int64out, int_val, write, 2, priv::BE);
+SUP(devExploreI64oWriteU32NAT, int64out, int_val, write, 4, priv::NAT);
+SUP(devExploreI64oWriteU32LSB, int64out, int_val, write, 4, priv::LE);
+SUP(devExploreI64oWriteU32MSB, int64out, int_val, write, 4, priv::BE);
+SUP(devExploreI64oWriteU64NAT, int64out, int_val, write, 8, priv::NAT);
+SUP(devExploreI64oWriteU64LSB, int64out, int_val, write, 8, priv::LE);
+SUP(devExploreI64oWriteU64MSB, int64out, int_val, write, 8, priv::BE);
+#endif
+
 #undef SUP
-#define SUP(NAME, DIR, SIZE, END) static dset6<waveformRecord> NAME = \
-  {6, NULL, NULL, &explore_init_record_wf<SIZE,END>, NULL, &explore_##DIR##_wf, NULL}; \
+#define SUP(NAME, REC, OP, DIR, SIZE, END) static dset6<REC##Record> NAME = \
+  {6, NULL, NULL, &explore_init_record_##OP<REC##Record,SIZE,END>, NULL, &explore_##DIR##_##OP<REC##Record,SIZE,END>, NULL}; \
     epicsExportAddress(dset, NAME)
 
-SUP(devExploreWfReadU8,     read, 1, priv::NAT);
-SUP(devExploreWfReadU16NAT, read, 2, priv::NAT);
-SUP(devExploreWfReadU16LSB, read, 2, priv::LE);
-SUP(devExploreWfReadU16MSB, read, 2, priv::BE);
-SUP(devExploreWfReadU32NAT, read, 4, priv::NAT);
-SUP(devExploreWfReadU32LSB, read, 4, priv::LE);
-SUP(devExploreWfReadU32MSB, read, 4, priv::BE);
-
-SUP(devExploreWfWriteU8,     write, 1, priv::NAT);
-SUP(devExploreWfWriteU16NAT, write, 2, priv::NAT);
-SUP(devExploreWfWriteU16LSB, write, 2, priv::LE);
-SUP(devExploreWfWriteU16MSB, write, 2, priv::BE);
-SUP(devExploreWfWriteU32NAT, write, 4, priv::NAT);
-SUP(devExploreWfWriteU32LSB, write, 4, priv::LE);
-SUP(devExploreWfWriteU32MSB, write, 4, priv::BE);
+SUP(devExploreWfReadU8,       waveform, wf, read, 1, priv::NAT);
+SUP(devExploreWfReadU16NAT,   waveform, wf, read, 2, priv::NAT);
+SUP(devExploreWfReadU16LSB,   waveform, wf, read, 2, priv::LE);
+SUP(devExploreWfReadU16MSB,   waveform, wf, read, 2, priv::BE);
+SUP(devExploreWfReadU32NAT,   waveform, wf, read, 4, priv::NAT);
+SUP(devExploreWfReadU32LSB,   waveform, wf, read, 4, priv::LE);
+SUP(devExploreWfReadU32MSB,   waveform, wf, read, 4, priv::BE);
+
+SUP(devExploreWfWriteU8,      waveform, wf, write, 1, priv::NAT);
+SUP(devExploreWfWriteU16NAT,  waveform, wf, write, 2, priv::NAT);
+SUP(devExploreWfWriteU16LSB,  waveform, wf, write, 2, priv::LE);
+SUP(devExploreWfWriteU16MSB,  waveform, wf, write, 2, priv::BE);
+SUP(devExploreWfWriteU32NAT,  waveform, wf, write, 4, priv::NAT);
+SUP(devExploreWfWriteU32LSB,  waveform, wf, write, 4, priv::LE);
+SUP(devExploreWfWriteU32MSB,  waveform, wf, write, 4, priv::BE);
+
+SUP(devExploreAaiReadU8,      aai,      aai, read, 1, priv::NAT);
+SUP(devExploreAaiReadU16NAT,  aai,      aai, read, 2, priv::NAT);
+SUP(devExploreAaiReadU16LSB,  aai,      aai, read, 2, priv::LE);
+SUP(devExploreAaiReadU16MSB,  aai,      aai, read, 2, priv::BE);
+SUP(devExploreAaiReadU32NAT,  aai,      aai, read, 4, priv::NAT);
+SUP(devExploreAaiReadU32LSB,  aai,      aai, read, 4, priv::LE);
+SUP(devExploreAaiReadU32MSB,  aai,      aai, read, 4, priv::BE);
+
+SUP(devExploreAaoWriteU8,     aao,      aao, write, 1, priv::NAT);
+SUP(devExploreAaoWriteU16NAT, aao,      aao, write, 2, priv::NAT);
+SUP(devExploreAaoWriteU16LSB, aao,      aao, write, 2, priv::LE);
+SUP(devExploreAaoWriteU16MSB, aao,      aao, write, 2, priv::BE);
+SUP(devExploreAaoWriteU32NAT, aao,      aao, write, 4, priv::NAT);
+SUP(devExploreAaoWriteU32LSB, aao,      aao, write, 4, priv::LE);
+SUP(devExploreAaoWriteU32MSB, aao,      aao, write, 4, priv::BE);
+
+#ifdef EXPLORE_INT64
+SUP(devExploreWfReadU64NAT,   waveform, wf, read, 8, priv::NAT);
+SUP(devExploreWfReadU64LSB,   waveform, wf, read, 8, priv::LE);
+SUP(devExploreWfReadU64MSB,   waveform, wf, read, 8, priv::BE);
+
+SUP(devExploreWfWriteU64NAT,  waveform, wf, write, 8, priv::NAT);
+SUP(devExploreWfWriteU64LSB,  waveform, wf, write, 8, priv::LE);
+SUP(devExploreWfWriteU64MSB,  waveform, wf, write, 8, priv::BE);
+
+SUP(devExploreAaiReadU64NAT,  aai,      aai, read, 8, priv::NAT);
+SUP(devExploreAaiReadU64LSB,  aai,      aai, read, 8, priv::LE);
+SUP(devExploreAaiReadU64MSB,  aai,      aai, read, 8, priv::BE);
+
+SUP(devExploreAaoWriteU64NAT, aao,      aao, write, 8, priv::NAT);
+SUP(devExploreAaoWriteU64LSB, aao,      aao, write, 8, priv::LE);
+SUP(devExploreAaoWriteU64MSB, aao,      aao, write, 8, priv::BE);
+#endif
 } // extern "C"
@@ -15,6 +15,12 @@
 
 #include <shareLib.h>
 
+#include "devLibMMIO.h"
+
+// Store fence following each write with wc=1, which pushes out the write combining buffer.
+// Not wbarr(), which does nothing with the epicsMMIO.h of EPICS Base >=3.15.1
+#define EXPLORE_WC_FLUSH() devlib_wbarr()
+
 typedef epicsGuard<epicsMutex> Guard;
 typedef epicsGuardRelease<epicsMutex> UnGuard;
 
@@ -34,6 +40,8 @@ epicsShareExtern
 void parseToMap(const std::string& inp, strmap_t& ret);
 
 epicsUInt32 parseU32(const std::string& s);
+epicsUInt64 parseU64(const std::string& s);
+epicsFloat64 parseF64(const std::string& s);
 
 class DBEntry {
     DBENTRY entry;
@@ -28,6 +28,7 @@
 
 #include "devLibPCI.h"
 #include "epicsMMIO.h"
+#include "devLibMMIO.h"
 
 #define epicsExportSharedSymbols
 #include "devexplore.h"
@@ -96,18 +97,18 @@ struct flashProg : public epicsThreadRunable {
         if(devPCIFindSpec(anypci, pciname.c_str(), &pdev, 0))
             throw std::runtime_error(SB()<<" Invalid PCI device "<<pciname);
 
-        if(devPCIToLocalAddr(pdev, bar, (volatile void**)&pci_base, 0))
-            throw std::runtime_error(SB()<<" Failed to map bar "<<bar<<" of "<<pciname);
-        pci_base += pci_offset;
-        epicsUInt32 barsize = 0;
-        if(devPCIBarLen(pdev, bar, &barsize))
-            throw std::runtime_error(SB()<<" Failed to find size of bar "<<bar);
-        if(barsize<pci_offset+REGMAX)
+        // map only the registers
+        int err = devPCIMapWindow(pdev, bar, pci_offset, REGMAX, (volatile void**)&pci_base, 0);
+        if(err==S_dev_badArgument)
             throw std::runtime_error(SB()<<"PCI offset + REGMAX exceeds BAR "<<bar<<" size");
+        else if(err)
+            throw std::runtime_error(SB()<<" Failed to map bar "<<bar<<" of "<<pciname);
 
         epicsUInt32 id = read32(REG_LOCKOUT);
-        if(id!=0xF1A54001)
+        if(id!=0xF1A54001) {
+            (void)devPCIUnmap(pdev, bar, pci_base);
             throw std::runtime_error(SB()<<"wrong id 0x"<<std::hex<<id<<" from 0x"<<std::hex<<(pci_base+REG_LOCKOUT));
+        }
 
         scanIoInit(&scan);
     }
@@ -208,10 +209,12 @@ struct flashProg : public epicsThreadRunable {
 
                     write32(REG_CMDADDR, 0x06000000); // write enable
 
-                    write32(REG_WDATA, ntohl(data[3]));
-                    write32(REG_WDATA, ntohl(data[2]));
-                    write32(REG_WDATA, ntohl(data[1]));
-                    write32(REG_WDATA, ntohl(data[0]));
+                    // the FIFO takes the last word first
+                    const epicsUInt32 words[4] = {ntohl(data[3]), ntohl(data[2]), ntohl(data[1]), ntohl(data[0])};
+                    if(debug>2)
+                        printf("Write %x <- %08x %08x %08x %08x\n", pci_offset+REG_WDATA,
+                               (unsigned)words[0], (unsigned)words[1], (unsigned)words[2], (unsigned)words[3]);
+                    le_iowrite32_rep(pci_base+REG_WDATA, words, 4);
                     wait_for_ready();
 
                     write32(REG_CMDADDR, 0x02000000|lastaddr);
@@ -196,7 +196,7 @@ long init_record_li_irq(longinRecord *prec)
 
         irq_used.insert(bdf);
 
-        if(devPCIConnectInterrupt(pvt->dev, &isrfn, pvt.get(), 0))
+        if(devPCIConnectInterrupt(pvt->dev, &isrfn, pvt.get(), DEVLIB_ISR_DEVLOCK))
             throw std::runtime_error("Failed to Connect IRQ");
 
         if(devPCIEnableInterrupt(pvt->dev))
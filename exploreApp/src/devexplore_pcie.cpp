@@ -0,0 +1,353 @@
+/*
+ * PCI Express link and error status, read from configuration space.
+ *
+ * record(longin, "$(P)LinkWidth") {
+ *   field(DTYP, "Explore PCIe")
+ *   field(INP , "@1:0.0 param=width")
+ * }
+ */
+
+#include <map>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <alarm.h>
+#include <errlog.h>
+#include <devSup.h>
+#include <recGbl.h>
+#include <dbAccess.h>
+#include <longinRecord.h>
+#include <biRecord.h>
+#include <epicsExport.h>
+
+#include "devLibPCI.h"
+#include "devexplore.h"
+
+namespace {
+
+// offsets in the PCI Express capability
+enum {
+    EXP_DEVSTA = 0x0a,
+    EXP_LNKCAP = 0x0c,
+    EXP_LNKSTA = 0x12,
+    EXP_SIZE   = 0x14,
+};
+
+// offsets in the AER extended capability
+enum {
+    AER_UNCOR_STATUS = 0x04,
+    AER_UNCOR_SEVER  = 0x0c,
+    AER_COR_STATUS   = 0x10,
+    AER_SIZE         = 0x14,
+};
+
+enum param_t {
+    Speed, Width, MaxSpeed, MaxWidth, Degraded,
+    DevSta, LinkSta,
+    CorErr, NonFatalErr, FatalErr,
+    Cor, Uncor, Fatal, CorCnt, UncorCnt,
+};
+
+const struct {
+    const char *name;
+    param_t param;
+} params[] = {
+    {"speed",    Speed},
+    {"width",    Width},
+    {"maxspeed", MaxSpeed},
+    {"maxwidth", MaxWidth},
+    {"degraded", Degraded},
+    {"devsta",   DevSta},
+    {"linksta",  LinkSta},
+    {"correrr",  CorErr},
+    {"nonfatalerr", NonFatalErr},
+    {"fatalerr", FatalErr},
+    {"cor",      Cor},
+    {"uncor",    Uncor},
+    {"fatal",    Fatal},
+    {"corcnt",   CorCnt},
+    {"uncorcnt", UncorCnt},
+};
+
+unsigned popcount(epicsUInt32 v)
+{
+    unsigned n = 0;
+    for(; v; v &= v-1u)
+        n++;
+    return n;
+}
+
+// Status of one device.  Shared by all records naming it.
+struct pcieDev {
+    epicsMutex lock;
+
+    const epicsPCIDevice * const dev;
+    // offsets of capabilities.  aeroff==0 when AER not supported
+    unsigned expoff, aeroff;
+    // window covering both, read as a single block
+    unsigned start, end;
+    // clear error status bits after each read (clear=1)
+    bool clear;
+
+    std::vector<epicsUInt8> snap;
+    // incremented by each refresh()
+    epicsUInt32 gen;
+    bool valid;
+
+    // decoded
+    epicsUInt32 speed, width, maxspeed, maxwidth;
+    epicsUInt32 devsta, linksta;
+    epicsUInt32 cor, uncor, fatal;
+    epicsUInt32 corcnt, uncorcnt;
+
+    explicit pcieDev(const epicsPCIDevice *dev)
+        :dev(dev), expoff(0u), aeroff(0u), start(0u), end(0u), clear(false), gen(0u), valid(false)
+        ,speed(0u), width(0u), maxspeed(0u), maxwidth(0u)
+        ,devsta(0u), linksta(0u)
+        ,cor(0u), uncor(0u), fatal(0u)
+        ,corcnt(0u), uncorcnt(0u)
+    {
+        if(devPCIFindCapability(dev, DEVPCI_CAP_EXP, &expoff))
+            throw std::runtime_error("Not a PCI Express device");
+        if(devPCIFindExtCapability(dev, DEVPCI_EXT_CAP_AER, &aeroff))
+            aeroff = 0u;
+
+        start = expoff;
+        end = aeroff ? aeroff+AER_SIZE : expoff+EXP_SIZE;
+        snap.resize(end-start);
+    }
+
+    epicsUInt32 get16(unsigned off) const
+    {
+        const epicsUInt8 *p = &snap[off-start];
+        return p[0] | (p[1]<<8);
+    }
+    epicsUInt32 get32(unsigned off) const
+    {
+        const epicsUInt8 *p = &snap[off-start];
+        return p[0] | (p[1]<<8) | (p[2]<<16) | ((epicsUInt32)p[3]<<24);
+    }
+
+    // caller must lock
+    void refresh()
+    {
+        if(devPCIConfigReadBlock(dev, start, &snap[0], end-start))
+            throw std::runtime_error("Failed to read configuration space");
+
+        epicsUInt32 lnkcap = get32(expoff+EXP_LNKCAP);
+        maxspeed = lnkcap&0xf;
+        maxwidth = (lnkcap>>4)&0x3f;
+
+        linksta = get16(expoff+EXP_LNKSTA);
+        speed = linksta&0xf;
+        width = (linksta>>4)&0x3f;
+
+        devsta = get16(expoff+EXP_DEVSTA);
+
+        if(aeroff) {
+            epicsUInt32 ncor   = get32(aeroff+AER_COR_STATUS),
+                        nuncor = get32(aeroff+AER_UNCOR_STATUS);
+
+            // status bits stay set until cleared.
+            // Without clear=1, count only bits newly set
+            corcnt   += popcount(clear ? ncor   : ncor&~cor);
+            uncorcnt += popcount(clear ? nuncor : nuncor&~uncor);
+
+            cor = ncor;
+            uncor = nuncor;
+            fatal = uncor & get32(aeroff+AER_UNCOR_SEVER);
+        }
+
+        if(clear) {
+            // RW1C
+            if(devsta&0xf)
+                (void)devPCIConfigWrite16(dev, expoff+EXP_DEVSTA, devsta&0xf);
+            if(aeroff && cor)
+                (void)devPCIConfigWrite32(dev, aeroff+AER_COR_STATUS, cor);
+            if(aeroff && uncor)
+                (void)devPCIConfigWrite32(dev, aeroff+AER_UNCOR_STATUS, uncor);
+        }
+
+        gen++;
+        valid = true;
+    }
+
+    epicsUInt32 value(param_t param) const
+    {
+        switch(param) {
+        case Speed:    return speed;
+        case Width:    return width;
+        case MaxSpeed: return maxspeed;
+        case MaxWidth: return maxwidth;
+        case Degraded: return speed<maxspeed || width<maxwidth;
+        case DevSta:   return devsta;
+        case LinkSta:  return linksta;
+        case CorErr:   return devsta&1;
+        case NonFatalErr: return (devsta>>1)&1;
+        case FatalErr: return (devsta>>2)&1;
+        case Cor:      return cor;
+        case Uncor:    return uncor;
+        case Fatal:    return fatal;
+        case CorCnt:   return corcnt;
+        case UncorCnt: return uncorcnt;
+        }
+        return 0;
+    }
+};
+
+typedef std::map<const epicsPCIDevice*, pcieDev*> pcieDevs_t;
+pcieDevs_t pcieDevs;
+epicsMutex pcieDevsLock;
+
+pcieDev *getDev(const epicsPCIDevice *dev)
+{
+    Guard G(pcieDevsLock);
+    pcieDevs_t::const_iterator it(pcieDevs.find(dev));
+    if(it!=pcieDevs.end())
+        return it->second;
+    std::auto_ptr<pcieDev> pdev(new pcieDev(dev));
+    pcieDevs[dev] = pdev.get();
+    return pdev.release();
+}
+
+static const epicsPCIID anypci[] = {
+    DEVPCI_DEVICE_VENDOR(DEVPCI_ANY_DEVICE, DEVPCI_ANY_VENDOR),
+    DEVPCI_END
+};
+
+struct pciePriv {
+    pcieDev *pdev;
+    param_t param;
+    // generation of the snapshot last used by this record
+    epicsUInt32 gen;
+
+    pciePriv() :pdev(0), param(Speed), gen(0u) {}
+
+    // As with block=, re-read when this record has already seen the current snapshot.
+    // So records scanned together share one read.
+    epicsUInt32 read()
+    {
+        Guard G(pdev->lock);
+        if(!pdev->valid || gen==pdev->gen)
+            pdev->refresh();
+        gen = pdev->gen;
+        return pdev->value(param);
+    }
+};
+
+long init_record_pcie(dbCommon *prec, const DBLINK *link)
+{
+    try {
+        if(link->type!=INST_IO)
+            throw std::logic_error("No INST_IO");
+
+        std::string lstr(link->value.instio.string);
+        size_t sep = lstr.find_first_of(" \t");
+        std::string pciname(lstr.substr(0, sep));
+
+        strmap_t args;
+        if(sep<lstr.size())
+            parseToMap(lstr.substr(sep), args);
+
+        std::auto_ptr<pciePriv> pvt(new pciePriv);
+
+        strmap_t::const_iterator it;
+
+        if((it=args.find("param"))==args.end())
+            throw std::runtime_error(SB()<<"Missing required 'param' in \""<<lstr<<"\"");
+        size_t i;
+        for(i=0; i<NELEMENTS(params); i++) {
+            if(it->second==params[i].name) {
+                pvt->param = params[i].param;
+                break;
+            }
+        }
+        if(i==NELEMENTS(params))
+            throw std::runtime_error(SB()<<"Unknown param="<<it->second);
+
+        const epicsPCIDevice *dev = NULL;
+        if(devPCIFindSpec(anypci, pciname.c_str(), &dev, 0))
+            throw std::runtime_error(SB()<<" Invalid PCI device "<<pciname);
+
+        pvt->pdev = getDev(dev);
+
+        if((it=args.find("clear"))!=args.end() && parseU32(it->second)) {
+            Guard G(pvt->pdev->lock);
+            pvt->pdev->clear = true;
+        }
+
+        if(prec->tpro>1)
+            fprintf(stderr, "%s: pcidev=%s exp=%x aer=%x\n", prec->name, pciname.c_str(),
+                    pvt->pdev->expoff, pvt->pdev->aeroff);
+
+        prec->dpvt = pvt.release();
+        return 0;
+
+    } catch(std::exception& e) {
+        fprintf(stderr, "%s: init_record error: %s\n", prec->name, e.what());
+        return S_dev_badInit;
+    }
+}
+
+long init_record_li(longinRecord *prec)
+{
+    return init_record_pcie((dbCommon*)prec, &prec->inp);
+}
+
+long init_record_bi(biRecord *prec)
+{
+    return init_record_pcie((dbCommon*)prec, &prec->inp);
+}
+
+long read_li(longinRecord *prec)
+{
+    pciePriv *pvt = static_cast<pciePriv*>(prec->dpvt);
+    if(!pvt) {
+        (void)recGblSetSevr(prec, COMM_ALARM, INVALID_ALARM);
+        return S_dev_noDevice;
+    }
+    try {
+        prec->val = pvt->read();
+        return 0;
+    } catch(std::exception& e) {
+        fprintf(stderr, "%s: read error: %s\n", prec->name, e.what());
+        (void)recGblSetSevr(prec, READ_ALARM, INVALID_ALARM);
+        return S_dev_noDevice;
+    }
+}
+
+long read_bi(biRecord *prec)
+{
+    pciePriv *pvt = static_cast<pciePriv*>(prec->dpvt);
+    if(!pvt) {
+        (void)recGblSetSevr(prec, COMM_ALARM, INVALID_ALARM);
+        return S_dev_noDevice;
+    }
+    try {
+        prec->rval = pvt->read();
+        return 0;
+    } catch(std::exception& e) {
+        fprintf(stderr, "%s: read error: %s\n", prec->name, e.what());
+        (void)recGblSetSevr(prec, READ_ALARM, INVALID_ALARM);
+        return S_dev_noDevice;
+    }
+}
+
+struct dset6 {
+    dset base;
+    DEVSUPFUN read;
+    DEVSUPFUN junk;
+};
+#define DSET(NAME, INITREC, RW) static dset6 NAME = {{6, NULL, NULL, (DEVSUPFUN)INITREC, NULL}, (DEVSUPFUN)RW, NULL}; \
+    epicsExportAddress(dset, NAME)
+
+} // namespace
+
+extern "C" {
+DSET(devExploreLiPCIe, &init_record_li, &read_li);
+DSET(devExploreBiPCIe, &init_record_bi, &read_bi);
+} // extern "C"
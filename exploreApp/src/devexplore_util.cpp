@@ -2,6 +2,8 @@
 #include <stdexcept>
 
 #include <errno.h>
+#include <ctype.h>
+#include <stdlib.h>
 
 #include <epicsVersion.h>
 #include <epicsStdlib.h>
@@ -107,3 +109,52 @@ epicsUInt32 parseU32(const std::string& s)
     }
     return ret;
 }
+
+epicsUInt64 parseU64(const std::string& s)
+{
+    const char *str = s.c_str();
+    char *endp;
+
+    while(isspace((unsigned char)*str))
+        str++;
+
+    // strtoull() accepts, and negates, a leading '-'
+    if(*str=='-')
+        throw std::runtime_error(SB()<<"Error parsing '"<<s<<"' : negative");
+
+    errno = 0;
+    unsigned long long value = strtoull(str, &endp, 0);
+
+    if(endp==str)
+        throw std::runtime_error(SB()<<"Error parsing '"<<s<<"' : no digits");
+    if(errno==ERANGE)
+        throw std::runtime_error(SB()<<"Error parsing '"<<s<<"' : overflow");
+
+    while(isspace((unsigned char)*endp))
+        endp++;
+    if(*endp)
+        throw std::runtime_error(SB()<<"Error parsing '"<<s<<"' : extraneous characters");
+
+    return value;
+}
+
+epicsFloat64 parseF64(const std::string& s)
+{
+    const char *str = s.c_str();
+    char *endp;
+
+    errno = 0;
+    double value = strtod(str, &endp);
+
+    if(endp==str)
+        throw std::runtime_error(SB()<<"Error parsing '"<<s<<"' : no digits");
+    if(errno==ERANGE)
+        throw std::runtime_error(SB()<<"Error parsing '"<<s<<"' : out of range");
+
+    while(isspace((unsigned char)*endp))
+        endp++;
+    if(*endp)
+        throw std::runtime_error(SB()<<"Error parsing '"<<s<<"' : extraneous characters");
+
+    return value;
+}
@@ -8,14 +8,30 @@
 #include <iostream>
 #include <string>
 
+#include <stdio.h>
+#include <string.h>
+
 #include <dbAccess.h>
 #include <dbBase.h>
 #include <dbChannel.h>
+#include <aaiRecord.h>
 #include <epicsMMIO.h>
+#include <epicsThread.h>
 
 #include <dbUnitTest.h>
 #include <testMain.h>
 
+#include "devlibversion.h"
+#include "devLibPCI.h"
+#include "devLibPCIImpl.h"
+#include "devLibMMIO.h"
+#include "devexplore.h"
+
+#if EPICS_VERSION_INT>=VERSION_INT(3,16,1,0)
+#  define EXPLORE_INT64
+#  define EXPLORE_SWAP_BPTR
+#endif
+
 #include <shareLib.h>
 
 epicsShareExtern
@@ -53,6 +69,17 @@ struct Channel {
         if(dbChannelPutField(chan, DBF_ULONG, &val[0], (long)val.size()))
             testAbort("get %s fails", dbChannelName(chan));
     }
+    void get_double(std::vector<epicsFloat64>& val) {
+        val.resize(dbChannelFinalElements(chan));
+        long nReq = (long)val.size();
+        if(dbChannelGetField(chan, DBF_DOUBLE, &val[0], NULL, &nReq, NULL))
+            testAbort("get %s fails", dbChannelName(chan));
+        val.resize(nReq);
+    }
+    void put_double(const std::vector<epicsFloat64>& val) {
+        if(dbChannelPutField(chan, DBF_DOUBLE, &val[0], (long)val.size()))
+            testAbort("put %s fails", dbChannelName(chan));
+    }
 };
 
 #define testEqual(A,B,msg) testOk((A)==(B), #A " (0x%x) == " #B " (0x%x) %s", (unsigned)(A), (unsigned)(B), msg)
@@ -264,6 +291,7 @@ void testWF()
     std::vector<epicsUInt32> val;
     Channel wfin32("wfin32"),
             wfin32_1("wfin32_1"),
+            wfin16_1("wfin16_1"),
             wfout32("wfout32"),
             wfout32_1("wfout32_1");
 
@@ -286,6 +314,14 @@ void testWF()
     testEqual(val[0], 0x12345678, "");
     testEqual(val[1], 0x12345678, "");
 
+    testDiag("read array LSB step=2");
+    testdbPutFieldOk("wfin16_1.PROC", DBF_LONG, 1);
+    wfin16_1.get_int32(val);
+    testEqual(val.size(), 2, "");
+    val.resize(2);
+    testEqual(val[0], 0x3412, "");
+    testEqual(val[1], 0x7856, "");
+
     testDiag("write array step=4");
     val.resize(2);
     val[0] = 0xdeadbeef;
@@ -295,11 +331,325 @@ void testWF()
     testVal(8, 0x1badface);
 }
 
+void testBlock()
+{
+    testDiag("read through shared snapshot");
+
+    writeVal(8, 0x11111111);
+    writeVal(12, 0x22222222);
+
+    // refreshes snapshot
+    testdbPutFieldOk("blkin_a.PROC", DBF_LONG, 1);
+    testdbGetFieldEqual("blkin_a", DBF_ULONG, 0x11111111);
+
+    writeVal(12, 0x33333333);
+
+    // first use of current snapshot
+    testdbPutFieldOk("blkin_b.PROC", DBF_LONG, 1);
+    testdbGetFieldEqual("blkin_b", DBF_ULONG, 0x22222222);
+
+    writeVal(16, 0xaabbccdd);
+
+    // already seen, so refreshes
+    testdbPutFieldOk("blkin_b.PROC", DBF_LONG, 1);
+    testdbGetFieldEqual("blkin_b", DBF_ULONG, 0x33333333);
+
+    // byte register member, from the same snapshot
+    testdbPutFieldOk("blkin_c.PROC", DBF_LONG, 1);
+    testdbGetFieldEqual("blkin_c", DBF_ULONG, 0xbb);
+}
+
+// wait for async processing to complete
+void waitIdle(const char *recname)
+{
+    std::string pact(recname);
+    pact+=".PACT";
+    Channel chan(pact.c_str());
+    std::vector<epicsUInt32> val;
+    for(unsigned i=0; i<500; i++) {
+        chan.get_int32(val);
+        if(val.size()==1 && val[0]==0)
+            return;
+        epicsThreadSleep(0.01);
+    }
+    testAbort("%s did not complete", recname);
+}
+
+void testAsync()
+{
+    testDiag("async=1 access through device worker");
+
+    writeVal(16, 0x12345678);
+    testdbPutFieldOk("asyncin.PROC", DBF_LONG, 1);
+    waitIdle("asyncin");
+    testdbGetFieldEqual("asyncin", DBF_ULONG, 0x12345678);
+
+    testdbPutFieldOk("asyncout", DBF_ULONG, 0x9abcdef0);
+    waitIdle("asyncout");
+    testVal(20, 0x9abcdef0);
+}
+
+#define STR2(X) #X
+#define STR(X) STR2(X)
+
+void testWC()
+{
+    const char *flush = STR(EXPLORE_WC_FLUSH());
+
+    testDiag("wc=1 writes are followed by %s", flush);
+#if defined(__GNUC__)
+    testOk(strstr(flush, "sfence") || strstr(flush, "dsb st") || strstr(flush, "sync"),
+           "wc=1 flush is a store fence");
+#else
+    testSkip(1, "store fence instructions only known for GCC");
+#endif
+
+    testWrite("wcout", 96, 4, 0x13572468, DBF_ULONG, 0x13572468);
+}
+
+void testDouble()
+{
+    testDiag("FTVL=DOUBLE with aslo/aoff, and float64 registers");
+
+    volatile char *base = (volatile char*)exploreTestBase;
+    be_iowrite16(base+48, 0x0002);
+    be_iowrite16(base+50, 0xfffe);
+    be_iowrite16(base+52, 0x7fff);
+
+    std::vector<epicsFloat64> val;
+    Channel wfdbl("wfdbl"),
+            wfdblout("wfdblout");
+
+    testdbPutFieldOk("wfdbl.PROC", DBF_LONG, 1);
+    wfdbl.get_double(val);
+    testOk1(val.size()==3);
+    val.resize(3);
+    testOk(val[0]==2.0, "%g == 2", val[0]);
+    testOk(val[1]==0.0, "%g == 0", val[1]);
+    testOk(val[2]==16384.5, "%g == 16384.5", val[2]);
+
+    testDiag("write rounds and clips");
+    val[0] = -1.0;
+    val[1] = 1.6;
+    val[2] = 1e9;
+    wfdblout.put_double(val);
+    testOk1(be_ioread16(base+56)==0xfffc);
+    testOk1(be_ioread16(base+58)==0x0001);
+    testOk1(be_ioread16(base+60)==0x7fff);
+
+    testDiag("signed= applies to the field selected by mask= and shift=");
+    Channel wfdbl12("wfdbl12"),
+            wfdbl8out("wfdbl8out");
+    testdbPutFieldOk("wfdbl12.PROC", DBF_LONG, 1);
+    wfdbl12.get_double(val);
+    testOk1(val.size()==3);
+    val.resize(3);
+    testOk(val[0]==0.0, "%g == 0", val[0]);
+    testOk(val[1]==-1.0, "%g == -1", val[1]);
+    testOk(val[2]==2047.0, "%g == 2047", val[2]);
+
+    val[0] = -1.0;
+    val[1] = 1e9;
+    val[2] = -1e9;
+    wfdbl8out.put_double(val);
+    testOk1(be_ioread16(base+56)==0xfffc);
+    testOk1(be_ioread16(base+58)==0x07f1);
+    testOk1(be_ioread16(base+60)==0x780f);
+
+    union {
+        epicsUInt64 ival;
+        epicsFloat64 fval;
+    } pun;
+    pun.fval = -1.25e100;
+    be_iowrite64(base+64, pun.ival);
+    testdbPutFieldOk("floatin64.PROC", DBF_LONG, 1);
+    testdbGetFieldEqual("floatin64", DBF_DOUBLE, pun.fval);
+
+    testdbPutFieldOk("floatout64", DBF_DOUBLE, 3.0e-200);
+    pun.ival = be_ioread64(base+72);
+    testOk(pun.fval==3.0e-200, "floatout64 %g", pun.fval);
+}
+
+void testAai()
+{
+    testDiag("aai/aao arrays");
+
+    std::vector<epicsUInt32> val;
+    Channel aaiin("aaiin"),
+            aaiasync("aaiasync"),
+            aaoout("aaoout");
+
+    writeVal(80, 0x01020304);
+    writeVal(84, 0x05060708);
+
+    testdbPutFieldOk("aaiin.PROC", DBF_LONG, 1);
+    aaiin.get_int32(val);
+    testEqual(val.size(), 2, "");
+    val.resize(2);
+    testEqual(val[0], 0x01020304, "");
+    testEqual(val[1], 0x05060708, "");
+
+    testDiag("async=1 fills the spare buffer, then swaps it into BPTR");
+    aaiRecord *prec = (aaiRecord*)dbChannelRecord(aaiasync.chan);
+    void *first, *second;
+    dbScanLock((dbCommon*)prec);
+    first = prec->bptr;
+    dbScanUnlock((dbCommon*)prec);
+
+    testdbPutFieldOk("aaiasync.PROC", DBF_LONG, 1);
+    waitIdle("aaiasync");
+    dbScanLock((dbCommon*)prec);
+    second = prec->bptr;
+    dbScanUnlock((dbCommon*)prec);
+    aaiasync.get_int32(val);
+    testEqual(val.size(), 2, "");
+    val.resize(2);
+    testEqual(val[0], 0x01020304, "");
+    testEqual(val[1], 0x05060708, "");
+
+    writeVal(80, 0x11121314);
+    testdbPutFieldOk("aaiasync.PROC", DBF_LONG, 1);
+    waitIdle("aaiasync");
+    aaiasync.get_int32(val);
+    val.resize(2);
+    testEqual(val[0], 0x11121314, "");
+    testEqual(val[1], 0x05060708, "");
+
+#ifdef EXPLORE_SWAP_BPTR
+    testOk(second!=first, "BPTR %p swapped from %p", second, first);
+#else
+    (void)first;
+    (void)second;
+    testSkip(1, "BPTR is copied with this Base version");
+#endif
+
+    testDiag("aao initread=1 fills BPTR from the initial register values");
+    aaoout.get_int32(val);
+    testEqual(val.size(), 2, "");
+    val.resize(2);
+    testEqual(val[0], 0xf8f9fafb, "");
+    testEqual(val[1], 0xfcfdfeff, "");
+
+    val[0] = 0xdeadbeef;
+    val[1] = 0x1badface;
+    aaoout.put_int32(val);
+    testVal(88, 0xdeadbeef);
+    testVal(92, 0x1badface);
+}
+
+#ifdef EXPLORE_INT64
+void setupInt64()
+{
+    FILE *fp;
+    if(!(fp = fopen("testexplore_int64.db", "w")))
+        testAbort("Can't write testexplore_int64.db");
+    fprintf(fp, "record(int64in, \"i64in\") { field(DTYP, \"Explore Read64 MSB\") field(INP, \"@test offset=32\") }\n"
+                "record(int64in, \"i64in_1\") { field(DTYP, \"Explore Read64 LSB\") field(INP, \"@test offset=32\") }\n"
+                "record(int64out, \"i64out\") { field(DTYP, \"Explore Write64 MSB\") field(OUT, \"@test offset=40\") }\n"
+                "record(waveform, \"wfin64\") { field(DTYP, \"Explore Read64 MSB\") field(INP, \"@test offset=32 step=8\")\n"
+                "  field(NELM, \"2\") field(FTVL, \"UINT64\") }\n");
+    fclose(fp);
+    testdbReadDatabase("testexplore_int64.db", NULL, NULL);
+    remove("testexplore_int64.db");
+}
+
+void testInt64()
+{
+    testDiag("64-bit registers");
+
+    volatile char *base = (volatile char*)exploreTestBase;
+    be_iowrite64(base+32, 0x0102030405060708ull);
+    be_iowrite64(base+40, 0x1112131415161718ull);
+
+    testdbPutFieldOk("i64in.PROC", DBF_LONG, 1);
+    testdbGetFieldEqual("i64in", DBF_INT64, (epicsInt64)0x0102030405060708ll);
+    testdbPutFieldOk("i64in_1.PROC", DBF_LONG, 1);
+    testdbGetFieldEqual("i64in_1", DBF_INT64, (epicsInt64)0x0807060504030201ll);
+
+    testdbPutFieldOk("wfin64.PROC", DBF_LONG, 1);
+    {
+        const epicsUInt64 expect[2] = {0x0102030405060708ull, 0x1112131415161718ull};
+        testdbGetArrFieldEqual("wfin64", DBF_UINT64, 2, 2, expect);
+    }
+
+    testdbPutFieldOk("i64out", DBF_INT64, (epicsInt64)0x2122232425262728ll);
+    epicsUInt64 actual = be_ioread64(base+40);
+    testOk(actual==0x2122232425262728ull, "i64out %016llx", (unsigned long long)actual);
+}
+#endif
+
+#ifdef __linux__
+// PCIe status of a simulated device, Gen3 x8 capable but trained at x4
+void setupPCIe()
+{
+    static const epicsPCIID anypci[] = {
+        DEVPCI_DEVICE_VENDOR(DEVPCI_ANY_DEVICE, DEVPCI_ANY_VENDOR),
+        DEVPCI_END
+    };
+    const epicsPCIDevice *dev = NULL;
+    FILE *fp;
+
+    if(!(fp = fopen("testexplore_pcie.txt", "w")))
+        testAbort("Can't write description file");
+    fprintf(fp, "1:0.0 vendor=0x10ee device=0x7011\n");
+    fclose(fp);
+
+    if(devLibPCISimLoad("testexplore_pcie.txt") || devLibPCIUse("sim"))
+        testAbort("Can't setup simulated PCI bus");
+    remove("testexplore_pcie.txt");
+
+    if(devPCIFindSpec(anypci, "1:0.0", &dev, 0))
+        testAbort("Simulated device not found");
+
+    // PCIe capability at 0x40, AER at 0x100
+    devPCIConfigWrite16(dev, 0x06, 0x0010);
+    devPCIConfigWrite8 (dev, 0x34, 0x40);
+    devPCIConfigWrite16(dev, 0x40, 0x0010);
+    devPCIConfigWrite32(dev, 0x4c, 0x00000083); // LnkCap Gen3 x8
+    devPCIConfigWrite16(dev, 0x52, 0x0043);     // LnkSta Gen3 x4
+    devPCIConfigWrite32(dev, 0x100, 0x00010001);
+    devPCIConfigWrite32(dev, 0x110, 0x00000041); // two correctable errors
+
+    if(!(fp = fopen("testexplore_pcie.db", "w")))
+        testAbort("Can't write testexplore_pcie.db");
+    fprintf(fp, "record(longin, \"pcie_speed\") { field(DTYP, \"Explore PCIe\") field(INP, \"@1:0.0 param=speed\") }\n"
+                "record(longin, \"pcie_width\") { field(DTYP, \"Explore PCIe\") field(INP, \"@1:0.0 param=width\") }\n"
+                "record(longin, \"pcie_maxwidth\") { field(DTYP, \"Explore PCIe\") field(INP, \"@1:0.0 param=maxwidth\") }\n"
+                "record(longin, \"pcie_corcnt\") { field(DTYP, \"Explore PCIe\") field(INP, \"@1:0.0 param=corcnt\") }\n"
+                "record(bi, \"pcie_degraded\") { field(DTYP, \"Explore PCIe\") field(INP, \"@1:0.0 param=degraded\") }\n");
+    fclose(fp);
+    testdbReadDatabase("testexplore_pcie.db", NULL, NULL);
+    remove("testexplore_pcie.db");
+}
+
+void testPCIe()
+{
+    testDiag("PCIe link and error status");
+    testdbPutFieldOk("pcie_speed.PROC", DBF_LONG, 1);
+    testdbPutFieldOk("pcie_width.PROC", DBF_LONG, 1);
+    testdbPutFieldOk("pcie_maxwidth.PROC", DBF_LONG, 1);
+    testdbPutFieldOk("pcie_corcnt.PROC", DBF_LONG, 1);
+    testdbPutFieldOk("pcie_degraded.PROC", DBF_LONG, 1);
+    testdbGetFieldEqual("pcie_speed", DBF_LONG, 3);
+    testdbGetFieldEqual("pcie_width", DBF_LONG, 4);
+    testdbGetFieldEqual("pcie_maxwidth", DBF_LONG, 8);
+    testdbGetFieldEqual("pcie_corcnt", DBF_LONG, 2);
+    testdbGetFieldEqual("pcie_degraded", DBF_LONG, 1);
+}
+#endif
+
 } // namespace
 
 MAIN(testexplore)
 {
-    testPlan(71);
+    int ntests = 127;
+#ifdef __linux__
+    ntests += 10;
+#endif
+#ifdef EXPLORE_INT64
+    ntests += 8;
+#endif
+    testPlan(ntests);
 
     {
         volatile char *base = (volatile char*)exploreTestBase;
@@ -314,6 +664,12 @@ MAIN(testexplore)
     testexplore_registerRecordDeviceDriver(pdbbase);
 
     testdbReadDatabase("testexplore.db", NULL, NULL);
+#ifdef EXPLORE_INT64
+    setupInt64();
+#endif
+#ifdef __linux__
+    setupPCIe();
+#endif
 
     testIocInitOk();
 
@@ -322,6 +678,17 @@ MAIN(testexplore)
     testScalarWrite();
     testFloatRW();
     testWF();
+    testBlock();
+    testAsync();
+    testWC();
+    testDouble();
+    testAai();
+#ifdef EXPLORE_INT64
+    testInt64();
+#endif
+#ifdef __linux__
+    testPCIe();
+#endif
 
     testIocShutdownOk();
 
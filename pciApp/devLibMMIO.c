@@ -0,0 +1,471 @@
+/*************************************************************************\
+* devLib2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+#include <string.h>
+
+#include <epicsEndian.h>
+#include <epicsMMIO.h>
+
+#define epicsExportSharedSymbols
+#include "devLibMMIO.h"
+
+#if EPICS_BYTE_ORDER == EPICS_ENDIAN_BIG
+#  define SWAP_BE 0
+#  define SWAP_LE 1
+#else
+#  define SWAP_BE 1
+#  define SWAP_LE 0
+#endif
+
+/* SIMD byte swap kernels.
+ * x86-64 has SSSE3 (pshufb) and AVX2 (vpshufb) versions selected at runtime,
+ * as neither is part of the baseline ABI.  NEON is always present on aarch64.
+ */
+#if defined(__x86_64__) && !defined(vxWorks) && !defined(__rtems__) && \
+    (defined(__clang__) ? (__clang_major__>=4) : (__GNUC__*100+__GNUC_MINOR__>=409))
+#  define MMIO_X86
+#  include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#  define MMIO_NEON
+#  include <arm_neon.h>
+#endif
+
+typedef void (*bswap16_fn)(epicsUInt16 *buf, size_t count);
+typedef void (*bswap32_fn)(epicsUInt32 *buf, size_t count);
+typedef void (*bswap64_fn)(epicsUInt64 *buf, size_t count);
+
+static
+void bswap16_scalar(epicsUInt16 *buf, size_t count)
+{
+    size_t i;
+    for(i=0; i<count; i++)
+        buf[i] = bswap16(buf[i]);
+}
+
+static
+void bswap32_scalar(epicsUInt32 *buf, size_t count)
+{
+    size_t i;
+    for(i=0; i<count; i++)
+        buf[i] = bswap32(buf[i]);
+}
+
+static
+void bswap64_scalar(epicsUInt64 *buf, size_t count)
+{
+    size_t i;
+    for(i=0; i<count; i++)
+        buf[i] = bswap64(buf[i]);
+}
+
+#ifdef MMIO_X86
+
+/* _mm_set_epi8() takes bytes 15 through 0.  Output byte k is input byte k^1, k^3 or k^7 */
+#define SHUF16 14,15,12,13,10,11,8,9,6,7,4,5,2,3,0,1
+#define SHUF32 12,13,14,15,8,9,10,11,4,5,6,7,0,1,2,3
+#define SHUF64 8,9,10,11,12,13,14,15,0,1,2,3,4,5,6,7
+
+__attribute__((target("ssse3")))
+static
+void bswap16_ssse3(epicsUInt16 *buf, size_t count)
+{
+    const __m128i shuf = _mm_set_epi8(SHUF16);
+    size_t i;
+    for(i=0; i+8<=count; i+=8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(buf+i));
+        _mm_storeu_si128((__m128i*)(buf+i), _mm_shuffle_epi8(v, shuf));
+    }
+    bswap16_scalar(buf+i, count-i);
+}
+
+__attribute__((target("ssse3")))
+static
+void bswap32_ssse3(epicsUInt32 *buf, size_t count)
+{
+    const __m128i shuf = _mm_set_epi8(SHUF32);
+    size_t i;
+    for(i=0; i+4<=count; i+=4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(buf+i));
+        _mm_storeu_si128((__m128i*)(buf+i), _mm_shuffle_epi8(v, shuf));
+    }
+    bswap32_scalar(buf+i, count-i);
+}
+
+__attribute__((target("ssse3")))
+static
+void bswap64_ssse3(epicsUInt64 *buf, size_t count)
+{
+    const __m128i shuf = _mm_set_epi8(SHUF64);
+    size_t i;
+    for(i=0; i+2<=count; i+=2) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(buf+i));
+        _mm_storeu_si128((__m128i*)(buf+i), _mm_shuffle_epi8(v, shuf));
+    }
+    bswap64_scalar(buf+i, count-i);
+}
+
+/* vpshufb shuffles within each 128-bit lane */
+__attribute__((target("avx2")))
+static
+void bswap16_avx2(epicsUInt16 *buf, size_t count)
+{
+    const __m256i shuf = _mm256_set_epi8(SHUF16, SHUF16);
+    size_t i;
+    for(i=0; i+16<=count; i+=16) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(buf+i));
+        _mm256_storeu_si256((__m256i*)(buf+i), _mm256_shuffle_epi8(v, shuf));
+    }
+    bswap16_scalar(buf+i, count-i);
+}
+
+__attribute__((target("avx2")))
+static
+void bswap32_avx2(epicsUInt32 *buf, size_t count)
+{
+    const __m256i shuf = _mm256_set_epi8(SHUF32, SHUF32);
+    size_t i;
+    for(i=0; i+8<=count; i+=8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(buf+i));
+        _mm256_storeu_si256((__m256i*)(buf+i), _mm256_shuffle_epi8(v, shuf));
+    }
+    bswap32_scalar(buf+i, count-i);
+}
+
+__attribute__((target("avx2")))
+static
+void bswap64_avx2(epicsUInt64 *buf, size_t count)
+{
+    const __m256i shuf = _mm256_set_epi8(SHUF64, SHUF64);
+    size_t i;
+    for(i=0; i+4<=count; i+=4) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(buf+i));
+        _mm256_storeu_si256((__m256i*)(buf+i), _mm256_shuffle_epi8(v, shuf));
+    }
+    bswap64_scalar(buf+i, count-i);
+}
+
+#elif defined(MMIO_NEON)
+
+static
+void bswap16_neon(epicsUInt16 *buf, size_t count)
+{
+    size_t i;
+    for(i=0; i+8<=count; i+=8)
+        vst1q_u16(buf+i, vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(vld1q_u16(buf+i)))));
+    bswap16_scalar(buf+i, count-i);
+}
+
+static
+void bswap32_neon(epicsUInt32 *buf, size_t count)
+{
+    size_t i;
+    for(i=0; i+4<=count; i+=4)
+        vst1q_u32(buf+i, vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(vld1q_u32(buf+i)))));
+    bswap32_scalar(buf+i, count-i);
+}
+
+static
+void bswap64_neon(epicsUInt64 *buf, size_t count)
+{
+    size_t i;
+    for(i=0; i+2<=count; i+=2)
+        vst1q_u64(buf+i, vreinterpretq_u64_u8(vrev64q_u8(vreinterpretq_u8_u64(vld1q_u64(buf+i)))));
+    bswap64_scalar(buf+i, count-i);
+}
+
+#endif
+
+/* The first call selects a kernel and replaces itself.
+ * Concurrent first calls all store the same result.
+ */
+static void bswap16_select(epicsUInt16 *buf, size_t count);
+static void bswap32_select(epicsUInt32 *buf, size_t count);
+static void bswap64_select(epicsUInt64 *buf, size_t count);
+
+static bswap16_fn bswap16_impl = &bswap16_select;
+static bswap32_fn bswap32_impl = &bswap32_select;
+static bswap64_fn bswap64_impl = &bswap64_select;
+
+static
+void bswap16_select(epicsUInt16 *buf, size_t count)
+{
+    bswap16_fn fn = &bswap16_scalar;
+#if defined(MMIO_X86)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        fn = &bswap16_avx2;
+    else if(__builtin_cpu_supports("ssse3"))
+        fn = &bswap16_ssse3;
+#elif defined(MMIO_NEON)
+    fn = &bswap16_neon;
+#endif
+    bswap16_impl = fn;
+    (*fn)(buf, count);
+}
+
+static
+void bswap32_select(epicsUInt32 *buf, size_t count)
+{
+    bswap32_fn fn = &bswap32_scalar;
+#if defined(MMIO_X86)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        fn = &bswap32_avx2;
+    else if(__builtin_cpu_supports("ssse3"))
+        fn = &bswap32_ssse3;
+#elif defined(MMIO_NEON)
+    fn = &bswap32_neon;
+#endif
+    bswap32_impl = fn;
+    (*fn)(buf, count);
+}
+
+static
+void bswap64_select(epicsUInt64 *buf, size_t count)
+{
+    bswap64_fn fn = &bswap64_scalar;
+#if defined(MMIO_X86)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        fn = &bswap64_avx2;
+    else if(__builtin_cpu_supports("ssse3"))
+        fn = &bswap64_ssse3;
+#elif defined(MMIO_NEON)
+    fn = &bswap64_neon;
+#endif
+    bswap64_impl = fn;
+    (*fn)(buf, count);
+}
+
+void bswap16_array(epicsUInt16 *buf, size_t count)
+{
+    (*bswap16_impl)(buf, count);
+}
+
+void bswap32_array(epicsUInt32 *buf, size_t count)
+{
+    (*bswap32_impl)(buf, count);
+}
+
+void bswap64_array(epicsUInt64 *buf, size_t count)
+{
+    (*bswap64_impl)(buf, count);
+}
+
+/* Generic transfers.  'step' is 0 for _rep, or the element size for _block.
+ * Element accesses are relaxed, with one barrier after all reads
+ * or before all writes.
+ */
+
+static
+void read8(volatile void *addr, epicsUInt8 *buf, size_t count, size_t step)
+{
+    volatile char *src = (volatile char*)addr;
+    size_t i;
+    for(i=0; i<count; i++, src+=step)
+        buf[i] = ioread8_relaxed(src);
+    devlib_rbarr();
+}
+
+static
+void write8(volatile void *addr, const epicsUInt8 *buf, size_t count, size_t step)
+{
+    volatile char *dst = (volatile char*)addr;
+    size_t i;
+    devlib_wbarr();
+    for(i=0; i<count; i++, dst+=step)
+        iowrite8_relaxed(dst, buf[i]);
+}
+
+static
+void read16(volatile void *addr, epicsUInt16 *buf, size_t count, size_t step, int swap)
+{
+    volatile char *src = (volatile char*)addr;
+    size_t i;
+    for(i=0; i<count; i++, src+=step)
+        buf[i] = nat_ioread16_relaxed(src);
+    devlib_rbarr();
+    if(swap)
+        bswap16_array(buf, count);
+}
+
+static
+void read32(volatile void *addr, epicsUInt32 *buf, size_t count, size_t step, int swap)
+{
+    volatile char *src = (volatile char*)addr;
+    size_t i;
+    for(i=0; i<count; i++, src+=step)
+        buf[i] = nat_ioread32_relaxed(src);
+    devlib_rbarr();
+    if(swap)
+        bswap32_array(buf, count);
+}
+
+static
+void read64(volatile void *addr, epicsUInt64 *buf, size_t count, size_t step, int swap)
+{
+    volatile char *src = (volatile char*)addr;
+    size_t i;
+    for(i=0; i<count; i++, src+=step)
+        buf[i] = nat_ioread64_relaxed(src);
+    devlib_rbarr();
+    if(swap)
+        bswap64_array(buf, count);
+}
+
+/* The caller's buffer is const, so swap a chunk at a time on the stack */
+#define CHUNK 64
+
+static
+void write16(volatile void *addr, const epicsUInt16 *buf, size_t count, size_t step, int swap)
+{
+    volatile char *dst = (volatile char*)addr;
+    epicsUInt16 tmp[CHUNK];
+
+    devlib_wbarr();
+    while(count) {
+        size_t i, n = count<CHUNK ? count : CHUNK;
+        const epicsUInt16 *src = buf;
+
+        if(swap) {
+            memcpy(tmp, buf, n*sizeof(*tmp));
+            bswap16_array(tmp, n);
+            src = tmp;
+        }
+        for(i=0; i<n; i++, dst+=step)
+            nat_iowrite16_relaxed(dst, src[i]);
+
+        buf += n;
+        count -= n;
+    }
+}
+
+static
+void write32(volatile void *addr, const epicsUInt32 *buf, size_t count, size_t step, int swap)
+{
+    volatile char *dst = (volatile char*)addr;
+    epicsUInt32 tmp[CHUNK];
+
+    devlib_wbarr();
+    while(count) {
+        size_t i, n = count<CHUNK ? count : CHUNK;
+        const epicsUInt32 *src = buf;
+
+        if(swap) {
+            memcpy(tmp, buf, n*sizeof(*tmp));
+            bswap32_array(tmp, n);
+            src = tmp;
+        }
+        for(i=0; i<n; i++, dst+=step)
+            nat_iowrite32_relaxed(dst, src[i]);
+
+        buf += n;
+        count -= n;
+    }
+}
+
+static
+void write64(volatile void *addr, const epicsUInt64 *buf, size_t count, size_t step, int swap)
+{
+    volatile char *dst = (volatile char*)addr;
+    epicsUInt64 tmp[CHUNK];
+
+    devlib_wbarr();
+    while(count) {
+        size_t i, n = count<CHUNK ? count : CHUNK;
+        const epicsUInt64 *src = buf;
+
+        if(swap) {
+            memcpy(tmp, buf, n*sizeof(*tmp));
+            bswap64_array(tmp, n);
+            src = tmp;
+        }
+        for(i=0; i<n; i++, dst+=step)
+            nat_iowrite64_relaxed(dst, src[i]);
+
+        buf += n;
+        count -= n;
+    }
+}
+
+void ioread8_rep(volatile void *addr, epicsUInt8 *buf, size_t count) { read8(addr, buf, count, 0); }
+void iowrite8_rep(volatile void *addr, const epicsUInt8 *buf, size_t count) { write8(addr, buf, count, 0); }
+void ioread8_block(volatile void *addr, epicsUInt8 *buf, size_t count) { read8(addr, buf, count, 1); }
+void iowrite8_block(volatile void *addr, const epicsUInt8 *buf, size_t count) { write8(addr, buf, count, 1); }
+
+void nat_ioread16_rep(volatile void *addr, epicsUInt16 *buf, size_t count) { read16(addr, buf, count, 0, 0); }
+void be_ioread16_rep(volatile void *addr, epicsUInt16 *buf, size_t count) { read16(addr, buf, count, 0, SWAP_BE); }
+void le_ioread16_rep(volatile void *addr, epicsUInt16 *buf, size_t count) { read16(addr, buf, count, 0, SWAP_LE); }
+void nat_iowrite16_rep(volatile void *addr, const epicsUInt16 *buf, size_t count) { write16(addr, buf, count, 0, 0); }
+void be_iowrite16_rep(volatile void *addr, const epicsUInt16 *buf, size_t count) { write16(addr, buf, count, 0, SWAP_BE); }
+void le_iowrite16_rep(volatile void *addr, const epicsUInt16 *buf, size_t count) { write16(addr, buf, count, 0, SWAP_LE); }
+
+void nat_ioread16_block(volatile void *addr, epicsUInt16 *buf, size_t count) { read16(addr, buf, count, 2, 0); }
+void be_ioread16_block(volatile void *addr, epicsUInt16 *buf, size_t count) { read16(addr, buf, count, 2, SWAP_BE); }
+void le_ioread16_block(volatile void *addr, epicsUInt16 *buf, size_t count) { read16(addr, buf, count, 2, SWAP_LE); }
+void nat_iowrite16_block(volatile void *addr, const epicsUInt16 *buf, size_t count) { write16(addr, buf, count, 2, 0); }
+void be_iowrite16_block(volatile void *addr, const epicsUInt16 *buf, size_t count) { write16(addr, buf, count, 2, SWAP_BE); }
+void le_iowrite16_block(volatile void *addr, const epicsUInt16 *buf, size_t count) { write16(addr, buf, count, 2, SWAP_LE); }
+
+void nat_ioread32_rep(volatile void *addr, epicsUInt32 *buf, size_t count) { read32(addr, buf, count, 0, 0); }
+void be_ioread32_rep(volatile void *addr, epicsUInt32 *buf, size_t count) { read32(addr, buf, count, 0, SWAP_BE); }
+void le_ioread32_rep(volatile void *addr, epicsUInt32 *buf, size_t count) { read32(addr, buf, count, 0, SWAP_LE); }
+void nat_iowrite32_rep(volatile void *addr, const epicsUInt32 *buf, size_t count) { write32(addr, buf, count, 0, 0); }
+void be_iowrite32_rep(volatile void *addr, const epicsUInt32 *buf, size_t count) { write32(addr, buf, count, 0, SWAP_BE); }
+void le_iowrite32_rep(volatile void *addr, const epicsUInt32 *buf, size_t count) { write32(addr, buf, count, 0, SWAP_LE); }
+
+void nat_ioread32_block(volatile void *addr, epicsUInt32 *buf, size_t count) { read32(addr, buf, count, 4, 0); }
+void be_ioread32_block(volatile void *addr, epicsUInt32 *buf, size_t count) { read32(addr, buf, count, 4, SWAP_BE); }
+void le_ioread32_block(volatile void *addr, epicsUInt32 *buf, size_t count) { read32(addr, buf, count, 4, SWAP_LE); }
+void nat_iowrite32_block(volatile void *addr, const epicsUInt32 *buf, size_t count) { write32(addr, buf, count, 4, 0); }
+void be_iowrite32_block(volatile void *addr, const epicsUInt32 *buf, size_t count) { write32(addr, buf, count, 4, SWAP_BE); }
+void le_iowrite32_block(volatile void *addr, const epicsUInt32 *buf, size_t count) { write32(addr, buf, count, 4, SWAP_LE); }
+
+void nat_ioread64_rep(volatile void *addr, epicsUInt64 *buf, size_t count) { read64(addr, buf, count, 0, 0); }
+void be_ioread64_rep(volatile void *addr, epicsUInt64 *buf, size_t count) { read64(addr, buf, count, 0, SWAP_BE); }
+void le_ioread64_rep(volatile void *addr, epicsUInt64 *buf, size_t count) { read64(addr, buf, count, 0, SWAP_LE); }
+void nat_iowrite64_rep(volatile void *addr, const epicsUInt64 *buf, size_t count) { write64(addr, buf, count, 0, 0); }
+void be_iowrite64_rep(volatile void *addr, const epicsUInt64 *buf, size_t count) { write64(addr, buf, count, 0, SWAP_BE); }
+void le_iowrite64_rep(volatile void *addr, const epicsUInt64 *buf, size_t count) { write64(addr, buf, count, 0, SWAP_LE); }
+
+void nat_ioread64_block(volatile void *addr, epicsUInt64 *buf, size_t count) { read64(addr, buf, count, 8, 0); }
+void be_ioread64_block(volatile void *addr, epicsUInt64 *buf, size_t count) { read64(addr, buf, count, 8, SWAP_BE); }
+void le_ioread64_block(volatile void *addr, epicsUInt64 *buf, size_t count) { read64(addr, buf, count, 8, SWAP_LE); }
+void nat_iowrite64_block(volatile void *addr, const epicsUInt64 *buf, size_t count) { write64(addr, buf, count, 8, 0); }
+void be_iowrite64_block(volatile void *addr, const epicsUInt64 *buf, size_t count) { write64(addr, buf, count, 8, SWAP_BE); }
+void le_iowrite64_block(volatile void *addr, const epicsUInt64 *buf, size_t count) { write64(addr, buf, count, 8, SWAP_LE); }
+
+void memcpy_fromio(void *dst, volatile void *src, size_t len)
+{
+    epicsUInt8 *d = (epicsUInt8*)dst;
+    volatile char *s = (volatile char*)src;
+
+    for(; len && ((size_t)s&3u); len--)
+        *d++ = ioread8_relaxed(s++);
+    for(; len>=4; len-=4, s+=4, d+=4) {
+        epicsUInt32 val = nat_ioread32_relaxed(s);
+        memcpy(d, &val, 4);
+    }
+    for(; len; len--)
+        *d++ = ioread8_relaxed(s++);
+    devlib_rbarr();
+}
+
+void memcpy_toio(volatile void *dst, const void *src, size_t len)
+{
+    volatile char *d = (volatile char*)dst;
+    const epicsUInt8 *s = (const epicsUInt8*)src;
+
+    devlib_wbarr();
+    for(; len && ((size_t)d&3u); len--)
+        iowrite8_relaxed(d++, *s++);
+    for(; len>=4; len-=4, s+=4, d+=4) {
+        epicsUInt32 val;
+        memcpy(&val, s, 4);
+        nat_iowrite32_relaxed(d, val);
+    }
+    for(; len; len--)
+        iowrite8_relaxed(d++, *s++);
+}
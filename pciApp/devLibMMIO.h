@@ -0,0 +1,246 @@
+/*************************************************************************\
+* devLib2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+#ifndef DEVLIBMMIO_H_INC
+#define DEVLIBMMIO_H_INC 1
+
+#include <stddef.h>
+
+#include <epicsTypes.h>
+#include <epicsEndian.h>
+#include <epicsMMIO.h>
+#include <shareLib.h>
+
+/* Barriers of this module.
+ *
+ * The rbarr()/wbarr()/rwbarr() of the epicsMMIO.h included with EPICS Base >=3.15.1
+ * do nothing on most targets, and that header is used in place of the one in this module.
+ * devlib_rbarr()/devlib_wbarr()/devlib_rwbarr() are the same barriers as
+ * in common/os/default/epicsMMIODef.h , whichever epicsMMIO.h is in use.
+ * devlib_wbarr() also flushes write combining buffers (see DEVLIB_MAP_WC).
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__SSE2__))
+#  define devlib_rbarr()  __asm__ __volatile__ ("lfence" ::: "memory")
+#  define devlib_wbarr()  __asm__ __volatile__ ("sfence" ::: "memory")
+#  define devlib_rwbarr() __asm__ __volatile__ ("mfence" ::: "memory")
+#elif defined(__GNUC__) && defined(__aarch64__)
+#  define devlib_rbarr()  __asm__ __volatile__ ("dsb ld" ::: "memory")
+#  define devlib_wbarr()  __asm__ __volatile__ ("dsb st" ::: "memory")
+#  define devlib_rwbarr() __asm__ __volatile__ ("dsb sy" ::: "memory")
+#elif defined(__GNUC__) && (defined(__powerpc__) || defined(__PPC__) || defined(_ARCH_PPC))
+#  define devlib_rbarr()  __asm__ __volatile__ ("sync" ::: "memory")
+#  define devlib_wbarr()  __asm__ __volatile__ ("sync" ::: "memory")
+#  define devlib_rwbarr() __asm__ __volatile__ ("sync" ::: "memory")
+#elif defined(__GNUC__)
+#  define devlib_rbarr()  __sync_synchronize()
+#  define devlib_wbarr()  __sync_synchronize()
+#  define devlib_rwbarr() __sync_synchronize()
+#else
+/* Unknown compiler.  Whatever epicsMMIO.h provides */
+#  define devlib_rbarr()  rbarr()
+#  define devlib_wbarr()  wbarr()
+#  define devlib_rwbarr() rwbarr()
+#endif
+
+/* The epicsMMIO.h included with EPICS Base >=3.15.1 does not define
+ * the relaxed operations.  Substituting the operations of that header is always correct,
+ * as they imply no more ordering than the relaxed operations.
+ * Code using them orders with respect to normal memory through the devlib_*barr() above.
+ */
+#ifndef EPICSMMIO_HAS_RELAXED
+#  define EPICSMMIO_HAS_RELAXED 1
+#  define ioread8_relaxed           ioread8
+#  define iowrite8_relaxed          iowrite8
+#  define nat_ioread16_relaxed      nat_ioread16
+#  define nat_ioread32_relaxed      nat_ioread32
+#  define nat_iowrite16_relaxed     nat_iowrite16
+#  define nat_iowrite32_relaxed     nat_iowrite32
+#  define be_ioread16_relaxed       be_ioread16
+#  define be_ioread32_relaxed       be_ioread32
+#  define be_iowrite16_relaxed      be_iowrite16
+#  define be_iowrite32_relaxed      be_iowrite32
+#  define le_ioread16_relaxed       le_ioread16
+#  define le_ioread32_relaxed       le_ioread32
+#  define le_iowrite16_relaxed      le_iowrite16
+#  define le_iowrite32_relaxed      le_iowrite32
+#endif
+
+/* 64-bit operations, where not provided by epicsMMIO.h */
+#ifndef EPICSMMIO_HAS_64
+#  define EPICSMMIO_HAS_64 1
+
+INLINE
+epicsUInt64
+bswap64(epicsUInt64 value)
+{
+    return (((epicsUInt64)(value) & 0x00000000000000ffull) << 56) |
+           (((epicsUInt64)(value) & 0x000000000000ff00ull) << 40) |
+           (((epicsUInt64)(value) & 0x0000000000ff0000ull) << 24) |
+           (((epicsUInt64)(value) & 0x00000000ff000000ull) << 8)  |
+           (((epicsUInt64)(value) & 0x000000ff00000000ull) >> 8)  |
+           (((epicsUInt64)(value) & 0x0000ff0000000000ull) >> 24) |
+           (((epicsUInt64)(value) & 0x00ff000000000000ull) >> 40) |
+           (((epicsUInt64)(value) & 0xff00000000000000ull) >> 56);
+}
+
+INLINE
+epicsUInt64
+nat_ioread64_relaxed(volatile void* addr)
+{
+    return *(volatile epicsUInt64*)(addr);
+}
+
+INLINE
+void
+nat_iowrite64_relaxed(volatile void* addr, epicsUInt64 val)
+{
+    *(volatile epicsUInt64*)(addr) = val;
+}
+
+INLINE
+epicsUInt64
+nat_ioread64(volatile void* addr)
+{
+    epicsUInt64 val = nat_ioread64_relaxed(addr);
+    devlib_rbarr();
+    return val;
+}
+
+INLINE
+void
+nat_iowrite64(volatile void* addr, epicsUInt64 val)
+{
+    devlib_wbarr();
+    nat_iowrite64_relaxed(addr, val);
+}
+
+#  if EPICS_BYTE_ORDER == EPICS_ENDIAN_BIG
+#    define be_ioread64(A)    nat_ioread64(A)
+#    define be_iowrite64(A,D) nat_iowrite64(A,D)
+#    define le_ioread64(A)    bswap64(nat_ioread64(A))
+#    define le_iowrite64(A,D) nat_iowrite64(A,bswap64(D))
+#    define be_ioread64_relaxed(A)    nat_ioread64_relaxed(A)
+#    define be_iowrite64_relaxed(A,D) nat_iowrite64_relaxed(A,D)
+#    define le_ioread64_relaxed(A)    bswap64(nat_ioread64_relaxed(A))
+#    define le_iowrite64_relaxed(A,D) nat_iowrite64_relaxed(A,bswap64(D))
+#  else
+#    define be_ioread64(A)    bswap64(nat_ioread64(A))
+#    define be_iowrite64(A,D) nat_iowrite64(A,bswap64(D))
+#    define le_ioread64(A)    nat_ioread64(A)
+#    define le_iowrite64(A,D) nat_iowrite64(A,D)
+#    define be_ioread64_relaxed(A)    bswap64(nat_ioread64_relaxed(A))
+#    define be_iowrite64_relaxed(A,D) nat_iowrite64_relaxed(A,bswap64(D))
+#    define le_ioread64_relaxed(A)    nat_ioread64_relaxed(A)
+#    define le_iowrite64_relaxed(A,D) nat_iowrite64_relaxed(A,D)
+#  endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup mmiobulk Bulk Memory Mapped I/O
+ *
+ * Transfers of many elements between I/O memory and a buffer in normal memory,
+ * complementing the single element operations of @ref mmio .
+ *
+ * Each element is accessed with one operation of its width,
+ * in order of increasing address (or repeatedly at one address for the _rep variants),
+ * as the equivalent loop of single element operations would.
+ * Ordering is as for a single operation at the start or end of the transfer.
+ * ie. a read transfer completes before following accesses to normal memory,
+ * and a write transfer is preceded by earlier writes to normal memory.
+ * The individual element accesses are relaxed (see @ref mmiorelax ).
+ * Conversion of byte order is done as a separate pass over the buffer in normal memory,
+ * using SIMD instructions where the host supports them.
+ *
+ * Naming follows @ref mmio . 'nat_' transfers in host order, 'be_' and 'le_'
+ * convert from/to big or little endian device order.
+ *
+ * @li T_ioread#_rep and T_iowrite#_rep access the same address 'count' times.  eg. a FIFO register.
+ * @li T_ioread#_block and T_iowrite#_block access 'count' consecutive elements.
+ *
+ *@{
+ */
+
+/** @brief Byte swap an array of two byte values in normal memory */
+epicsShareFunc void bswap16_array(epicsUInt16 *buf, size_t count);
+/** @brief Byte swap an array of four byte values in normal memory */
+epicsShareFunc void bswap32_array(epicsUInt32 *buf, size_t count);
+/** @brief Byte swap an array of eight byte values in normal memory */
+epicsShareFunc void bswap64_array(epicsUInt64 *buf, size_t count);
+
+/** @brief Read one byte register 'count' times */
+epicsShareFunc void ioread8_rep(volatile void *addr, epicsUInt8 *buf, size_t count);
+/** @brief Write one byte register 'count' times */
+epicsShareFunc void iowrite8_rep(volatile void *addr, const epicsUInt8 *buf, size_t count);
+
+epicsShareFunc void nat_ioread16_rep(volatile void *addr, epicsUInt16 *buf, size_t count);
+epicsShareFunc void be_ioread16_rep(volatile void *addr, epicsUInt16 *buf, size_t count);
+epicsShareFunc void le_ioread16_rep(volatile void *addr, epicsUInt16 *buf, size_t count);
+epicsShareFunc void nat_iowrite16_rep(volatile void *addr, const epicsUInt16 *buf, size_t count);
+epicsShareFunc void be_iowrite16_rep(volatile void *addr, const epicsUInt16 *buf, size_t count);
+epicsShareFunc void le_iowrite16_rep(volatile void *addr, const epicsUInt16 *buf, size_t count);
+
+epicsShareFunc void nat_ioread32_rep(volatile void *addr, epicsUInt32 *buf, size_t count);
+epicsShareFunc void be_ioread32_rep(volatile void *addr, epicsUInt32 *buf, size_t count);
+epicsShareFunc void le_ioread32_rep(volatile void *addr, epicsUInt32 *buf, size_t count);
+epicsShareFunc void nat_iowrite32_rep(volatile void *addr, const epicsUInt32 *buf, size_t count);
+epicsShareFunc void be_iowrite32_rep(volatile void *addr, const epicsUInt32 *buf, size_t count);
+epicsShareFunc void le_iowrite32_rep(volatile void *addr, const epicsUInt32 *buf, size_t count);
+
+epicsShareFunc void nat_ioread64_rep(volatile void *addr, epicsUInt64 *buf, size_t count);
+epicsShareFunc void be_ioread64_rep(volatile void *addr, epicsUInt64 *buf, size_t count);
+epicsShareFunc void le_ioread64_rep(volatile void *addr, epicsUInt64 *buf, size_t count);
+epicsShareFunc void nat_iowrite64_rep(volatile void *addr, const epicsUInt64 *buf, size_t count);
+epicsShareFunc void be_iowrite64_rep(volatile void *addr, const epicsUInt64 *buf, size_t count);
+epicsShareFunc void le_iowrite64_rep(volatile void *addr, const epicsUInt64 *buf, size_t count);
+
+/** @brief Read 'count' consecutive bytes */
+epicsShareFunc void ioread8_block(volatile void *addr, epicsUInt8 *buf, size_t count);
+/** @brief Write 'count' consecutive bytes */
+epicsShareFunc void iowrite8_block(volatile void *addr, const epicsUInt8 *buf, size_t count);
+
+epicsShareFunc void nat_ioread16_block(volatile void *addr, epicsUInt16 *buf, size_t count);
+epicsShareFunc void be_ioread16_block(volatile void *addr, epicsUInt16 *buf, size_t count);
+epicsShareFunc void le_ioread16_block(volatile void *addr, epicsUInt16 *buf, size_t count);
+epicsShareFunc void nat_iowrite16_block(volatile void *addr, const epicsUInt16 *buf, size_t count);
+epicsShareFunc void be_iowrite16_block(volatile void *addr, const epicsUInt16 *buf, size_t count);
+epicsShareFunc void le_iowrite16_block(volatile void *addr, const epicsUInt16 *buf, size_t count);
+
+epicsShareFunc void nat_ioread32_block(volatile void *addr, epicsUInt32 *buf, size_t count);
+epicsShareFunc void be_ioread32_block(volatile void *addr, epicsUInt32 *buf, size_t count);
+epicsShareFunc void le_ioread32_block(volatile void *addr, epicsUInt32 *buf, size_t count);
+epicsShareFunc void nat_iowrite32_block(volatile void *addr, const epicsUInt32 *buf, size_t count);
+epicsShareFunc void be_iowrite32_block(volatile void *addr, const epicsUInt32 *buf, size_t count);
+epicsShareFunc void le_iowrite32_block(volatile void *addr, const epicsUInt32 *buf, size_t count);
+
+epicsShareFunc void nat_ioread64_block(volatile void *addr, epicsUInt64 *buf, size_t count);
+epicsShareFunc void be_ioread64_block(volatile void *addr, epicsUInt64 *buf, size_t count);
+epicsShareFunc void le_ioread64_block(volatile void *addr, epicsUInt64 *buf, size_t count);
+epicsShareFunc void nat_iowrite64_block(volatile void *addr, const epicsUInt64 *buf, size_t count);
+epicsShareFunc void be_iowrite64_block(volatile void *addr, const epicsUInt64 *buf, size_t count);
+epicsShareFunc void le_iowrite64_block(volatile void *addr, const epicsUInt64 *buf, size_t count);
+
+/** @brief Copy 'len' bytes from I/O memory.
+ *
+ * Uses four byte reads where the I/O address is aligned, and single byte reads otherwise.
+ * Not suitable for registers which must be accessed with a particular width.
+ */
+epicsShareFunc void memcpy_fromio(void *dst, volatile void *src, size_t len);
+/** @brief Copy 'len' bytes to I/O memory.
+ *
+ * Uses four byte writes where the I/O address is aligned, and single byte writes otherwise.
+ * Not suitable for registers which must be accessed with a particular width.
+ */
+epicsShareFunc void memcpy_toio(volatile void *dst, const void *src, size_t len);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DEVLIBMMIO_H_INC */
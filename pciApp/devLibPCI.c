@@ -18,6 +18,7 @@
 #include <epicsMutex.h>
 #include <iocsh.h>
 #include <epicsStdio.h>
+#include <epicsString.h>
 
 #define epicsExportSharedSymbols
 #include "devLibPCIImpl.h"
@@ -46,6 +47,9 @@
 #endif
 
 int devPCIDebug = 0;
+int devPCIISRThreads = 0;
+int devPCIEnumThreads = 0;
+int devPCIHotplug = 0;
 
 static ELLLIST pciDrivers;
 
@@ -183,6 +187,447 @@ devLibPCIMatch(const epicsPCIID *match, const epicsPCIID *dev)
     }
 }
 
+/******************* Spec. matcher *********************/
+
+/* A devPCIFindSpec() string compiled once, and cached by text.
+ * Entries are never modified or freed after being added to the cache.
+ */
+typedef struct pciSpec {
+    struct pciSpec *next; /* hash chain */
+    const char *str; /* the spec. string */
+    int err;
+
+    unsigned int matchaddr:1;
+    unsigned int matchslot:1;
+    unsigned int matchvendor:1;
+    unsigned int matchdevice:1;
+    unsigned int matchclass:1;
+    unsigned int matchsubvendor:1;
+    unsigned int matchsubdevice:1;
+
+    unsigned int domain,b,d,f;
+    const char *slot;
+    unsigned int vendor, device, sub_vendor, sub_device;
+    epicsUInt32 pci_class, class_mask;
+    unsigned int stopat;
+} pciSpec;
+
+#define PCISPEC_NBUCKETS 64
+
+static epicsMutexId pciSpecLock;
+static pciSpec *pciSpecCache[PCISPEC_NBUCKETS];
+
+static
+int pciSpecMatch(const pciSpec *spec, const epicsPCIDevice* dev)
+{
+    if(spec->matchaddr && (dev->domain!=spec->domain || dev->bus!=spec->b ||
+                           dev->device!=spec->d || dev->function!=spec->f))
+        return 0;
+
+    if(spec->matchslot && (dev->slot==DEVPCI_NO_SLOT || strcmp(dev->slot, spec->slot)!=0))
+        return 0;
+
+    if(spec->matchvendor && dev->id.vendor!=spec->vendor)
+        return 0;
+    if(spec->matchdevice && dev->id.device!=spec->device)
+        return 0;
+    if(spec->matchsubvendor && dev->id.sub_vendor!=spec->sub_vendor)
+        return 0;
+    if(spec->matchsubdevice && dev->id.sub_device!=spec->sub_device)
+        return 0;
+    if(spec->matchclass && (dev->id.pci_class&spec->class_mask)!=spec->pci_class)
+        return 0;
+
+    return 1;
+}
+
+/* Parse all of 'str' as hex with optional 0x prefix.
+ * Returns the number of digits, or 0 on error.
+ */
+static
+size_t pciSpecHex(const char *str, epicsUInt32 max, unsigned *val)
+{
+    char *end = NULL;
+    unsigned long lval;
+    size_t ndigits;
+
+    if(str[0]=='0' && (str[1]=='x' || str[1]=='X'))
+        str += 2;
+    ndigits = strspn(str, "0123456789abcdefABCDEF");
+
+    if(ndigits==0 || str[ndigits]!='\0')
+        return 0;
+
+    lval = strtoul(str, &end, 16);
+    if(lval>max)
+        return 0;
+
+    *val = lval;
+    return ndigits;
+}
+
+/* Split 'buf' in place, and fill in 'spec'. */
+static
+void pciSpecCompile(pciSpec *spec, char *buf)
+{
+    char *save, *tok;
+
+    for(tok = strtok_r(buf, " ", &save);
+        tok;
+        tok=strtok_r(NULL, " ", &save))
+    {
+        unsigned dom, bus, dev, func=0;
+        size_t ndigits;
+        char *val = strchr(tok, '=');
+
+        if(val)
+            *val++ = '\0';
+
+        if(!val && sscanf(tok, "%x:%x:%x.%x", &dom, &bus, &dev, &func)>=3) {
+            spec->matchaddr = 1;
+            spec->domain = dom;
+            spec->b = bus;
+            spec->d = dev;
+            spec->f = func;
+
+        } else if(!val && sscanf(tok, "%x:%x.%x", &bus, &dev, &func)>=2) {
+            spec->matchaddr = 1;
+            spec->domain = 0;
+            spec->b = bus;
+            spec->d = dev;
+            spec->f = func;
+
+        } else if(!val) {
+            fprintf(stderr, "Error: invalid spec '%s'\n", tok);
+            spec->err = S_dev_badArgument;
+
+        } else if(strcmp(tok, "slot")==0) {
+            spec->slot = val;
+            spec->matchslot = 1;
+
+        } else if(strcmp(tok, "instance")==0 || strcmp(tok, "inst")==0) {
+            char *end = NULL;
+            unsigned long inst = strtoul(val, &end, 10);
+            if(end==val || *end!='\0') {
+                fprintf(stderr, "Error: invalid instance '%s'\n", val);
+                spec->err = S_dev_badArgument;
+            }
+            spec->stopat = inst==0 ? 0 : inst-1;
+
+        } else if(strcmp(tok, "vendor")==0) {
+            if(!pciSpecHex(val, 0xffff, &spec->vendor)) {
+                fprintf(stderr, "Error: invalid vendor '%s'\n", val);
+                spec->err = S_dev_badArgument;
+            }
+            spec->matchvendor = 1;
+
+        } else if(strcmp(tok, "device")==0) {
+            if(!pciSpecHex(val, 0xffff, &spec->device)) {
+                fprintf(stderr, "Error: invalid device '%s'\n", val);
+                spec->err = S_dev_badArgument;
+            }
+            spec->matchdevice = 1;
+
+        } else if(strcmp(tok, "sub")==0) {
+            char *sep = strchr(val, ':');
+            if(sep)
+                *sep++ = '\0';
+
+            if(!pciSpecHex(val, 0xffff, &spec->sub_vendor) ||
+                    (sep && !pciSpecHex(sep, 0xffff, &spec->sub_device))) {
+                fprintf(stderr, "Error: invalid sub '%s'\n", val);
+                spec->err = S_dev_badArgument;
+            }
+            spec->matchsubvendor = 1;
+            spec->matchsubdevice = !!sep;
+
+        } else if(strcmp(tok, "class")==0) {
+            unsigned cls = 0;
+            /* base class, base and sub-class, or including programming interface */
+            ndigits = pciSpecHex(val, 0xffffff, &cls);
+            if(ndigits==0) {
+                fprintf(stderr, "Error: invalid class '%s'\n", val);
+                spec->err = S_dev_badArgument;
+            } else if(ndigits<=2) {
+                spec->pci_class = cls<<16;
+                spec->class_mask = 0xff0000;
+            } else if(ndigits<=4) {
+                spec->pci_class = cls<<8;
+                spec->class_mask = 0xffff00;
+            } else {
+                spec->pci_class = cls;
+                spec->class_mask = 0xffffff;
+            }
+            spec->matchclass = 1;
+
+        } else {
+            fprintf(stderr, "Ignoring unknown spec '%s=%s'\n", tok, val);
+        }
+    }
+
+    if(devPCIDebug>4) {
+        fprintf(stderr, "Spec '%s'\n", spec->str);
+        if(spec->matchaddr)
+            fprintf(stderr, " Match BDF %x:%x:%x.%x\n",
+                    spec->domain, spec->b, spec->d, spec->f);
+        if(spec->matchslot)
+            fprintf(stderr, " Match slot %s\n", spec->slot);
+        if(spec->matchvendor || spec->matchdevice)
+            fprintf(stderr, " Match ID %04x:%04x\n", spec->vendor, spec->device);
+        if(spec->matchsubvendor)
+            fprintf(stderr, " Match sub. ID %04x:%04x\n", spec->sub_vendor, spec->sub_device);
+        if(spec->matchclass)
+            fprintf(stderr, " Match class %06x/%06x\n", (unsigned)spec->pci_class, (unsigned)spec->class_mask);
+        fprintf(stderr, " Instance %u\n", spec->stopat);
+    }
+}
+
+static
+void pciSpecInit(void* junk)
+{
+    (void)junk;
+    pciSpecLock = epicsMutexMustCreate();
+}
+
+static epicsThreadOnceId pciSpec_once = EPICS_THREAD_ONCE_INIT;
+
+/* Find or compile a spec.  Returns NULL when out of memory. */
+static
+const pciSpec* pciSpecGet(const char *str)
+{
+    pciSpec *spec, **pos;
+    size_t len = strlen(str);
+    char *buf;
+
+    epicsThreadOnce(&pciSpec_once, &pciSpecInit, NULL);
+
+    epicsMutexMustLock(pciSpecLock);
+
+    for(pos = &pciSpecCache[epicsStrHash(str, 0)%PCISPEC_NBUCKETS];
+        *pos; pos = &(*pos)->next)
+    {
+        if(strcmp((*pos)->str, str)==0) {
+            spec = *pos;
+            epicsMutexUnlock(pciSpecLock);
+            return spec;
+        }
+    }
+
+    /* spec, then the string, then a copy to be tokenized */
+    spec = calloc(1, sizeof(*spec) + 2*(len+1));
+    if(spec) {
+        buf = (char*)(spec+1);
+        memcpy(buf, str, len+1);
+        spec->str = buf;
+        buf += len+1;
+        memcpy(buf, str, len+1);
+
+        pciSpecCompile(spec, buf);
+        *pos = spec;
+    }
+
+    epicsMutexUnlock(pciSpecLock);
+    return spec;
+}
+
+/******************* Device index *********************/
+
+/* Hash indexes of all devices by address and by slot label.
+ * Built after enumeration, and rebuilt on the next lookup
+ * after devLibPCIInvalidateIndex().
+ * Devices are indexed in the order pDevPCIFind() visits them.
+ */
+typedef struct pciIndexEntry {
+    const epicsPCIDevice *dev;
+    struct pciIndexEntry *nextaddr, *nextslot;
+} pciIndexEntry;
+
+static epicsMutexId pciIndexLock;
+static int pciIndexValid;
+static unsigned pciIndexMask; /* bucket count - 1 */
+static pciIndexEntry *pciIndexEntries;
+static pciIndexEntry **pciIndexAddr, **pciIndexSlot;
+
+static const epicsPCIID pciIndexAll[] = {
+    DEVPCI_DEVICE_VENDOR(DEVPCI_ANY_DEVICE, DEVPCI_ANY_VENDOR),
+    DEVPCI_END
+};
+
+static
+unsigned pciIndexHashAddr(unsigned domain, unsigned b, unsigned d, unsigned f)
+{
+    epicsUInt32 key = (domain<<16) ^ (b<<8) ^ (d<<3) ^ f;
+    /* Fibonacci hashing */
+    return (unsigned)((key * 0x9e3779b1u) >> 16);
+}
+
+static
+int pciIndexCount(void* praw, const epicsPCIDevice* dev)
+{
+    (void)dev;
+    (*(size_t*)praw)++;
+    return 0;
+}
+
+static
+int pciIndexAdd(void* praw, const epicsPCIDevice* dev)
+{
+    size_t *pnext = praw;
+    pciIndexEntry *ent = &pciIndexEntries[*pnext], **pos;
+
+    ent->dev = dev;
+    (*pnext)++;
+
+    /* append to keep enumeration order within a bucket */
+    for(pos = &pciIndexAddr[pciIndexHashAddr(dev->domain, dev->bus, dev->device, dev->function)&pciIndexMask];
+        *pos; pos = &(*pos)->nextaddr) {}
+    *pos = ent;
+
+    if(dev->slot!=DEVPCI_NO_SLOT) {
+        for(pos = &pciIndexSlot[epicsStrHash(dev->slot, 0)&pciIndexMask];
+            *pos; pos = &(*pos)->nextslot) {}
+        *pos = ent;
+    }
+    return 0;
+}
+
+static
+void pciIndexClear(void)
+{
+    free(pciIndexEntries);
+    free(pciIndexAddr);
+    free(pciIndexSlot);
+    pciIndexEntries = NULL;
+    pciIndexAddr = pciIndexSlot = NULL;
+    pciIndexMask = 0;
+    pciIndexValid = 0;
+}
+
+/* Caller must take pciIndexLock.  PCIINIT must be complete.
+ * Returns zero when the index is usable.
+ */
+static
+int pciIndexBuild(void)
+{
+    size_t count = 0, added = 0;
+    unsigned nbuckets = 16;
+
+    if(pciIndexValid)
+        return 0;
+
+    pciIndexClear();
+
+    if((*pdevLibPCI->pDevPCIFind)(pciIndexAll, &pciIndexCount, &count, DEVLIB_FIND_NORESOLVE))
+        return 1;
+
+    while(nbuckets < 2*count)
+        nbuckets <<= 1;
+
+    pciIndexEntries = calloc(count ? count : 1, sizeof(*pciIndexEntries));
+    pciIndexAddr = calloc(nbuckets, sizeof(*pciIndexAddr));
+    pciIndexSlot = calloc(nbuckets, sizeof(*pciIndexSlot));
+    if(!pciIndexEntries || !pciIndexAddr || !pciIndexSlot) {
+        pciIndexClear();
+        return 1;
+    }
+    pciIndexMask = nbuckets-1;
+
+    /* a device added between the two passes will be picked up by the next rebuild */
+    if((*pdevLibPCI->pDevPCIFind)(pciIndexAll, &pciIndexAdd, &added, DEVLIB_FIND_NORESOLVE) || added>count) {
+        pciIndexClear();
+        return 1;
+    }
+
+    if(devPCIDebug>=1)
+        printf("PCI index of %u devices in %u buckets\n", (unsigned)added, nbuckets);
+
+    pciIndexValid = 1;
+    return 0;
+}
+
+static
+int pciIndexMatchID(const epicsPCIID *idlist, const epicsPCIDevice *dev)
+{
+    for(; idlist->device!=DEVPCI_LAST_DEVICE; idlist++) {
+        if(devLibPCIMatch(idlist, &dev->id))
+            return 1;
+    }
+    return 0;
+}
+
+static
+void pciIndexInit(void* junk)
+{
+    (void)junk;
+    pciIndexLock = epicsMutexMustCreate();
+}
+
+static epicsThreadOnceId pciIndex_once = EPICS_THREAD_ONCE_INIT;
+
+void devLibPCIInvalidateIndex(void)
+{
+    epicsThreadOnce(&pciIndex_once, &pciIndexInit, NULL);
+
+    epicsMutexMustLock(pciIndexLock);
+    pciIndexValid = 0;
+    epicsMutexUnlock(pciIndexLock);
+}
+
+/* Find the first device (in enumeration order) matching idlist and spec,
+ * which must match an address and/or slot.
+ *
+ * Returns 0 on success, S_dev_noDevice if not found,
+ * or 1 if the index can not be used and the caller should search.
+ */
+static
+int pciIndexLookup(const epicsPCIID *idlist,
+                   const pciSpec *spec,
+                   const epicsPCIDevice **found)
+{
+    pciIndexEntry *ent;
+    int ret = S_dev_noDevice;
+
+    epicsThreadOnce(&pciIndex_once, &pciIndexInit, NULL);
+
+    epicsMutexMustLock(pciIndexLock);
+
+    if(pciIndexBuild()) {
+        epicsMutexUnlock(pciIndexLock);
+        return 1;
+    }
+
+    if(spec->matchaddr) {
+        ent = pciIndexAddr[pciIndexHashAddr(spec->domain, spec->b, spec->d, spec->f)&pciIndexMask];
+        for(; ent; ent = ent->nextaddr) {
+            if(pciSpecMatch(spec, ent->dev) && pciIndexMatchID(idlist, ent->dev))
+            {
+                *found = ent->dev;
+                ret = 0;
+                break;
+            }
+        }
+
+    } else {
+        ent = pciIndexSlot[epicsStrHash(spec->slot, 0)&pciIndexMask];
+        for(; ent; ent = ent->nextslot) {
+            if(pciSpecMatch(spec, ent->dev) && pciIndexMatchID(idlist, ent->dev))
+            {
+                *found = ent->dev;
+                ret = 0;
+                break;
+            }
+        }
+    }
+
+    epicsMutexUnlock(pciIndexLock);
+
+    if(ret==0 && pdevLibPCI->pDevPCIResolve)
+        ret = (*pdevLibPCI->pDevPCIResolve)(*found);
+
+    return ret;
+}
+
+
 static
 void devInit(void* junk)
 {
@@ -200,6 +645,13 @@ void devInit(void* junk)
         devPCIInit_result = (*pdevLibPCI->pDevInit)();
     else
         devPCIInit_result = 0;
+
+    if(!devPCIInit_result) {
+        epicsThreadOnce(&pciIndex_once, &pciIndexInit, NULL);
+        epicsMutexMustLock(pciIndexLock);
+        (void)pciIndexBuild();
+        epicsMutexUnlock(pciIndexLock);
+    }
 }
 
 #define PCIINIT \
@@ -229,12 +681,8 @@ int devPCIFindCB(
 
 struct bdfmatch
 {
-    unsigned int matchaddr:1;
-    unsigned int matchslot:1;
-
-    unsigned int domain,b,d,f;
-    char slot[11];
-    unsigned int sofar, stopat;
+    const pciSpec *spec;
+    unsigned int sofar;
 
     const epicsPCIDevice* found;
 };
@@ -244,18 +692,7 @@ int devmatch(void* ptr, const epicsPCIDevice* cur)
 {
     struct bdfmatch *mt=ptr;
 
-    unsigned match = 1;
-
-    if(mt->matchaddr)
-        match &= cur->domain==mt->domain &&
-                cur->bus==mt->b &&
-                cur->device==mt->d &&
-                cur->function==mt->f;
-
-    if(mt->matchslot)
-        match &= cur->slot==DEVPCI_NO_SLOT ? 0 : strcmp(cur->slot, mt->slot)==0;
-
-    if(match && mt->sofar++==mt->stopat)
+    if(pciSpecMatch(mt->spec, cur) && mt->sofar++==mt->spec->stopat)
     {
         mt->found=cur;
         return 1;
@@ -264,94 +701,34 @@ int devmatch(void* ptr, const epicsPCIDevice* cur)
     return 0;
 }
 
-int devPCIFindSpec(
+/* Search using a compiled spec. */
+static
+int devPCIFindCompiled(
         const epicsPCIID *idlist,
-        const char *spec,
+        const pciSpec *spec,
         const epicsPCIDevice **found,
         unsigned int opt
         )
 {
-    int err = 0;
+    int err;
     struct bdfmatch find;
-    memset(&find, 0, sizeof(find));
 
-    if(!found || !spec)
-        return S_dev_badArgument;
+    if(spec->err)
+        return spec->err;
 
-    /* When originally introduced in 2.8, devPCIFindSpec() parsed as decimal,
-     * which is confusing as BDF are usually shown in hex.
-     * Changed in 2.9 to parse as hex.
-     * TODO: remove this notice after 2.9
+    /* Only the first match can be taken from the index.
+     * Later instances are counted by searching.
      */
-    if(devPCIDebug>=0) {
-        static int shown=0;
-        if(!shown) {
-            fprintf(stderr, "Notice: devPCIFindSpec() expect B:D.F in hex\n");
-            shown = 1;
-        }
-    }
-
-    /* parse the spec. string */
-    {
-        char *save, *alloc, *tok;
-
-        alloc = strdup(spec);
-        if(!alloc) return S_dev_noMemory;
-
-        for(tok = strtok_r(alloc, " ", &save);
-            tok;
-            tok=strtok_r(NULL, " ", &save))
-        {
-            unsigned dom, bus, dev, func=0;
-
-            if(sscanf(tok, "%x:%x:%x.%x", &dom, &bus, &dev, &func)>=3) {
-                find.matchaddr = 1;
-                find.domain = dom;
-                find.b = bus;
-                find.d = dev;
-                find.f = func;
-
-            } else if(sscanf(tok, "%x:%x.%x", &bus, &dev, &func)>=2) {
-                find.matchaddr = 1;
-                find.domain = 0;
-                find.b = bus;
-                find.d = dev;
-                find.f = func;
+    if((spec->matchaddr || spec->matchslot) && spec->stopat==0 && idlist) {
+        PCIINIT;
 
-            } else if(sscanf(tok, "slot=%10s", find.slot)==1) {
-                if(strlen(find.slot)==10)
-                    fprintf(stderr, "Slot label '%s' truncated?\n", find.slot);
-                find.matchslot = 1;
-
-            } else if(sscanf(tok, "instance=%u", &dom)==1) {
-                find.stopat = dom==0 ? 0 : dom-1;
-
-            } else if(sscanf(tok, "inst=%u", &dom)==1) {
-                find.stopat = dom==0 ? 0 : dom-1;
-
-            } else if(strchr(tok, '=')!=NULL) {
-                fprintf(stderr, "Ignoring unknown spec '%s'\n", tok);
-
-            } else {
-                fprintf(stderr, "Error: invalid spec '%s'\n", tok);
-                err = S_dev_badArgument;
-            }
-        }
-
-        free(alloc);
+        err = pciIndexLookup(idlist, spec, found);
+        if(err!=1)
+            return err;
     }
 
-    if(err)
-        return err;
-
-    if(devPCIDebug>4) {
-        if(find.matchaddr)
-            fprintf(stderr, " Match BDF %x:%x:%x.%x\n",
-                    find.domain, find.b, find.d, find.f);
-        if(find.matchslot)
-            fprintf(stderr, " Match slot %s\n", find.slot);
-        fprintf(stderr, " Instance %u\n", find.stopat);
-    }
+    memset(&find, 0, sizeof(find));
+    find.spec = spec;
 
     /* PCIINIT is called by devPCIFindCB()  */
 
@@ -370,6 +747,25 @@ int devPCIFindSpec(
     return 0;
 }
 
+int devPCIFindSpec(
+        const epicsPCIID *idlist,
+        const char *spec,
+        const epicsPCIDevice **found,
+        unsigned int opt
+        )
+{
+    const pciSpec *compiled;
+
+    if(!found || !spec)
+        return S_dev_badArgument;
+
+    compiled = pciSpecGet(spec);
+    if(!compiled)
+        return S_dev_noMemory;
+
+    return devPCIFindCompiled(idlist, compiled, found, opt);
+}
+
 /*
  * The most common PCI search using only id fields and BDF.
  */
@@ -383,35 +779,19 @@ int devPCIFindDBDF(
         unsigned int      opt
         )
 {
-    int err;
-    struct bdfmatch find;
+    pciSpec spec;
 
     if(!found)
         return S_dev_badArgument;
 
-    memset(&find, 0, sizeof(find));
-    find.matchaddr = 1;
-    find.domain=domain;
-    find.b=b;
-    find.d=d;
-    find.f=f;
-    find.found=NULL;
-
-    /* PCIINIT is called by devPCIFindCB()  */
-
-    err=devPCIFindCB(idlist,&devmatch,&find, opt);
-    if(err!=0){
-        /* Search failed? */
-        return err;
-    }
-
-    if(!find.found){
-        /* Not found */
-        return S_dev_noDevice;
-    }
+    memset(&spec, 0, sizeof(spec));
+    spec.matchaddr = 1;
+    spec.domain=domain;
+    spec.b=b;
+    spec.d=d;
+    spec.f=f;
 
-    *found=find.found;
-    return 0;
+    return devPCIFindCompiled(idlist, &spec, found, opt);
 }
 
 /* for backward compatilility: b=domain*0x100+bus */
@@ -443,6 +823,59 @@ devPCIToLocalAddr(
     return (*pdevLibPCI->pDevPCIToLocalAddr)(curdev,bar,ppLocalAddr,opt);
 }
 
+int
+devPCIMapWindow(
+        const epicsPCIDevice *curdev,
+        unsigned int bar,
+        epicsUInt64 offset,
+        epicsUInt64 len,
+        volatile void **ppLocalAddr,
+        unsigned int opt
+        )
+{
+    volatile void *base;
+    epicsUInt64 barlen;
+    int ret;
+
+    PCIINIT;
+
+    if(bar>=PCIBARCOUNT)
+        return S_dev_badArgument;
+
+    if(pdevLibPCI->pDevPCIMapWindow)
+        return (*pdevLibPCI->pDevPCIMapWindow)(curdev,bar,offset,len,ppLocalAddr,opt);
+
+    /* map the whole BAR */
+    ret = devPCIBarLen64(curdev, bar, &barlen);
+    if(ret)
+        return ret;
+    if(len==0 || offset>barlen || len>barlen-offset)
+        return S_dev_badArgument;
+
+    ret = (*pdevLibPCI->pDevPCIToLocalAddr)(curdev,bar,&base,opt);
+    if(!ret)
+        *ppLocalAddr = (volatile char*)base + offset;
+    return ret;
+}
+
+int
+devPCIUnmap(
+        const epicsPCIDevice *curdev,
+        unsigned int bar,
+        volatile void *pLocalAddr
+        )
+{
+    PCIINIT;
+
+    if(bar>=PCIBARCOUNT)
+        return S_dev_badArgument;
+
+    if(!pdevLibPCI->pDevPCIUnmap)
+        return 0; /* mappings are permanent */
+
+    return (*pdevLibPCI->pDevPCIUnmap)(curdev,bar,pLocalAddr);
+}
+
 
 
 int
@@ -460,6 +893,30 @@ devPCIBarLen(
     return (*pdevLibPCI->pDevPCIBarLen)(curdev,bar,len);
 }
 
+int
+devPCIBarLen64(
+        const epicsPCIDevice *curdev,
+        unsigned int  bar,
+        epicsUInt64 *len
+        )
+{
+    epicsUInt32 len32;
+    int ret;
+
+    PCIINIT;
+
+    if(bar>=PCIBARCOUNT)
+        return S_dev_badArgument;
+
+    if(pdevLibPCI->pDevPCIBarLen64)
+        return (*pdevLibPCI->pDevPCIBarLen64)(curdev,bar,len);
+
+    ret = (*pdevLibPCI->pDevPCIBarLen)(curdev,bar,&len32);
+    if(!ret)
+        *len = len32;
+    return ret;
+}
+
 int devPCIConnectInterrupt(
         const epicsPCIDevice *curdev,
         void (*pFunction)(void *),
@@ -485,6 +942,106 @@ int devPCIDisconnectInterrupt(
             (curdev,pFunction,parameter);
 }
 
+/******************* Hotplug *********************/
+
+typedef struct {
+    ELLNODE node;
+    devPCIHotplugFn fn;
+    void *arg;
+} hotplugCB;
+
+static ELLLIST hotplugCBs;
+static epicsMutexId hotplugLock;
+static epicsThreadOnceId hotplug_once = EPICS_THREAD_ONCE_INIT;
+
+static
+void hotplugInit(void* junk)
+{
+    (void)junk;
+    hotplugLock = epicsMutexMustCreate();
+}
+
+int devPCIHotplugRegister(devPCIHotplugFn fn, void *arg)
+{
+    hotplugCB *cb;
+
+    if(!fn)
+        return S_dev_badArgument;
+
+    epicsThreadOnce(&hotplug_once, &hotplugInit, NULL);
+
+    cb = calloc(1, sizeof(*cb));
+    if(!cb)
+        return S_dev_noMemory;
+    cb->fn = fn;
+    cb->arg = arg;
+
+    epicsMutexMustLock(hotplugLock);
+    ellAdd(&hotplugCBs, &cb->node);
+    epicsMutexUnlock(hotplugLock);
+    return 0;
+}
+
+int devPCIHotplugUnregister(devPCIHotplugFn fn, void *arg)
+{
+    ELLNODE *cur;
+    int ret = S_dev_badArgument;
+
+    epicsThreadOnce(&hotplug_once, &hotplugInit, NULL);
+
+    epicsMutexMustLock(hotplugLock);
+    for(cur=ellFirst(&hotplugCBs); cur; cur=ellNext(cur)) {
+        hotplugCB *cb = CONTAINER(cur, hotplugCB, node);
+        if(cb->fn==fn && cb->arg==arg) {
+            ellDelete(&hotplugCBs, cur);
+            free(cb);
+            ret = 0;
+            break;
+        }
+    }
+    epicsMutexUnlock(hotplugLock);
+    return ret;
+}
+
+/* called by driver with hotplugLock held */
+static
+void hotplugNotify(void *junk, const epicsPCIDevice *dev, devPCIHotplugEvent event)
+{
+    ELLNODE *cur;
+    (void)junk;
+
+    /* before callbacks, which may search */
+    devLibPCIInvalidateIndex();
+
+    if(devPCIDebug>0)
+        printf("PCI %s %04x:%02x:%02x.%x\n", event==devPCIHotplugAdd ? "add" : "remove",
+               dev->domain, dev->bus, dev->device, dev->function);
+
+    for(cur=ellFirst(&hotplugCBs); cur; cur=ellNext(cur)) {
+        hotplugCB *cb = CONTAINER(cur, hotplugCB, node);
+        (*cb->fn)(cb->arg, dev, event);
+    }
+}
+
+int devPCIRescan(void)
+{
+    int ret;
+
+    PCIINIT;
+
+    if(!pdevLibPCI->pDevPCIRescan)
+        return S_dev_badFunction; /* not implemented */
+
+    epicsThreadOnce(&hotplug_once, &hotplugInit, NULL);
+
+    /* serializes rescans, and callbacks with (un)register */
+    epicsMutexMustLock(hotplugLock);
+    ret = (*pdevLibPCI->pDevPCIRescan)(&hotplugNotify, NULL);
+    epicsMutexUnlock(hotplugLock);
+
+    return ret;
+}
+
 typedef struct {
     int lvl;
     int matched;
@@ -561,20 +1118,21 @@ devPCIShowDevice(int lvl, const epicsPCIDevice *dev)
         return;
     for(i=0; i<PCIBARCOUNT; i++)
     {
-        epicsUInt32 len;
+        epicsUInt64 len;
 
-        if ((*pdevLibPCI->pDevPCIBarLen)(dev, i, &len) == 0 && len > 0)
+        if (devPCIBarLen64(dev, i, &len) == 0 && len > 0)
         {
             char* u = "";
             if (len >= 1024) { len >>= 10; u = "k"; }
             if (len >= 1024) { len >>= 10; u = "M"; }
             if (len >= 1024) { len >>= 10; u = "G"; }
+            if (len >= 1024) { len >>= 10; u = "T"; }
 
             printf("  BAR %u %s-bit %s%s %3u %sB\n",i,
                    dev->bar[i].addr64?"64":"32",
                    dev->bar[i].ioport?"IO Port":"MMIO   ",
                    dev->bar[i].below1M?" Below 1M":"",
-                   len, u);
+                   (unsigned)len, u);
         }
         /* 64 bit bars use 2 entries */
         if (dev->bar[i].addr64) i++;
@@ -635,6 +1193,201 @@ devPCIConfigWrite32(const epicsPCIDevice *dev, unsigned offset, epicsUInt32 valu
     return checkCfgAccess(dev, offset, &value, WR_32);
 }
 
+#define PCICFGSIZE 4096
+
+int
+devPCIConfigReadBlock(const epicsPCIDevice *dev, unsigned offset, void *buf, unsigned len)
+{
+    epicsUInt8 *cur = buf;
+
+    if ( !buf || offset>PCICFGSIZE || len>PCICFGSIZE-offset )
+        return S_dev_badArgument;
+    if ( ! pdevLibPCI->pDevPCIConfigAccess )
+        return S_dev_badFunction; /* not implemented */
+
+    if ( pdevLibPCI->pDevPCIConfigReadBlock )
+        return (*pdevLibPCI->pDevPCIConfigReadBlock)(dev, offset, buf, len);
+
+    /* fall back to the widest aligned accesses */
+    while ( len ) {
+        int rval;
+
+        if ( !(offset&3) && len>=4 ) {
+            epicsUInt32 val;
+            if ( (rval = checkCfgAccess(dev, offset, &val, RD_32)) )
+                return rval;
+            cur[0] = val; cur[1] = val>>8; cur[2] = val>>16; cur[3] = val>>24;
+            offset += 4; cur += 4; len -= 4;
+
+        } else if ( !(offset&1) && len>=2 ) {
+            epicsUInt16 val;
+            if ( (rval = checkCfgAccess(dev, offset, &val, RD_16)) )
+                return rval;
+            cur[0] = val; cur[1] = val>>8;
+            offset += 2; cur += 2; len -= 2;
+
+        } else {
+            if ( (rval = checkCfgAccess(dev, offset, cur, RD_08)) )
+                return rval;
+            offset += 1; cur += 1; len -= 1;
+        }
+    }
+    return 0;
+}
+
+/* Capability lists, read once for each device.
+ * Standard capabilities are below offset 0x100, extended at 0x100 and above.
+ */
+#define PCICAP_MAX 64
+#define PCICAP_NBUCKETS 64
+
+typedef struct pciCapList {
+    struct pciCapList *next;
+    const epicsPCIDevice *dev;
+    unsigned count;
+    struct {
+        epicsUInt16 id, offset;
+    } caps[1];
+} pciCapList;
+
+static epicsMutexId pciCapLock;
+static pciCapList *pciCapCache[PCICAP_NBUCKETS];
+
+static
+void pciCapInit(void* junk)
+{
+    (void)junk;
+    pciCapLock = epicsMutexMustCreate();
+}
+
+static epicsThreadOnceId pciCap_once = EPICS_THREAD_ONCE_INIT;
+
+static
+unsigned pciCapHash(const epicsPCIDevice *dev)
+{
+    return (unsigned)(((size_t)dev/sizeof(void*))%PCICAP_NBUCKETS);
+}
+
+static
+pciCapList* pciCapWalk(const epicsPCIDevice *dev)
+{
+    epicsUInt8 *cfg;
+    pciCapList *list;
+    unsigned ptr, ttl, count = 0;
+    epicsUInt16 ids[PCICAP_MAX], offsets[PCICAP_MAX];
+    int pcie = 0;
+
+    cfg = malloc(PCICFGSIZE);
+    if(!cfg)
+        return NULL;
+
+    if(devPCIConfigReadBlock(dev, 0, cfg, 0x100)) {
+        free(cfg);
+        return NULL;
+    }
+
+    if(cfg[0x06]&0x10) { /* status: capabilities list */
+        /* CardBus bridges keep the pointer elsewhere */
+        ptr = cfg[(cfg[0x0e]&0x7f)==2 ? 0x14 : 0x34]&0xfc;
+
+        for(ttl=48; ptr>=0x40 && ttl && count<PCICAP_MAX; ttl--) {
+            if(cfg[ptr]==0xff)
+                break;
+            if(cfg[ptr]==DEVPCI_CAP_EXP)
+                pcie = 1;
+            ids[count] = cfg[ptr];
+            offsets[count++] = ptr;
+            ptr = cfg[ptr+1]&0xfc;
+        }
+    }
+
+    /* extended capabilities, when the rest of config space can be read */
+    if(pcie && !devPCIConfigReadBlock(dev, 0x100, cfg+0x100, PCICFGSIZE-0x100)) {
+        for(ptr=0x100, ttl=(PCICFGSIZE-0x100)/8; ttl && count<PCICAP_MAX; ttl--) {
+            epicsUInt32 hdr = cfg[ptr] | (cfg[ptr+1]<<8) | (cfg[ptr+2]<<16) | ((epicsUInt32)cfg[ptr+3]<<24);
+            if(hdr==0 || hdr==0xffffffff)
+                break;
+            ids[count] = hdr&0xffff;
+            offsets[count++] = ptr;
+            ptr = (hdr>>20)&0xffc;
+            if(ptr<0x100)
+                break;
+        }
+    }
+
+    free(cfg);
+
+    list = calloc(1, sizeof(*list) + count*sizeof(list->caps[0]));
+    if(!list)
+        return NULL;
+
+    list->dev = dev;
+    list->count = count;
+    for(ptr=0; ptr<count; ptr++) {
+        list->caps[ptr].id = ids[ptr];
+        list->caps[ptr].offset = offsets[ptr];
+    }
+
+    if(devPCIDebug>=2)
+        printf("PCI %04x:%02x:%02x.%x has %u capabilities\n",
+               dev->domain, dev->bus, dev->device, dev->function, count);
+    return list;
+}
+
+static
+int pciCapFind(const epicsPCIDevice *dev, unsigned id, int ext, unsigned *offset)
+{
+    pciCapList *list, **pos;
+    unsigned i;
+
+    if(!dev || !offset)
+        return S_dev_badArgument;
+
+    epicsThreadOnce(&pciCap_once, &pciCapInit, NULL);
+
+    epicsMutexMustLock(pciCapLock);
+    for(list=pciCapCache[pciCapHash(dev)]; list && list->dev!=dev; list=list->next) {}
+    epicsMutexUnlock(pciCapLock);
+
+    if(!list) {
+        pciCapList *mine = pciCapWalk(dev);
+        if(!mine)
+            return S_dev_internal;
+
+        epicsMutexMustLock(pciCapLock);
+        /* may race with another caller.  First one in wins */
+        for(pos=&pciCapCache[pciCapHash(dev)]; *pos && (*pos)->dev!=dev; pos=&(*pos)->next) {}
+        if(*pos) {
+            free(mine);
+        } else {
+            *pos = mine;
+        }
+        list = *pos;
+        epicsMutexUnlock(pciCapLock);
+    }
+
+    /* entries are not modified once added */
+    for(i=0; i<list->count; i++) {
+        if(list->caps[i].id==id && (list->caps[i].offset>=0x100)==!!ext) {
+            *offset = list->caps[i].offset;
+            return 0;
+        }
+    }
+    return S_dev_noDevice;
+}
+
+int
+devPCIFindCapability(const epicsPCIDevice *dev, unsigned id, unsigned *offset)
+{
+    return pciCapFind(dev, id, 0, offset);
+}
+
+int
+devPCIFindExtCapability(const epicsPCIDevice *dev, unsigned id, unsigned *offset)
+{
+    return pciCapFind(dev, id, 1, offset);
+}
+
 
 int
 devPCIEnableInterrupt(const epicsPCIDevice *dev)
@@ -678,6 +1431,17 @@ static void devLibPCIUseCallFunc(const iocshArgBuf *args)
     devLibPCIUse(args[0].sval);
 }
 
+static const iocshFuncDef devPCIRescanFuncDef =
+{"devPCIRescan",0,NULL};
+static void devPCIRescanCallFunc(const iocshArgBuf *args)
+{
+    int ret;
+    (void)args;
+    ret = devPCIRescan();
+    if(ret)
+        fprintf(stderr, "devPCIRescan() fails with %d\n", ret);
+}
+
 #include <epicsExport.h>
 
 static
@@ -685,8 +1449,12 @@ void devLibPCIIOCSH()
 {
     iocshRegister(&devPCIShowFuncDef,devPCIShowCallFunc);
     iocshRegister(&devLibPCIUseFuncDef,devLibPCIUseCallFunc);
+    iocshRegister(&devPCIRescanFuncDef,devPCIRescanCallFunc);
 }
 
 epicsExportRegistrar(devLibPCIIOCSH);
 
 epicsExportAddress(int,devPCIDebug);
+epicsExportAddress(int,devPCIISRThreads);
+epicsExportAddress(int,devPCIEnumThreads);
+epicsExportAddress(int,devPCIHotplug);
@@ -168,9 +168,22 @@ int devPCIFindCB(
  * # "<domain#>:<bus#>:<device#>[.<function#>]"
  * # "slot=<slot#>"
  * # "inst[ance]=<instance#>"
+ * # "vendor=<vendor id>"
+ * # "device=<device id>"
+ * # "sub=<subsystem vendor id>[:<subsystem device id>]"
+ * # "class=<class code>"
+ *
+ * Addresses and IDs are hex, with an optional "0x" prefix.
+ * A class code of 1-2 digits matches the base class only (eg. "class=02"),
+ * 3-4 digits also match the sub-class (eg. "class=0200"),
+ * and 5-6 digits also match the programming interface (eg. "class=0c0330").
  *
  * Some targets do not support some match types (eg. only Linux matches slot numbers).
  *
+ * Each distinct string is parsed once, and the result kept for later calls.
+ * When an address or slot is given, the first instance is found
+ * from an index without searching the whole bus.
+ *
  @param idlist List of PCI identifiers
  @param spec specification string
  @param[out] found On success the result is stored here
@@ -227,10 +240,19 @@ int devPCIFindBDF(
 #ifdef __linux__
 #define DEVLIB_MAP_UIO1TO1 0
 #define DEVLIB_MAP_UIOCOMPACT 1
+#define DEVLIB_MAP_WC 2
 #else
 /* UIO options have no meaning for non-Linux OSs */
 #define DEVLIB_MAP_UIO1TO1 0
 #define DEVLIB_MAP_UIOCOMPACT 0
+#define DEVLIB_MAP_WC 0
+#endif
+
+#ifdef __linux__
+#define DEVLIB_ISR_DEVLOCK 1
+#else
+/* Interrupt locking options have no meaning for non-Linux OSs */
+#define DEVLIB_ISR_DEVLOCK 0
 #endif
 
 /** @brief Get pointer to PCI BAR
@@ -238,7 +260,7 @@ int devPCIFindBDF(
  * Map a PCI BAR into the local process address space.
  *
  * The opt argument is used to modify the mapping process.
- * Currently only two (mutually exclusive) flags are supported which are only
+ * Two (mutually exclusive) flags are only
  * used by the Linux UIO bus implementation to control
  * how requested BAR #s are mapped to UIO region numbers.
  *
@@ -247,6 +269,14 @@ int devPCIFindBDF(
  * @li DEVLIB_MAP_UIOCOMPACT Maps the requested BAR # to the index of the appropriate
  *     IOMEM region.  This index skips I/O Port BARs and any other non-IOMEM regions.
  *
+ * DEVLIB_MAP_WC may be combined with either.  It requests a write-combining
+ * mapping, which on Linux is taken from the "resource#_wc" file the kernel
+ * provides for prefetchable BARs.  Adjacent writes may then be merged into bursts,
+ * and may be delayed until a write barrier.  Use devlib_wbarr() from devLibMMIO.h,
+ * as the wbarr() of EPICS Base >=3.15.1 does not flush write combining buffers.
+ * If a write-combining mapping is not available, the normal (uncached) mapping is returned.
+ * Not suitable for FIFO or other registers where each write must reach the device.
+ *
  @param id PCI device pointer
  @param bar BAR number
  @param[out] ppLocalAddr Pointer to start of BAR
@@ -262,6 +292,60 @@ devPCIToLocalAddr(
         unsigned int opt /* always 0 */
         );
 
+/** @brief Map part of a BAR into the local address space
+ *
+ * As devPCIToLocalAddr(), but only the len bytes starting at offset
+ * within the BAR need be mapped.  Useful to access a few registers
+ * in a large BAR without reserving address space for all of it.
+ *
+ * Where a partial mapping is not possible, the whole BAR is mapped,
+ * and a pointer into it is returned.
+ *
+ * Each successful call of devPCIToLocalAddr() or devPCIMapWindow()
+ * takes a reference to a mapping, which may be released by devPCIUnmap().
+ *
+ @param id PCI device pointer
+ @param bar BAR number
+ @param offset of window start within BAR, in bytes
+ @param len length of window in bytes
+ @param[out] ppLocalAddr Pointer to start of window (not of BAR)
+ @param opt Modifiers.  0 or bitwise OR of one or more DEVLIB_MAP_* macros
+ @returns 0 on success or an EPICS error code on failure.
+          S_dev_badArgument if the window does not fit within the BAR.
+ */
+epicsShareFunc
+int
+devPCIMapWindow(
+        const epicsPCIDevice *id,
+        unsigned int  bar,
+        epicsUInt64 offset,
+        epicsUInt64 len,
+        volatile void **ppLocalAddr,
+        unsigned int opt
+        );
+
+/** @brief Release a mapping
+ *
+ * Release one reference taken by devPCIToLocalAddr() or devPCIMapWindow().
+ * The mapping is removed when its last reference is released,
+ * after which the address must not be used.
+ *
+ * On targets where mappings are permanent (RTEMS and vxWorks) this does nothing.
+ *
+ @param id PCI device pointer
+ @param bar BAR number
+ @param pLocalAddr Pointer as returned by devPCIToLocalAddr() or devPCIMapWindow()
+ @returns 0 on success or an EPICS error code on failure.
+          S_dev_badArgument if pLocalAddr is not a mapping of this BAR.
+ */
+epicsShareFunc
+int
+devPCIUnmap(
+        const epicsPCIDevice *id,
+        unsigned int  bar,
+        volatile void *pLocalAddr
+        );
+
 /** @brief Find the size of a BAR
  *
  * Returns the size (in bytes) of the region visible through
@@ -275,6 +359,7 @@ devPCIToLocalAddr(
  @param bar BAR number
  @param[out] len BAR size in bytes
  @returns 0 on success or an EPICS error code on failure.
+          S_dev_badArgument if the size is 4GB or larger, see devPCIBarLen64().
  */
 epicsShareFunc
 int
@@ -284,6 +369,24 @@ devPCIBarLen(
         epicsUInt32 *len
         );
 
+/** @brief Find the size of a BAR which may be 4GB or larger
+ *
+ * As devPCIBarLen(), which fails with S_dev_badArgument when
+ * the size of a 64-bit BAR does not fit in 32 bits.
+ *
+ @param id PCI device pointer
+ @param bar BAR number
+ @param[out] len BAR size in bytes
+ @returns 0 on success or an EPICS error code on failure.
+ */
+epicsShareFunc
+int
+devPCIBarLen64(
+        const epicsPCIDevice *id,
+        unsigned int  bar,
+        epicsUInt64 *len
+        );
+
 /** @brief Request interrupts for device
  *
  * Request that the provided callback be
@@ -296,10 +399,17 @@ devPCIBarLen(
  @note All drivers should be prepared for their device to share an interrupt
        with other devices.
  *
+ * On Linux, ISRs are called from a user-space thread.  By default each call
+ * is made with epicsInterruptLock() held, which is a single process-wide lock.
+ * With the DEVLIB_ISR_DEVLOCK flag the call is instead only serialized
+ * with other ISRs of the same device, and with other devLibPCI calls on that device,
+ * so that ISRs of different devices may run concurrently.
+ * This flag is ignored by other targets.
+ *
  @param id PCI device pointer
  @param pFunction User ISR
  @param parameter User pointer
- @param opt Modifiers.  Currently unused
+ @param opt Modifiers.  0 or DEVLIB_ISR_DEVLOCK
  @returns 0 on success or an EPICS error code on failure.
  */
 epicsShareFunc
@@ -307,7 +417,7 @@ int devPCIConnectInterrupt(
         const epicsPCIDevice *id,
         void (*pFunction)(void *),
         void  *parameter,
-        unsigned int opt /* always 0 */
+        unsigned int opt
         );
 
 /** @brief Stop receiving interrupts
@@ -325,6 +435,51 @@ int devPCIDisconnectInterrupt(
         void  *parameter
         );
 
+/** @brief Hotplug events passed to a ::devPCIHotplugFn */
+typedef enum {
+    devPCIHotplugAdd,    /**< Device appeared.  May now be found by search */
+    devPCIHotplugRemove, /**< Device removed.  Pointer remains valid, but the device is gone */
+} devPCIHotplugEvent;
+
+/** @brief Hotplug callback prototype
+ *
+ @param arg User pointer
+ @param dev PCI device pointer
+ @param event What happened to this device
+ */
+typedef void (*devPCIHotplugFn)(void *arg, const epicsPCIDevice *dev, devPCIHotplugEvent event);
+
+/** @brief Notify of devices added or removed after initialization
+ *
+ * The callback is called from the thread running devPCIRescan().
+ * It may search, but must not register or unregister hotplug callbacks.
+ *
+ @param fn User callback
+ @param arg User pointer
+ @returns 0 on success or an EPICS error code on failure.
+ */
+epicsShareFunc
+int devPCIHotplugRegister(devPCIHotplugFn fn, void *arg);
+
+/** @brief Stop hotplug notifications
+ *
+ * Use the same arguments passed to devPCIHotplugRegister()
+ @returns 0 on success or an EPICS error code on failure.
+ */
+epicsShareFunc
+int devPCIHotplugUnregister(devPCIHotplugFn fn, void *arg);
+
+/** @brief Look for devices added or removed since initialization or the last rescan
+ *
+ * Devices still present keep their mappings and ISRs.
+ * Registered hotplug callbacks are called for each change.
+ *
+ * Only implemented for Linux.
+ @returns 0 on success or an EPICS error code on failure.
+ */
+epicsShareFunc
+int devPCIRescan(void);
+
 epicsShareFunc
 void
 devPCIShow(int lvl, int vendor, int device, int exact);
@@ -353,6 +508,33 @@ const char* devLibPCIDriverName();
 
 epicsShareExtern int devPCIDebug;
 
+/** @brief Number of interrupt dispatch threads
+ *
+ * 0 (default) creates one thread for each device with connected ISRs.
+ * When >0, on Linux this many threads wait for interrupts from all devices,
+ * and the ISRs of each device are called in turn by one thread at a time.
+ * Must be set before the first call to devPCIConnectInterrupt().
+ */
+epicsShareExtern int devPCIISRThreads;
+
+/** @brief Fast device enumeration
+ *
+ * 0 (default) reads all attributes of every device during initialization.
+ * When >0, on Linux only the IDs of each device are read during initialization,
+ * using this many threads.  BARs, IRQ, and driver name are read
+ * when a device is first found.
+ * Must be set before the first PCI search.
+ */
+epicsShareExtern int devPCIEnumThreads;
+
+/** @brief Watch for hotplug
+ *
+ * When non-zero, on Linux a thread waits for kernel notification of
+ * PCI devices added or removed, and runs devPCIRescan().
+ * Must be set before the first PCI search.
+ */
+epicsShareExtern int devPCIHotplug;
+
 /** @brief Read byte from configuration space
  *
  @param   dev     A PCI device handle
@@ -421,6 +603,62 @@ int devPCIConfigWrite16(const epicsPCIDevice *dev, unsigned offset, epicsUInt16
 epicsShareFunc
 int devPCIConfigWrite32(const epicsPCIDevice *dev, unsigned offset, epicsUInt32 value);
 
+/** @brief Read a range of configuration space
+ *
+ * Where supported (eg. Linux) this is a single access to the device,
+ * which is faster than many calls to devPCIConfigRead32().
+ * Bytes are copied as on the bus (little endian).
+ *
+ @param   dev     A PCI device handle
+ @param   offset  Offset into configuration space
+ @param   buf     Pointer to where len bytes are to be written
+ @param   len     Number of bytes.  offset+len may not exceed 4096
+ @returns 0       on success or an EPICS error code on failure
+ */
+epicsShareFunc
+int devPCIConfigReadBlock(const epicsPCIDevice *dev, unsigned offset, void *buf, unsigned len);
+
+/** @name PCI capability IDs
+ * For use with devPCIFindCapability() and devPCIFindExtCapability()
+ * @{
+ */
+#define DEVPCI_CAP_PM       0x01 /**< Power Management */
+#define DEVPCI_CAP_MSI      0x05 /**< Message Signaled Interrupts */
+#define DEVPCI_CAP_VNDR     0x09 /**< Vendor specific */
+#define DEVPCI_CAP_EXP      0x10 /**< PCI Express */
+#define DEVPCI_CAP_MSIX     0x11 /**< MSI-X */
+
+#define DEVPCI_EXT_CAP_AER  0x0001 /**< Advanced Error Reporting */
+#define DEVPCI_EXT_CAP_DSN  0x0003 /**< Device Serial Number */
+#define DEVPCI_EXT_CAP_VNDR 0x000b /**< Vendor specific */
+/** @} */
+
+/** @brief Find a capability in configuration space
+ *
+ * The capability list of each device is read once, on first use, and remembered.
+ *
+ @param   dev     A PCI device handle
+ @param   id      Capability ID.  eg. DEVPCI_CAP_EXP
+ @param   offset  On success, set to the offset of the capability header
+ @returns 0       on success, S_dev_noDevice if the device has no such capability,
+                  or an EPICS error code on failure
+ */
+epicsShareFunc
+int devPCIFindCapability(const epicsPCIDevice *dev, unsigned id, unsigned *offset);
+
+/** @brief Find a PCI Express extended capability in configuration space
+ *
+ * As devPCIFindCapability() for extended capabilities (offset 0x100 and above).
+ *
+ @param   dev     A PCI device handle
+ @param   id      Extended capability ID.  eg. DEVPCI_EXT_CAP_AER
+ @param   offset  On success, set to the offset of the capability header
+ @returns 0       on success, S_dev_noDevice if the device has no such capability,
+                  or an EPICS error code on failure
+ */
+epicsShareFunc
+int devPCIFindExtCapability(const epicsPCIDevice *dev, unsigned id, unsigned *offset);
+
 /** @brief Enable interrupts at the device.
  *
  @param   dev     A PCI device handle
@@ -36,6 +36,12 @@ typedef enum {
 #define CFG_ACC_WIDTH(mode) ((mode) & 0x0f)
 #define CFG_ACC_WRITE(mode) ((mode) & 0x10)
 
+/* pDevPCIFind() option.  The search function only looks at
+ * the id, address, and slot of each device.  So the driver need not
+ * read attributes which it would otherwise read on first match.
+ */
+#define DEVLIB_FIND_NORESOLVE 0x10000
+
 typedef struct {
     const char *name;
 
@@ -62,6 +68,29 @@ typedef struct {
 
     /* level 0 enables, higher levels disable - on error a negative value is returned */
     int (*pDevPCISwitchInterrupt)(const epicsPCIDevice *id, int level);
+
+    /* Optional.  Read any attributes of a device not read during pDevInit().
+     * Called for devices found without pDevPCIFind()
+     */
+    int (*pDevPCIResolve)(const epicsPCIDevice *id);
+
+    /* Optional.  Update the device list, and call notify() for each device added or removed */
+    int (*pDevPCIRescan)(devPCIHotplugFn notify, void *arg);
+
+    /* Optional.  Read len bytes of configuration space with one access */
+    int (*pDevPCIConfigReadBlock)(const epicsPCIDevice *id, unsigned offset, void *buf, unsigned len);
+
+    /* Optional.  As pDevPCIBarLen, for BARs which may be 4GB or larger */
+    int (*pDevPCIBarLen64)(const epicsPCIDevice* dev,unsigned int bar,epicsUInt64 *len);
+
+    /* Optional.  Map len bytes of a BAR starting at offset.  Each successful call
+     * of pDevPCIToLocalAddr or pDevPCIMapWindow takes a reference released by pDevPCIUnmap
+     */
+    int (*pDevPCIMapWindow)(const epicsPCIDevice* dev,unsigned int bar,epicsUInt64 offset,epicsUInt64 len,
+                            volatile void **a,unsigned int o);
+
+    /* Optional.  Release a mapping.  Without, mappings are kept until pDevFinal */
+    int (*pDevPCIUnmap)(const epicsPCIDevice* dev,unsigned int bar,volatile void *a);
     ELLNODE node;
 } devLibPCI;
 
@@ -76,6 +105,45 @@ devLibPCIRegisterDriver2(devLibPCI*, size_t);
 epicsShareFunc
 void devLibPCIRegisterBaseDefault(void);
 
+/** @name Simulated PCI bus
+ *
+ * The "sim" driver, selected with devLibPCIUse("sim"), presents devices
+ * listed in description files.  Each line describes one device.
+ *
+ @code
+ # [domain:]bus:device.function key=value ...
+ 1:0.0 vendor=0x10ee device=0x7011 class=0xff0000 bar0=0x1000 bar2=0x100000 slot=3
+ @endcode
+ *
+ * Keys are vendor, device, subvendor, subdevice, class, revision, irq, slot,
+ * and bar0 through bar5 giving the size in bytes of each BAR, which is backed by shared memory.
+ *
+ * Only implemented for Linux.
+ * @{
+ */
+/*! Register the "sim" driver */
+epicsShareFunc
+void devLibPCIRegisterSim(void);
+
+/*! Add the devices listed in a description file */
+epicsShareFunc
+int devLibPCISimLoad(const char *fname);
+
+/*! Inject an interrupt.  Each connected ISR will be called once, unless disabled */
+epicsShareFunc
+int devLibPCISimInterrupt(const epicsPCIDevice *dev);
+
+/*! eventfd to which writing an 8 byte count injects interrupts, or -1 */
+epicsShareFunc
+int devLibPCISimEventFD(const epicsPCIDevice *dev);
+/** @} */
+
+/** Drivers which add or remove devices after pDevInit() must call this
+ * so that devPCIFindDBDF() and devPCIFindSpec() do not use a stale index.
+ */
+epicsShareFunc
+void devLibPCIInvalidateIndex(void);
+
 /** Helper for implementing devLibPCI::pDevPCIFind()
  *
  * Returns true if the given match (which may include DEVPCI_ANY_* wildcards)
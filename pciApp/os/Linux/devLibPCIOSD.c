@@ -16,6 +16,11 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <poll.h>
 
 #include <cantProceed.h>
 #include <epicsStdio.h>
@@ -25,6 +30,7 @@
 #include <epicsMutex.h>
 #include <epicsEvent.h>
 #include <epicsInterrupt.h>
+#include <epicsAtomic.h>
 #include <compilerDependencies.h>
 
 
@@ -44,6 +50,7 @@
  *
  * Note on locking: When taking both pciLock and a device lock
  *                  always take pciLock first.
+ *                  Searches take neither lock, see pciTable.
  */
 
 #ifndef CONTAINER
@@ -80,7 +87,8 @@
  *
  * Lifetime: Created in linuxDevPCIInit and free'd in linuxDevFinal
  *
- * Access after init is guarded by devLock
+ * 'dev' and the BAR layout do not change once 'resolved' is set.
+ * Access to other members after init is guarded by devLock
  */
 struct osdPCIDevice {
     epicsPCIDevice dev; /* "public" data */
@@ -90,13 +98,24 @@ struct osdPCIDevice {
     /* offset from start of page to start of BAR */
     epicsUInt32    offset[PCIBARCOUNT];
     /* BAR length (w/o offset) */
-    epicsUInt32    len[PCIBARCOUNT];
+    epicsUInt64    len[PCIBARCOUNT];
+    /* result of mmap() of resource#_wc, or NULL.  Same offset and length as base[] */
+    volatile void *base_wc[PCIBARCOUNT];
+    /* number of users of base[] and base_wc[].  Unmapped when zero */
+    unsigned       refs[PCIBARCOUNT];
+    unsigned       refs_wc[PCIBARCOUNT];
+    /* partial mappings of BARs.  contains struct osdPCIWindow */
+    ELLLIST        windows;
     volatile void *erom;
     epicsUInt32    eromlen;
 
-    epicsUInt32 displayBAR[PCIBARCOUNT]; /* Raw PCI address */
+    epicsUInt64 displayBAR[PCIBARCOUNT]; /* Raw PCI address */
     epicsUInt32 displayErom;
 
+    int resolved; /* irq, BARs, and driver have been read */
+    ino_t cfgino; /* inode of the config attribute when enumerated.  See config_inode() */
+    int removed; /* no longer present.  In 'removed_devices' list */
+
     int fd; /* /dev/uio# */
     int cfd; /* config-space descriptor */
     int rfd[PCIBARCOUNT];
@@ -104,6 +123,25 @@ struct osdPCIDevice {
 
     epicsMutexId devLock; /* guard access to isrs list */
 
+    /* Interrupt waiter, which reads fd and calls all isrs.
+     * Either a thread for this device, or the reactor when armed.
+     */
+    epicsThreadId waiter;
+    epicsEventId waiterDone;
+    int wakefd; /* eventfd to wake waiter when stopping */
+    enum {
+        osdWaiterIdle=0, /* no thread */
+        osdWaiterRunning, /* normal operation */
+        osdWaiterStopping, /* stop required */
+        osdWaiterDone, /* thread done, can free resources */
+    } waiter_status;
+    int armed; /* fd registered with the reactor */
+    epicsInt32 next; /* next expected event count */
+
+    /* ISR being called w/o devLock held, or NULL */
+    struct osdISR *calling;
+    epicsEventId callDone;
+
     ELLNODE node;
 
     ELLLIST isrs; /* contains struct osdISR */
@@ -112,22 +150,30 @@ typedef struct osdPCIDevice osdPCIDevice;
 
 #define dev2osd(dev) CONTAINER(dev, osdPCIDevice, dev)
 
-struct osdISR {
+/* A mapping of part of one BAR, from linuxDevPCIMapWindow().
+ * Guarded by devLock of the device.
+ */
+struct osdPCIWindow {
     ELLNODE node;
 
-    epicsThreadId waiter;
-    epicsEventId done;
-    enum {
-        osdISRStarting=0, /* started, id not filled */
-        osdISRRunning, /* id filled, normal operation */
-        osdISRStopping, /* stop required */
-        osdISRDone, /* thread done, can free resources */
-    } waiter_status;
+    unsigned int bar;
+    epicsUInt64 offset, len; /* within BAR */
+    unsigned int opt; /* DEVLIB_MAP_WC if write combining */
 
-    osdPCIDevice *osd;
+    void *base; /* result of mmap() */
+    size_t maplen;
+    volatile void *addr; /* start of window, passed to user */
+
+    unsigned refs;
+};
+typedef struct osdPCIWindow osdPCIWindow;
+
+struct osdISR {
+    ELLNODE node;
 
     EPICSTHREADFUNC fptr;
     void  *param;
+    unsigned int opt; /* DEVLIB_ISR_* */
 };
 typedef struct osdISR osdISR;
 
@@ -135,24 +181,91 @@ static
 void isrThread(void*);
 
 static
-void stopIsrThread(osdISR *isr);
+void stopIsrThread(osdPCIDevice *osd);
+
+/* Each /dev/uio# is read by a single waiter, which calls
+ * all ISRs connected to that device in turn.
+ *
+ * The waiter is either a thread for each device (default),
+ * or when devPCIISRThreads>0 a reactor with a pool of threads
+ * waiting on one epoll fd.  Each /dev/uio# is added with EPOLLONESHOT,
+ * so that only one thread services a device at a time.
+ * The choice is made when the first ISR is connected.
+ */
+static
+int reactor_fd = -1;
+
+static
+unsigned reactor_nthreads;
+
+/* eventfd in the epoll set with a NULL data.ptr.  Level triggered,
+ * so every reactor thread sees it once written.
+ */
+static
+int reactor_stopfd = -1;
+
+/* number of reactor threads which have not exited.
+ * reactor_done is signaled as each exits.
+ */
+static
+int reactor_running;
+
+static
+epicsEventId reactor_done;
+
+static
+epicsThreadOnceId reactor_once = EPICS_THREAD_ONCE_INIT;
+
+static
+void reactorInit(void*);
+
+static
+void reactorStop(void);
 
 static
 ELLLIST devices = {{NULL,NULL},0}; /* list of osdPCIDevices::node */
 
+/* devices removed by linuxDevPCIRescan(), kept until linuxDevFinal() */
+static
+ELLLIST removed_devices = {{NULL,NULL},0};
+
 /* guard access to 'devices' list */
 static
 epicsMutexId pciLock=NULL;
 
+/* Immutable snapshot of 'devices' which searches walk without locking.
+ * Replaced, never modified, with pciLock held.
+ * Replaced tables are kept until linuxDevFinal() as a search may still be using one.
+ */
+typedef struct osdPCITable {
+    struct osdPCITable *prev; /* replaced table */
+    size_t count;
+    osdPCIDevice *devs[1];
+} osdPCITable;
+
+static
+EpicsAtomicPtrT pciTable;
+
 static
 long pagesize;
 
-#define BUSBASE "/sys/bus/pci/devices/%04x:%02x:%02x.%x/"
+/* Prefix of all /sys and /dev paths.  Empty except for testing
+ * with a synthetic tree named by $DEVLIB2_PCI_ROOT.
+ */
+static
+char pciroot[PATH_MAX];
+
+static char linuxdevicesdir[PATH_MAX];
+static char linuxslotsdir[PATH_MAX];
+
+#define BUSBASE "%s/sys/bus/pci/devices/%04x:%02x:%02x.%x/"
 
 #define UIONUM     "uio%u"
 
 #define RESNUM  BUSBASE"resource%u"
 
+#define RESNUMWC  BUSBASE"resource%u_wc"
+
 #define fbad(FILE) ( feof(FILE) || ferror(FILE))
 
 /* vsprintf() w/ allocation.  The result must be free'd!
@@ -265,6 +378,46 @@ read_sysfs(int *err, const char *fileformat, ...)
     return ret;
 }
 
+/* Read a sysfs attribute of a device relative to an open directory.
+ * Like read_sysfs() without allocation.
+ */
+static
+unsigned long
+read_sysfs_at(int *err, int dfd, const char *dname, const char *attr)
+{
+    unsigned long ret=0;
+    char path[64], buf[32], *end;
+    ssize_t n;
+    int fd;
+
+    if (*err) return ret;
+    *err=1;
+
+    epicsSnprintf(path, sizeof(path), "%s/%s", dname, attr);
+
+    fd=openat(dfd, path, O_RDONLY|O_CLOEXEC);
+    if (fd<0) {
+        fprintf(stderr, "read_sysfs_at: Failed to open %s\n",path);
+        return ret;
+    }
+    n=read(fd, buf, sizeof(buf)-1);
+    close(fd);
+    if (n<=0) {
+        fprintf(stderr, "read_sysfs_at: Failed to read %s\n",path);
+        return ret;
+    }
+    buf[n]='\0';
+
+    ret=strtoul(buf, &end, 0);
+    if (end==buf) {
+        fprintf(stderr, "read_sysfs_at: Failed to parse %s\n",path);
+        return 0;
+    }
+
+    *err=0;
+    return ret;
+}
+
 /* location of UIO entries in sysfs tree
  *
  * circa 2.6.28
@@ -329,7 +482,7 @@ find_uio_number(const struct osdPCIDevice* osd)
     {
         int ret=-1;
         char *devdir=NULL;
-        devdir=allocPrintf(curloc->dir, osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
+        devdir=allocPrintf(curloc->dir, pciroot, osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
         if (!devdir)
             break;
         ret = find_uio_number2(devdir, curloc->name);
@@ -354,7 +507,7 @@ open_uio(struct osdPCIDevice* osd)
     uio=find_uio_number(osd);
     if (uio<0) goto fail;
 
-    devname=allocPrintf("/dev/uio%u", uio);
+    devname=allocPrintf("%s/dev/uio%u", pciroot, uio);
     if (!devname) goto fail;
 
     /* First try to open /dev/uio# */
@@ -382,7 +535,7 @@ open_res(struct osdPCIDevice *osd, unsigned int bar)
     if ( osd->rfd[bar] >= 0 )
         return 0;
 
-    if ( ! (fname = allocPrintf(RESNUM, osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function, bar)) )
+    if ( ! (fname = allocPrintf(RESNUM, pciroot, osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function, bar)) )
         goto fail;
 
     if ( (osd->rfd[bar] = open(fname, O_RDWR)) < 0 ) {
@@ -402,14 +555,29 @@ void
 close_uio(struct osdPCIDevice* osd)
 {
     unsigned int i;
+    ELLNODE *cur;
 
     for(i=0; i<PCIBARCOUNT; i++) {
         if (!osd->base[i]) continue;
 
-        munmap((void*)osd->base[i], osd->offset[i]+osd->len[i]);
+        munmap((void*)osd->base[i], (size_t)(osd->offset[i]+osd->len[i]));
         osd->base[i]=NULL;
     }
 
+    for(i=0; i<PCIBARCOUNT; i++) {
+        if (!osd->base_wc[i]) continue;
+
+        munmap((void*)osd->base_wc[i], (size_t)(osd->offset[i]+osd->len[i]));
+        osd->base_wc[i]=NULL;
+    }
+
+    while ((cur=ellGet(&osd->windows))!=NULL) {
+        osdPCIWindow *win = CONTAINER(cur, osdPCIWindow, node);
+
+        munmap(win->base, win->maplen);
+        free(win);
+    }
+
     if (osd->fd!=-1) close(osd->fd);
     osd->fd=-1;
 
@@ -421,223 +589,1133 @@ close_uio(struct osdPCIDevice* osd)
     }
 }
 
-static const char linuxslotsdir[] = "/sys/bus/pci/slots";
-
+/* Parse the 'resource' file of a device, giving BAR and ROM addresses and lengths */
 static
-int linuxDevPCIInit(void)
+void
+parse_resource(osdPCIDevice *osd, FILE *file, const char *filename)
 {
+    unsigned long long int start,stop,flags;
+    unsigned int i;
+    int match;
 
-    DIR* sysfsPci_dir=NULL;
-    struct dirent* dir;
-    osdPCIDevice *osd=NULL;
-    pciLock = epicsMutexMustCreate();
-    int host_is_first = 0;
+    for (i=0; i<PCIBARCOUNT; i++) { /* read 6 BARs */
+        match = fscanf(file, "0x%16llx 0x%16llx 0x%16llx\n", &start, &stop, &flags);
 
-    pagesize=sysconf(_SC_PAGESIZE);
-    if (pagesize==-1) {
-        perror("Failed to get pagesize");
-        goto fail;
-    }
+        if (match != 3) {
+            fprintf(stderr, "Could not parse line %u of %s\n", i+1, filename);
+            continue;
+        }
 
-    sysfsPci_dir = opendir("/sys/bus/pci/devices");
-    if (!sysfsPci_dir){
-        fprintf(stderr, "Could not open /sys/bus/pci/devices!\n");
-        goto fail;
+        osd->dev.bar[i].ioport = (flags & PCI_BASE_ADDRESS_SPACE)==PCI_BASE_ADDRESS_SPACE_IO;
+        osd->dev.bar[i].below1M = !!(flags&PCI_BASE_ADDRESS_MEM_TYPE_1M);
+        osd->dev.bar[i].addr64 = !!(flags&PCI_BASE_ADDRESS_MEM_TYPE_64);
+        osd->displayBAR[i] = start;
+
+        /* offset from start of page to start of BAR */
+        osd->offset[i] = osd->displayBAR[i]&(pagesize-1);
+        /* region length */
+        osd->len[i] = (start || stop ) ? (stop - start + 1) : 0;
+    }
+    /* rom */
+    match = fscanf(file, "%llx %llx %llx\n", &start, &stop, &flags);
+    if (match != 3) {
+        fprintf(stderr, "Could not parse line %u of %s\n", i+1, filename);
+        start = 0;
+        stop = 0;
     }
 
-    while ((dir=readdir(sysfsPci_dir))) {
-        char* filename;
-        FILE* file;
-        int fail=0;
-        int match;
-        unsigned long long int start,stop,flags;
-        char dname[80];
-        unsigned int i;
+    osd->displayErom = start;
+    osd->eromlen = (start || stop ) ? (stop - start + 1) : 0;
+}
 
-        if (!dir->d_name || dir->d_name[0]=='.') continue; /* Skip invalid entries */
+/* /sys/bus/pci/devices when devPCIEnumThreads>0, kept open to read attributes later */
+static
+int devicesfd = -1;
 
-        osd=calloc(1, sizeof(osdPCIDevice));
-        if (!osd) {
-            errMessage(S_dev_noMemory, "Out of memory");
-            goto fail;
-        }
-        osd->fd=-1;
-        osd->cfd = -1;
-        for ( i=0; i<sizeof(osd->rfd)/sizeof(osd->rfd[0]); i++ )
-            osd->rfd[i] = -1;
+/* Read the attributes of a device not read by enum_device().
+ * Caller must take devLock.
+ */
+static
+void
+resolve_device(osdPCIDevice *osd)
+{
+    char dname[32], path[64], drv[80];
+    FILE *file;
+    int fd, fail=0;
+    ssize_t n;
 
-        osd->dev.slot = DEVPCI_NO_SLOT;
+    if (osd->resolved)
+        return;
 
-        match = sscanf(dir->d_name,"%x:%x:%x.%x",
-                       &osd->dev.domain,&osd->dev.bus,&osd->dev.device,&osd->dev.function);
-        if (match != 4){
-            fprintf(stderr, "Could not decode PCI device directory %s\n", dir->d_name);
-        }
+    epicsSnprintf(dname, sizeof(dname), "%04x:%02x:%02x.%x",
+                  osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
 
-        osd->dev.id.vendor=read_sysfs(&fail, BUSBASE "vendor",
-                                      osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
-        osd->dev.id.device=read_sysfs(&fail, BUSBASE "device",
-                                      osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
-        osd->dev.id.sub_vendor=read_sysfs(&fail, BUSBASE "subsystem_vendor",
-                                          osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
-        osd->dev.id.sub_device=read_sysfs(&fail, BUSBASE "subsystem_device",
-                                          osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
-        osd->dev.id.pci_class=read_sysfs(&fail, BUSBASE "class",
-                                         osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
-        osd->dev.irq=read_sysfs(&fail, BUSBASE "irq",
-                                osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
-        osd->dev.id.revision=0;
+    osd->dev.irq=read_sysfs_at(&fail, devicesfd, dname, "irq");
 
-        if (fail) {
-            fprintf(stderr, "Warning: Failed to read some attributes of PCI device %04x:%02x:%02x.%x\n"
-                            "         This may cause some searches to fail\n",
-                    osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
-            fail=0;
-        }
+    epicsSnprintf(path, sizeof(path), "%s/resource", dname);
+    fd=openat(devicesfd, path, O_RDONLY|O_CLOEXEC);
+    if (fd<0 || !(file=fdopen(fd, "r"))) {
+        fprintf(stderr, "Could not open resource file %s!\n", path);
+        if (fd>=0) close(fd);
+        fail=1;
+    } else {
+        parse_resource(osd, file, path);
+        fclose(file);
+    }
 
-        if(devPCIDebug>=1) {
-            fprintf(stderr, "linuxDevPCIInit found %04x:%02x:%02x.%x\n",
-                    osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
-            fprintf(stderr, " as pri %04x:%04x sub %04x:%04x cls %06x\n",
-                    osd->dev.id.vendor, osd->dev.id.device,
-                    osd->dev.id.sub_vendor, osd->dev.id.sub_device,
-                    osd->dev.id.pci_class);
-        }
+    if (fail) {
+        fprintf(stderr, "Warning: Failed to read some attributes of PCI device %s\n", dname);
+    }
 
-        /* Read BAR info */
+    /* driver name */
+    epicsSnprintf(path, sizeof(path), "%s/driver", dname);
+    n=readlinkat(devicesfd, path, drv, sizeof(drv)-1);
+    if (n!=-1) {
+        drv[n]='\0';
+        osd->dev.driver = epicsStrDup(basename(drv));
+    }
 
-        /* Base address */
-        
-        filename = allocPrintf(BUSBASE "resource",
-                               osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
-        if (!filename) {
-            errMessage(S_dev_noMemory, "Out of memory");
-            goto fail;
-        }
-        file=fopen(filename, "r");
-        if (!file) {
-            fprintf(stderr, "Could not open resource file %s!\n", filename);
-            free(filename);
-            continue;
-        }
-        for (i=0; i<PCIBARCOUNT; i++) { /* read 6 BARs */
-            match = fscanf(file, "0x%16llx 0x%16llx 0x%16llx\n", &start, &stop, &flags);
+    /* only try once.  Publish to searches which do not lock */
+    epicsAtomicSetIntT(&osd->resolved, 1);
+}
 
-            if (match != 3) {
-                fprintf(stderr, "Could not parse line %u of %s\n", i+1, filename);
-                continue;
-            }
+/* Replace the search snapshot with the current 'devices' list.
+ * Caller must take pciLock, or be linuxDevPCIInit()
+ */
+static
+int
+publish_table(void)
+{
+    osdPCITable *tbl;
+    ELLNODE *cur;
+    size_t i=0;
 
-            osd->dev.bar[i].ioport = (flags & PCI_BASE_ADDRESS_SPACE)==PCI_BASE_ADDRESS_SPACE_IO;
-            osd->dev.bar[i].below1M = !!(flags&PCI_BASE_ADDRESS_MEM_TYPE_1M);
-            osd->dev.bar[i].addr64 = !!(flags&PCI_BASE_ADDRESS_MEM_TYPE_64);
-            osd->displayBAR[i] = start;
+    tbl=malloc(sizeof(*tbl) + ellCount(&devices)*sizeof(tbl->devs[0]));
+    if (!tbl) {
+        errMessage(S_dev_noMemory, "Out of memory");
+        return S_dev_noMemory;
+    }
 
-            /* offset from start of page to start of BAR */
-            osd->offset[i] = osd->displayBAR[i]&(pagesize-1);
-            /* region length */
-            osd->len[i] = (start || stop ) ? (stop - start + 1) : 0;
-        }
-        /* rom */
-        match = fscanf(file, "%llx %llx %llx\n", &start, &stop, &flags);
-        if (match != 3) {
-            fprintf(stderr, "Could not parse line %u of %s\n", i+1, filename);
-            start = 0;
-            stop = 0;
-        }
+    for(cur=ellFirst(&devices); cur; cur=ellNext(cur))
+        tbl->devs[i++] = CONTAINER(cur, osdPCIDevice, node);
+    tbl->count = i;
 
-        osd->displayErom = start;
-        osd->eromlen = (start || stop ) ? (stop - start + 1) : 0;
-        
-        fclose(file);
-        free(filename);
-        
-        /* driver name */
-        filename = allocPrintf(BUSBASE "driver",
-                               osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
-        if (!filename) {
-            errMessage(S_dev_noMemory, "Out of memory");
-            goto fail;
-        }
-        memset (dname, 0, sizeof(dname));
-        if (readlink(filename, dname, sizeof(dname)-1) != -1)
-            osd->dev.driver = epicsStrDup(basename(dname));
-        free(filename);
+    tbl->prev = epicsAtomicGetPtrT(&pciTable);
+    epicsAtomicSetPtrT(&pciTable, tbl);
+    return 0;
+}
 
-        osd->devLock = epicsMutexMustCreate();
+/* Read only the IDs of one device */
+static
+osdPCIDevice*
+enum_device(const char *dname)
+{
+    osdPCIDevice *osd;
+    unsigned int i;
+    int fail=0;
 
-        if (!ellCount(&devices))
-        {
-            host_is_first = (osd->dev.bus == 0 && osd->dev.device == 0);
-        }
-        ellInsert(&devices,host_is_first?ellLast(&devices):NULL,&osd->node);
-        osd=NULL;
+    osd=calloc(1, sizeof(osdPCIDevice));
+    if (!osd)
+        return NULL;
+
+    osd->fd=-1;
+    osd->cfd = -1;
+    for ( i=0; i<sizeof(osd->rfd)/sizeof(osd->rfd[0]); i++ )
+        osd->rfd[i] = -1;
+
+    osd->dev.slot = DEVPCI_NO_SLOT;
+
+    if (sscanf(dname,"%x:%x:%x.%x",
+               &osd->dev.domain,&osd->dev.bus,&osd->dev.device,&osd->dev.function) != 4){
+        fprintf(stderr, "Could not decode PCI device directory %s\n", dname);
     }
-    if (sysfsPci_dir)
-        closedir(sysfsPci_dir);
 
-    sysfsPci_dir = opendir(linuxslotsdir);
-    if (sysfsPci_dir){
-        while ((dir=readdir(sysfsPci_dir))) {
-            unsigned dom, B, D;
-            char *fullname;
-            FILE *fp;
+    osd->dev.id.vendor=read_sysfs_at(&fail, devicesfd, dname, "vendor");
+    osd->dev.id.device=read_sysfs_at(&fail, devicesfd, dname, "device");
+    osd->dev.id.sub_vendor=read_sysfs_at(&fail, devicesfd, dname, "subsystem_vendor");
+    osd->dev.id.sub_device=read_sysfs_at(&fail, devicesfd, dname, "subsystem_device");
+    osd->dev.id.pci_class=read_sysfs_at(&fail, devicesfd, dname, "class");
+    osd->dev.id.revision=0;
+
+    if (fail) {
+        fprintf(stderr, "Warning: Failed to read some attributes of PCI device %s\n"
+                        "         This may cause some searches to fail\n",
+                dname);
+    }
 
-            if (!dir->d_name || dir->d_name[0]=='.') continue; /* Skip invalid entries */
-            if(devPCIDebug>4)
-                fprintf(stderr, "examine /slots entry '%s'\n", dir->d_name);
+    return osd;
+}
 
-            fullname = allocPrintf("%s/%s/address", linuxslotsdir, dir->d_name);
-            if(!fullname) continue;
+typedef struct {
+    char (*names)[32];
+    osdPCIDevice **osds;
+    size_t count;
+    unsigned nthreads, running;
+} enumJob;
 
-            if(devPCIDebug>3)
-                fprintf(stderr, "found '%s'\n", fullname);
+/* Never destroyed, as the last worker may still be in epicsEventSignal()
+ * after enum_devices_fast() returns.
+ */
+static epicsMutexId enumLock;
+static epicsEventId enumDone;
 
-            if((fp=fopen(fullname, "r"))!=NULL) {
+typedef struct {
+    enumJob *job;
+    unsigned index;
+} enumWorker;
 
-                if(fscanf(fp, "%x:%x:%x", &dom, &B, &D)==3) {
-                    ELLNODE *cur;
-                    if(devPCIDebug>2)
-                        fprintf(stderr, "found slot %s with %04x:%02x:%02x.*\n", dir->d_name, dom, B, D);
+static
+void enum_work(enumJob *job, unsigned index)
+{
+    size_t i;
+    for (i=index; i<job->count; i+=job->nthreads)
+        job->osds[i] = enum_device(job->names[i]);
+}
 
-                    for(cur=ellFirst(&devices); cur; cur=ellNext(cur)) {
-                        osdPCIDevice *osd = CONTAINER(cur, osdPCIDevice, node);
-                        if(osd->dev.domain!=dom || osd->dev.bus!=B || osd->dev.device!=D)
-                            continue;
-                        if(osd->dev.slot==DEVPCI_NO_SLOT) {
-                            osd->dev.slot = strdup(dir->d_name); /* return NULL would mean slot remains unlabeled */
-                        } else {
-                            fprintf(stderr, "Duplicate slot address for %s\n", dir->d_name);
-                        }
-                    }
-                }
+static
+void enum_thread(void *raw)
+{
+    enumWorker *wrk = raw;
+    enumJob *job = wrk->job;
+    unsigned running;
 
-                fclose(fp);
-            }
-            free(fullname);
-        }
-        closedir(sysfsPci_dir);
-    } else if(devPCIDebug>0) {
-        fprintf(stderr, "/sys does not provide PCI slots listing\n");
-    }
+    enum_work(job, wrk->index);
 
+    /* job and wrk may be free'd once running reaches zero */
+    epicsMutexMustLock(enumLock);
+    running = --job->running;
+    epicsMutexUnlock(enumLock);
 
-    return 0;
-fail:
-    if (sysfsPci_dir)
-        closedir(sysfsPci_dir);
-    epicsMutexDestroy(pciLock);
-    return S_dev_badInit;
+    if (running==0)
+        epicsEventSignal(enumDone);
 }
 
+/* Inode of the config attribute of a device, or 0.
+ * sysfs attributes are re-created when a device is removed and added again
+ * at the same address.  eg. after an FPGA is reloaded.
+ */
 static
-int linuxDevFinal(void)
+ino_t
+config_inode(const osdPCIDevice *osd)
+{
+    char path[PATH_MAX];
+    struct stat st;
+
+    epicsSnprintf(path, sizeof(path), "%s/%04x:%02x:%02x.%x/config", linuxdevicesdir,
+                  osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
+    return stat(path, &st)==0 ? st.st_ino : 0;
+}
+
+/* Add a device to the list.  Host bridge 0:0.0 is kept first.
+ * With host_is_first==NULL, append to keep an order already established.
+ */
+static
+void
+enum_add(osdPCIDevice *osd, int *host_is_first)
+{
+    osd->devLock = epicsMutexMustCreate();
+    osd->callDone = epicsEventMustCreate(epicsEventEmpty);
+    osd->wakefd = -1;
+    osd->cfgino = config_inode(osd);
+
+    if (!host_is_first) {
+        ellAdd(&devices, &osd->node);
+        return;
+    }
+
+    if (!ellCount(&devices))
+    {
+        *host_is_first = (osd->dev.bus == 0 && osd->dev.device == 0);
+    }
+    ellInsert(&devices,*host_is_first?ellLast(&devices):NULL,&osd->node);
+}
+
+/* Fast enumeration.  Read only IDs, with several threads.
+ * Remaining attributes are read by resolve_device().
+ */
+static
+int
+enum_devices_fast(DIR *sysfsPci_dir)
+{
+    struct dirent* dir;
+    enumJob job;
+    enumWorker *workers = NULL;
+    size_t alloc = 0, i;
+    int host_is_first = 0, ret = 1;
+    unsigned t;
+
+    memset(&job, 0, sizeof(job));
+
+    devicesfd = dup(dirfd(sysfsPci_dir));
+    if (devicesfd<0) {
+        perror("Failed to dup PCI devices directory fd");
+        return 1;
+    }
+    fcntl(devicesfd, F_SETFD, FD_CLOEXEC);
+
+    while ((dir=readdir(sysfsPci_dir))) {
+        if (dir->d_name[0]=='.') continue; /* Skip invalid entries */
+
+        if (job.count==alloc) {
+            void *temp;
+            alloc = alloc ? 2*alloc : 64;
+            temp = realloc(job.names, alloc*sizeof(*job.names));
+            if (!temp) goto done;
+            job.names = temp;
+        }
+        strncpy(job.names[job.count], dir->d_name, sizeof(job.names[0])-1);
+        job.names[job.count][sizeof(job.names[0])-1] = '\0';
+        job.count++;
+    }
+
+    job.osds = calloc(job.count ? job.count : 1, sizeof(*job.osds));
+    if (!job.osds) goto done;
+
+    job.nthreads = devPCIEnumThreads;
+    if (job.nthreads > job.count/16 + 1)
+        job.nthreads = job.count/16 + 1; /* not worth a thread for only a few devices */
+
+    if (job.nthreads>1) {
+        workers = calloc(job.nthreads, sizeof(*workers));
+        if (!workers) goto done;
+
+        if (!enumLock) {
+            enumLock = epicsMutexMustCreate();
+            enumDone = epicsEventMustCreate(epicsEventEmpty);
+        }
+        job.running = job.nthreads-1;
+
+        /* this thread does the share of worker 0 */
+        for (t=1; t<job.nthreads; t++) {
+            char name[20];
+            workers[t].job = &job;
+            workers[t].index = t;
+            epicsSnprintf(name, sizeof(name), "PCIENUM%u", t);
+            if (!epicsThreadCreate(name, epicsThreadPriorityMedium,
+                                   epicsThreadGetStackSize(epicsThreadStackSmall),
+                                   enum_thread, &workers[t]))
+            {
+                /* do it ourselves */
+                enum_thread(&workers[t]);
+            }
+        }
+        enum_work(&job, 0);
+
+        epicsEventMustWait(enumDone);
+    } else {
+        job.nthreads = 1;
+        enum_work(&job, 0);
+    }
+
+    for (i=0; i<job.count; i++) {
+        if (!job.osds[i]) {
+            errMessage(S_dev_noMemory, "Out of memory");
+            goto done;
+        }
+    }
+
+    for (i=0; i<job.count; i++) {
+        if(devPCIDebug>=1) {
+            osdPCIDevice *osd = job.osds[i];
+            fprintf(stderr, "linuxDevPCIInit found %04x:%02x:%02x.%x\n",
+                    osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
+            fprintf(stderr, " as pri %04x:%04x sub %04x:%04x cls %06x\n",
+                    osd->dev.id.vendor, osd->dev.id.device,
+                    osd->dev.id.sub_vendor, osd->dev.id.sub_device,
+                    osd->dev.id.pci_class);
+        }
+        enum_add(job.osds[i], &host_is_first);
+        job.osds[i] = NULL;
+    }
+
+    ret = 0;
+done:
+    if (job.osds)
+        for (i=0; i<job.count; i++)
+            free(job.osds[i]);
+    free(job.osds);
+    free(job.names);
+    free(workers);
+    return ret;
+}
+
+/* Enumeration cache.
+ *
+ * When $DEVLIB2_PCI_CACHE names a file, the device table is saved there
+ * after enumeration, and loaded on the next start instead of reading sysfs.
+ * The file is only used if its fingerprint matches the current boot id,
+ * the listings of /sys/bus/pci/devices and slots, and some state of each device.
+ */
+#define CACHE_MAGIC "# devlib2 PCI cache 2"
+
+/* Per-device part of the fingerprint.  Cheaper than a full enumeration,
+ * as only one small file is read.
+ */
+static
+unsigned
+cache_hash_device(int dfd, const char *name, unsigned hash)
+{
+    char path[PATH_MAX], buf[1024];
+    struct stat st;
+    ssize_t n;
+    int fd;
+
+    /* attributes are re-created when the device is removed and re-scanned.
+     * eg. after an FPGA is reloaded.
+     */
+    epicsSnprintf(path, sizeof(path), "%s/config", name);
+    if (fstatat(dfd, path, &st, 0)==0) {
+        hash=epicsMemHash((const char*)&st.st_ino, sizeof(st.st_ino), hash);
+        hash=epicsMemHash((const char*)&st.st_mtime, sizeof(st.st_mtime), hash);
+    }
+
+    /* BAR addresses and sizes */
+    epicsSnprintf(path, sizeof(path), "%s/resource", name);
+    if ((fd=openat(dfd, path, O_RDONLY|O_CLOEXEC))>=0) {
+        while ((n=read(fd, buf, sizeof(buf)))>0)
+            hash=epicsMemHash(buf, n, hash);
+        close(fd);
+    }
+
+    /* bound driver */
+    epicsSnprintf(path, sizeof(path), "%s/driver", name);
+    if ((n=readlinkat(dfd, path, buf, sizeof(buf)))>0)
+        hash=epicsMemHash(buf, n, hash);
+
+    return hash;
+}
+
+static
+unsigned
+cache_hash_dir(const char *dname, unsigned hash, unsigned *count, int perdev)
+{
+    DIR *d;
+    struct dirent *ent;
+
+    d=opendir(dname);
+    if (!d)
+        return hash;
+
+    while ((ent=readdir(d))!=NULL) {
+        if (ent->d_name[0]=='.') continue;
+        hash=epicsStrHash(ent->d_name, hash);
+        if (perdev)
+            hash=cache_hash_device(dirfd(d), ent->d_name, hash);
+        (*count)++;
+    }
+    closedir(d);
+    return hash;
+}
+
+static
+void
+cache_fingerprint(char *buf, size_t buflen)
+{
+    char bootid[40] = "unknown";
+    unsigned hash=0, ndevs=0, nslots=0;
+    FILE *fp;
+
+    if ((fp=fopen("/proc/sys/kernel/random/boot_id", "r"))!=NULL) {
+        if (fscanf(fp, "%39s", bootid)!=1)
+            strcpy(bootid, "unknown");
+        fclose(fp);
+    }
+
+    hash=cache_hash_dir(linuxdevicesdir, hash, &ndevs, 1);
+    hash=cache_hash_dir(linuxslotsdir, hash, &nslots, 0);
+
+    epicsSnprintf(buf, buflen, "fingerprint %s %u %u %08x", bootid, ndevs, nslots, hash);
+}
+
+/* Returns zero if the device table was loaded */
+static
+int
+cache_load(const char *fname, const char *fingerprint)
+{
+    FILE *fp;
+    char line[512];
+    unsigned lineno=0;
+
+    fp=fopen(fname, "r");
+    if (!fp) {
+        if(devPCIDebug>0)
+            fprintf(stderr, "No PCI cache %s\n", fname);
+        return 1;
+    }
+
+    if (!fgets(line, sizeof(line), fp) || strncmp(line, CACHE_MAGIC, strlen(CACHE_MAGIC))!=0 ||
+            !fgets(line, sizeof(line), fp) || strncmp(line, fingerprint, strlen(fingerprint))!=0 ||
+            line[strlen(fingerprint)]!='\n')
+    {
+        if(devPCIDebug>0)
+            fprintf(stderr, "PCI cache %s is stale\n", fname);
+        fclose(fp);
+        return 1;
+    }
+    lineno=2;
+
+    while (fgets(line, sizeof(line), fp)) {
+        osdPCIDevice *osd;
+        char driver[64], slot[64];
+        unsigned i, flags, irq;
+        int pos=0, n;
+
+        lineno++;
+
+        osd=calloc(1, sizeof(osdPCIDevice));
+        if (!osd) {
+            errMessage(S_dev_noMemory, "Out of memory");
+            goto fail;
+        }
+        osd->fd=-1;
+        osd->cfd = -1;
+        for ( i=0; i<sizeof(osd->rfd)/sizeof(osd->rfd[0]); i++ )
+            osd->rfd[i] = -1;
+        osd->resolved = 1;
+
+        if (sscanf(line, "%x:%x:%x.%x %x %x %x %x %x %u %x %x %63s %63s%n",
+                   &osd->dev.domain, &osd->dev.bus, &osd->dev.device, &osd->dev.function,
+                   &osd->dev.id.vendor, &osd->dev.id.device,
+                   &osd->dev.id.sub_vendor, &osd->dev.id.sub_device,
+                   &osd->dev.id.pci_class, &irq,
+                   &osd->displayErom, &osd->eromlen,
+                   driver, slot, &pos)!=14)
+        {
+            fprintf(stderr, "%s:%u: corrupt PCI cache entry\n", fname, lineno);
+            free(osd);
+            goto fail;
+        }
+
+        for (i=0; i<PCIBARCOUNT; i++) {
+            unsigned long long addr, len;
+
+            if (sscanf(line+pos, " %llx %llx %x%n",
+                       &addr, &len, &flags, &n)!=3)
+            {
+                fprintf(stderr, "%s:%u: corrupt PCI cache entry\n", fname, lineno);
+                free(osd);
+                goto fail;
+            }
+            pos += n;
+
+            osd->displayBAR[i] = addr;
+            osd->len[i] = len;
+
+            osd->dev.bar[i].ioport = !!(flags&1);
+            osd->dev.bar[i].below1M = !!(flags&2);
+            osd->dev.bar[i].addr64 = !!(flags&4);
+            osd->offset[i] = osd->displayBAR[i]&(pagesize-1);
+        }
+
+        osd->dev.irq = irq;
+        osd->dev.driver = strcmp(driver, "-")==0 ? NULL : epicsStrDup(driver);
+        osd->dev.slot = strcmp(slot, "-")==0 ? DEVPCI_NO_SLOT : epicsStrDup(slot);
+
+        enum_add(osd, NULL);
+    }
+
+    fclose(fp);
+    if(devPCIDebug>0)
+        fprintf(stderr, "Loaded %d PCI devices from %s\n", ellCount(&devices), fname);
+    return 0;
+fail:
+    fclose(fp);
+    /* discard partial table, then enumerate normally */
+    {
+        ELLNODE *cur;
+        while ((cur=ellGet(&devices))!=NULL) {
+            osdPCIDevice *osd = CONTAINER(cur, osdPCIDevice, node);
+            free((char*)osd->dev.driver);
+            if (osd->dev.slot!=DEVPCI_NO_SLOT)
+                free((char*)osd->dev.slot);
+            epicsMutexDestroy(osd->devLock);
+            epicsEventDestroy(osd->callDone);
+            free(osd);
+        }
+    }
+    return 1;
+}
+
+static
+void
+cache_save(const char *fname, const char *fingerprint)
+{
+    ELLNODE *cur;
+    char *tmpname;
+    FILE *fp;
+    int ok;
+
+    tmpname=allocPrintf("%s.%ld", fname, (long)getpid());
+    if (!tmpname)
+        return;
+
+    fp=fopen(tmpname, "w");
+    if (!fp) {
+        fprintf(stderr, "Can't write PCI cache %s: %s\n", tmpname, strerror(errno));
+        free(tmpname);
+        return;
+    }
+
+    fprintf(fp, "%s\n%s\n", CACHE_MAGIC, fingerprint);
+
+    for(cur=ellFirst(&devices); cur; cur=ellNext(cur)) {
+        osdPCIDevice *osd = CONTAINER(cur, osdPCIDevice, node);
+        unsigned i;
+
+        resolve_device(osd);
+
+        fprintf(fp, "%04x:%02x:%02x.%x %x %x %x %x %x %u %x %x %s %s",
+                osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function,
+                osd->dev.id.vendor, osd->dev.id.device,
+                osd->dev.id.sub_vendor, osd->dev.id.sub_device,
+                osd->dev.id.pci_class, osd->dev.irq,
+                (unsigned)osd->displayErom, (unsigned)osd->eromlen,
+                osd->dev.driver ? osd->dev.driver : "-",
+                osd->dev.slot!=DEVPCI_NO_SLOT ? osd->dev.slot : "-");
+        for (i=0; i<PCIBARCOUNT; i++) {
+            fprintf(fp, " %llx %llx %x",
+                    (unsigned long long)osd->displayBAR[i], (unsigned long long)osd->len[i],
+                    osd->dev.bar[i].ioport | osd->dev.bar[i].below1M<<1 | osd->dev.bar[i].addr64<<2);
+        }
+        fprintf(fp, "\n");
+    }
+
+    ok = !ferror(fp);
+    if (fclose(fp))
+        ok = 0;
+
+    /* replace atomically so that concurrent IOCs never see a partial file */
+    if (!ok || rename(tmpname, fname)) {
+        fprintf(stderr, "Can't write PCI cache %s: %s\n", fname, strerror(errno));
+        unlink(tmpname);
+    } else if(devPCIDebug>0) {
+        fprintf(stderr, "Saved PCI cache %s\n", fname);
+    }
+    free(tmpname);
+}
+
+static
+void
+slot_label(osdPCIDevice *osd, unsigned dom, unsigned B, unsigned D, const char *name)
+{
+    if(osd->dev.domain!=dom || osd->dev.bus!=B || osd->dev.device!=D)
+        return;
+    if(osd->dev.slot==DEVPCI_NO_SLOT) {
+        osd->dev.slot = strdup(name); /* return NULL would mean slot remains unlabeled */
+    } else if(strcmp(osd->dev.slot, name)!=0) {
+        fprintf(stderr, "Duplicate slot address for %s\n", name);
+    }
+}
+
+/* Label devices with the slots they occupy.
+ * All devices in the 'devices' list when only==NULL, which must not yet be published.
+ * Otherwise only the 'nonly' devices of only[], which are not yet published.
+ * Caller must take pciLock, or be linuxDevPCIInit()
+ */
+static
+void
+read_slots(osdPCIDevice **only, size_t nonly)
+{
+    DIR* slots_dir;
+    struct dirent* dir;
+
+    slots_dir = opendir(linuxslotsdir);
+    if (slots_dir){
+        while ((dir=readdir(slots_dir))) {
+            unsigned dom, B, D;
+            char *fullname;
+            FILE *fp;
+
+            if (!dir->d_name || dir->d_name[0]=='.') continue; /* Skip invalid entries */
+            if(devPCIDebug>4)
+                fprintf(stderr, "examine /slots entry '%s'\n", dir->d_name);
+
+            fullname = allocPrintf("%s/%s/address", linuxslotsdir, dir->d_name);
+            if(!fullname) continue;
+
+            if(devPCIDebug>3)
+                fprintf(stderr, "found '%s'\n", fullname);
+
+            if((fp=fopen(fullname, "r"))!=NULL) {
+
+                if(fscanf(fp, "%x:%x:%x", &dom, &B, &D)==3) {
+                    ELLNODE *cur;
+                    size_t i;
+                    if(devPCIDebug>2)
+                        fprintf(stderr, "found slot %s with %04x:%02x:%02x.*\n", dir->d_name, dom, B, D);
+
+                    if(only) {
+                        for(i=0; i<nonly; i++)
+                            slot_label(only[i], dom, B, D, dir->d_name);
+                    } else {
+                        for(cur=ellFirst(&devices); cur; cur=ellNext(cur))
+                            slot_label(CONTAINER(cur, osdPCIDevice, node), dom, B, D, dir->d_name);
+                    }
+                }
+
+                fclose(fp);
+            }
+            free(fullname);
+        }
+        closedir(slots_dir);
+    } else if(devPCIDebug>0) {
+        fprintf(stderr, "/sys does not provide PCI slots listing\n");
+    }
+}
+
+/* Return true for a uevent message about a PCI device being added or removed */
+static
+int
+uevent_is_pci(const char *msg, size_t len)
+{
+    const char *cur = msg, *end = msg+len;
+    int pci = 0, action = 0;
+
+    for (; cur<end; cur += strlen(cur)+1) {
+        if (strcmp(cur, "SUBSYSTEM=pci")==0)
+            pci = 1;
+        else if (strcmp(cur, "ACTION=add")==0 || strcmp(cur, "ACTION=remove")==0)
+            action = 1;
+    }
+    return pci && action;
+}
+
+static
+void
+hotplugThread(void *raw)
+{
+    int fd = (int)(size_t)raw;
+    char buf[4096];
+
+    while (1) {
+        struct pollfd pfd;
+        ssize_t n = recv(fd, buf, sizeof(buf)-1, 0);
+
+        if (n<0) {
+            if (errno!=EINTR && errno!=ENOBUFS) {
+                errlogPrintf("PCI hotplug recv error %d\n", errno);
+                epicsThreadSleep(1.0);
+            }
+            continue;
+        }
+        buf[n] = '\0';
+
+        if (!uevent_is_pci(buf, n))
+            continue;
+
+        /* A card often brings several functions and bridges.
+         * Wait for the burst of events to end.
+         */
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        while (poll(&pfd, 1, 500)>0) {
+            if (recv(fd, buf, sizeof(buf)-1, 0)<0 && errno!=EINTR && errno!=ENOBUFS)
+                break;
+        }
+
+        if ((n=devPCIRescan())!=0)
+            errlogPrintf("PCI hotplug rescan fails with %d\n", (int)n);
+    }
+}
+
+static
+void
+start_hotplug(void)
+{
+    struct sockaddr_nl addr;
+    int fd;
+
+    fd = socket(AF_NETLINK, SOCK_DGRAM|SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (fd<0) {
+        fprintf(stderr, "Failed to open uevent socket, no PCI hotplug: %s\n", strerror(errno));
+        return;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = 1; /* kernel events */
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr))) {
+        fprintf(stderr, "Failed to bind uevent socket, no PCI hotplug: %s\n", strerror(errno));
+        close(fd);
+        return;
+    }
+
+    if (!epicsThreadCreate("PCIHOTPLUG",
+                           epicsThreadPriorityMedium,
+                           epicsThreadGetStackSize(epicsThreadStackMedium),
+                           hotplugThread,
+                           (void*)(size_t)fd))
+    {
+        fprintf(stderr, "Failed to create PCI hotplug thread\n");
+        close(fd);
+    }
+}
+
+static
+int linuxDevPCIInit(void)
+{
+
+    DIR* sysfsPci_dir=NULL;
+    struct dirent* dir;
+    osdPCIDevice *osd=NULL;
+    pciLock = epicsMutexMustCreate();
+    int host_is_first = 0;
+    const char *cachefile = getenv("DEVLIB2_PCI_CACHE");
+    char fingerprint[128];
+
+    pagesize=sysconf(_SC_PAGESIZE);
+    if (pagesize==-1) {
+        perror("Failed to get pagesize");
+        goto fail;
+    }
+
+    {
+        const char *root = getenv("DEVLIB2_PCI_ROOT");
+        if (root && strlen(root)>=sizeof(pciroot)-32) {
+            fprintf(stderr, "DEVLIB2_PCI_ROOT too long\n");
+            goto fail;
+        }
+        strcpy(pciroot, root ? root : "");
+        if (pciroot[0])
+            fprintf(stderr, "Note: PCI devices from %s\n", pciroot);
+        epicsSnprintf(linuxdevicesdir, sizeof(linuxdevicesdir), "%s/sys/bus/pci/devices", pciroot);
+        epicsSnprintf(linuxslotsdir, sizeof(linuxslotsdir), "%s/sys/bus/pci/slots", pciroot);
+    }
+
+    if (cachefile && cachefile[0]) {
+        cache_fingerprint(fingerprint, sizeof(fingerprint));
+        if (cache_load(cachefile, fingerprint)==0) {
+            if (publish_table())
+                goto fail;
+            if (devPCIHotplug)
+                start_hotplug();
+            return 0;
+        }
+    } else {
+        cachefile = NULL;
+    }
+
+    sysfsPci_dir = opendir(linuxdevicesdir);
+    if (!sysfsPci_dir){
+        fprintf(stderr, "Could not open %s!\n", linuxdevicesdir);
+        goto fail;
+    }
+
+    if (devPCIEnumThreads>0) {
+        if (enum_devices_fast(sysfsPci_dir))
+            goto fail;
+    }
+
+    while (devPCIEnumThreads<=0 && (dir=readdir(sysfsPci_dir))) {
+        char* filename;
+        FILE* file;
+        int fail=0;
+        int match;
+        char dname[80];
+        unsigned int i;
+
+        if (!dir->d_name || dir->d_name[0]=='.') continue; /* Skip invalid entries */
+
+        osd=calloc(1, sizeof(osdPCIDevice));
+        if (!osd) {
+            errMessage(S_dev_noMemory, "Out of memory");
+            goto fail;
+        }
+        osd->fd=-1;
+        osd->cfd = -1;
+        for ( i=0; i<sizeof(osd->rfd)/sizeof(osd->rfd[0]); i++ )
+            osd->rfd[i] = -1;
+
+        osd->dev.slot = DEVPCI_NO_SLOT;
+        osd->resolved = 1;
+
+        match = sscanf(dir->d_name,"%x:%x:%x.%x",
+                       &osd->dev.domain,&osd->dev.bus,&osd->dev.device,&osd->dev.function);
+        if (match != 4){
+            fprintf(stderr, "Could not decode PCI device directory %s\n", dir->d_name);
+        }
+
+        osd->dev.id.vendor=read_sysfs(&fail, BUSBASE "vendor",
+                                      pciroot, osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
+        osd->dev.id.device=read_sysfs(&fail, BUSBASE "device",
+                                      pciroot, osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
+        osd->dev.id.sub_vendor=read_sysfs(&fail, BUSBASE "subsystem_vendor",
+                                          pciroot, osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
+        osd->dev.id.sub_device=read_sysfs(&fail, BUSBASE "subsystem_device",
+                                          pciroot, osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
+        osd->dev.id.pci_class=read_sysfs(&fail, BUSBASE "class",
+                                         pciroot, osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
+        osd->dev.irq=read_sysfs(&fail, BUSBASE "irq",
+                                pciroot, osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
+        osd->dev.id.revision=0;
+
+        if (fail) {
+            fprintf(stderr, "Warning: Failed to read some attributes of PCI device %04x:%02x:%02x.%x\n"
+                            "         This may cause some searches to fail\n",
+                    osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
+            fail=0;
+        }
+
+        if(devPCIDebug>=1) {
+            fprintf(stderr, "linuxDevPCIInit found %04x:%02x:%02x.%x\n",
+                    osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
+            fprintf(stderr, " as pri %04x:%04x sub %04x:%04x cls %06x\n",
+                    osd->dev.id.vendor, osd->dev.id.device,
+                    osd->dev.id.sub_vendor, osd->dev.id.sub_device,
+                    osd->dev.id.pci_class);
+        }
+
+        /* Read BAR info */
+
+        /* Base address */
+        
+        filename = allocPrintf(BUSBASE "resource",
+                               pciroot, osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
+        if (!filename) {
+            errMessage(S_dev_noMemory, "Out of memory");
+            goto fail;
+        }
+        file=fopen(filename, "r");
+        if (!file) {
+            fprintf(stderr, "Could not open resource file %s!\n", filename);
+            free(filename);
+            continue;
+        }
+        parse_resource(osd, file, filename);
+        
+        fclose(file);
+        free(filename);
+        
+        /* driver name */
+        filename = allocPrintf(BUSBASE "driver",
+                               pciroot, osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function);
+        if (!filename) {
+            errMessage(S_dev_noMemory, "Out of memory");
+            goto fail;
+        }
+        memset (dname, 0, sizeof(dname));
+        if (readlink(filename, dname, sizeof(dname)-1) != -1)
+            osd->dev.driver = epicsStrDup(basename(dname));
+        free(filename);
+
+        enum_add(osd, &host_is_first);
+        osd=NULL;
+    }
+    if (sysfsPci_dir)
+        closedir(sysfsPci_dir);
+
+    read_slots(NULL, 0);
+
+    if (cachefile)
+        cache_save(cachefile, fingerprint);
+
+    if (publish_table())
+        goto fail;
+
+    if (devPCIHotplug)
+        start_hotplug();
+
+    return 0;
+fail:
+    if (sysfsPci_dir)
+        closedir(sysfsPci_dir);
+    epicsMutexDestroy(pciLock);
+    return S_dev_badInit;
+}
+
+static
+unsigned long
+dev_key(const osdPCIDevice *osd)
+{
+    return ((unsigned long)osd->dev.domain<<16) | (osd->dev.bus<<8) | (osd->dev.device<<3) | osd->dev.function;
+}
+
+static
+int
+dev_key_cmp(const void *lraw, const void *rraw)
+{
+    unsigned long L = dev_key(*(osdPCIDevice* const*)lraw),
+                  R = dev_key(*(osdPCIDevice* const*)rraw);
+    return L<R ? -1 : L>R ? 1 : 0;
+}
+
+/* Compare the sysfs listing with the current table.
+ * Add new devices and remove those which have gone.
+ * A device at an existing address, but with different IDs or re-created
+ * sysfs attributes, is removed and the new device added.
+ * Existing devices are not touched.
+ */
+static
+int
+linuxDevPCIRescan(devPCIHotplugFn notify, void *arg)
+{
+    DIR* sysfsPci_dir;
+    struct dirent* dir;
+    const osdPCITable *tbl;
+    osdPCIDevice **sorted = NULL, **added = NULL, **removed = NULL;
+    char *seen = NULL;
+    size_t nadded = 0, nremoved = 0, nalloc = 0, i;
+    int ret = S_dev_noMemory;
+
+    epicsMutexMustLock(pciLock);
+
+    if (devicesfd<0) {
+        devicesfd = open(linuxdevicesdir, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+        if (devicesfd<0) {
+            fprintf(stderr, "Could not open %s!\n", linuxdevicesdir);
+            epicsMutexUnlock(pciLock);
+            return S_dev_badInit;
+        }
+    }
+
+    sysfsPci_dir = opendir(linuxdevicesdir);
+    if (!sysfsPci_dir){
+        fprintf(stderr, "Could not open %s!\n", linuxdevicesdir);
+        epicsMutexUnlock(pciLock);
+        return S_dev_badInit;
+    }
+
+    tbl = epicsAtomicGetPtrT(&pciTable);
+
+    sorted = malloc((tbl->count+1)*sizeof(*sorted));
+    seen = calloc(tbl->count+1, 1);
+    removed = malloc((tbl->count+1)*sizeof(*removed));
+    if (!sorted || !seen || !removed)
+        goto done;
+
+    memcpy(sorted, tbl->devs, tbl->count*sizeof(*sorted));
+    qsort(sorted, tbl->count, sizeof(*sorted), dev_key_cmp);
+
+    while ((dir=readdir(sysfsPci_dir))) {
+        osdPCIDevice key, *pkey = &key, **found;
+
+        if (dir->d_name[0]=='.') continue; /* Skip invalid entries */
+
+        memset(&key, 0, sizeof(key));
+        if (sscanf(dir->d_name,"%x:%x:%x.%x",
+                   &key.dev.domain,&key.dev.bus,&key.dev.device,&key.dev.function) != 4)
+            continue;
+
+        found = bsearch(&pkey, sorted, tbl->count, sizeof(*sorted), dev_key_cmp);
+        if (found) {
+            const osdPCIDevice *osd = *found;
+            int fail = 0;
+            unsigned long vendor, device;
+
+            vendor = read_sysfs_at(&fail, devicesfd, dir->d_name, "vendor");
+            device = read_sysfs_at(&fail, devicesfd, dir->d_name, "device");
+
+            if (!fail && vendor==osd->dev.id.vendor && device==osd->dev.id.device
+                    && config_inode(osd)==osd->cfgino)
+            {
+                seen[found-sorted] = 1;
+                continue;
+            }
+            /* Replaced by a different device at the same address.
+             * Remove the old device and add the new.
+             */
+            if (devPCIDebug>0)
+                fprintf(stderr, "PCI rescan: %s replaced\n", dir->d_name);
+        }
+
+        if (nadded==nalloc) {
+            void *temp;
+            nalloc = nalloc ? 2*nalloc : 8;
+            temp = realloc(added, nalloc*sizeof(*added));
+            if (!temp) goto done;
+            added = temp;
+        }
+        if (!(added[nadded] = enum_device(dir->d_name)))
+            goto done;
+        nadded++;
+    }
+
+    for (i=0; i<tbl->count; i++) {
+        osdPCIDevice *osd = sorted[i];
+        if (seen[i])
+            continue;
+
+        epicsMutexMustLock(osd->devLock);
+        osd->removed = 1;
+        /* keep ISRs connected, but stop waiting on a device which has gone */
+        stopIsrThread(osd);
+        epicsMutexUnlock(osd->devLock);
+
+        ellDelete(&devices, &osd->node);
+        ellAdd(&removed_devices, &osd->node);
+        removed[nremoved++] = osd;
+    }
+
+    qsort(added, nadded, sizeof(*added), dev_key_cmp);
+
+    for (i=0; i<nadded; i++) {
+        resolve_device(added[i]);
+        enum_add(added[i], NULL);
+    }
+
+    /* published devices are not modified */
+    if (nadded) read_slots(added, nadded);
+
+    {
+        /* the enumeration cache no longer matches the table */
+        const char *cachefile = getenv("DEVLIB2_PCI_CACHE");
+        if (cachefile && cachefile[0] && unlink(cachefile) && errno!=ENOENT)
+            fprintf(stderr, "Failed to remove PCI cache %s : %s\n", cachefile, strerror(errno));
+    }
+
+    ret = 0;
+    if (nadded || nremoved)
+        ret = publish_table();
+    goto unlock;
+
+done:
+    /* failed before any change was made */
+    for (i=0; i<nadded; i++)
+        free(added[i]);
+    nadded = nremoved = 0;
+unlock:
+    epicsMutexUnlock(pciLock);
+    closedir(sysfsPci_dir);
+
+    if(devPCIDebug>0 || nadded || nremoved)
+        printf("PCI rescan: %u added, %u removed\n", (unsigned)nadded, (unsigned)nremoved);
+
+    for (i=0; i<nremoved; i++)
+        (*notify)(arg, &removed[i]->dev, devPCIHotplugRemove);
+    for (i=0; i<nadded; i++)
+        (*notify)(arg, &added[i]->dev, devPCIHotplugAdd);
+
+    free(sorted);
+    free(seen);
+    free(added);
+    free(removed);
+    return ret;
+}
+
+static
+int linuxDevFinal(void)
 {
     ELLNODE *cur, *next, *isrcur, *isrnext;
     osdPCIDevice *curdev=NULL;
     osdISR *isr;
+    osdPCITable *tbl;
+
+    /* A reactor thread may be about to dispatch to any device */
+    reactorStop();
 
     epicsMutexMustLock(pciLock);
+
+    ellConcat(&devices, &removed_devices);
+
+    tbl=epicsAtomicGetPtrT(&pciTable);
+    epicsAtomicSetPtrT(&pciTable, NULL);
+    while (tbl) {
+        osdPCITable *prev = tbl->prev;
+        free(tbl);
+        tbl = prev;
+    }
+
     for(cur=ellFirst(&devices), next=cur ? ellNext(cur) : NULL;
         cur;
         cur=next, next=next ? ellNext(next) : NULL )
@@ -646,21 +1724,25 @@ int linuxDevFinal(void)
 
         epicsMutexMustLock(curdev->devLock);
 
+        stopIsrThread(curdev);
+
         for(isrcur=ellFirst(&curdev->isrs), isrnext=isrcur ? ellNext(isrcur) : NULL;
             isrcur;
             isrcur=isrnext, isrnext=isrnext ? ellNext(isrnext) : NULL )
         {
             isr=CONTAINER(isrcur,osdISR,node);
 
-            stopIsrThread(isr);
-
-            ellDelete(&curdev->isrs,cur);
+            ellDelete(&curdev->isrs,isrcur);
             free(isr);
 
         }
 
         close_uio(curdev);
 
+        if (curdev->waiterDone)
+            epicsEventDestroy(curdev->waiterDone);
+        epicsEventDestroy(curdev->callDone);
+
         epicsMutexUnlock(curdev->devLock);
         epicsMutexDestroy(curdev->devLock);
         free(curdev);
@@ -668,6 +1750,10 @@ int linuxDevFinal(void)
     epicsMutexUnlock(pciLock);
     epicsMutexDestroy(pciLock);
 
+    if (devicesfd>=0)
+        close(devicesfd);
+    devicesfd = -1;
+
     return 0;
 }
 
@@ -681,21 +1767,19 @@ linuxDevPCIFindCB(
         )
 {
     int err=0, ret=0;
-    ELLNODE *cur;
+    size_t n;
+    const osdPCITable *tbl;
     osdPCIDevice *curdev=NULL;
     const epicsPCIID *search;
 
-    (void) opt;
     if(!searchfn || !idlist)
         return S_dev_badArgument;
 
-    epicsMutexMustLock(pciLock);
+    tbl=epicsAtomicGetPtrT(&pciTable);
 
-    cur=ellFirst(&devices);
-    for(; cur; cur=ellNext(cur)){
+    for(n=0; tbl && n<tbl->count; n++){
         unsigned i;
-        curdev=CONTAINER(cur,osdPCIDevice,node);
-        epicsMutexMustLock(curdev->devLock);
+        curdev=tbl->devs[n];
 
         if(devPCIDebug>1)
             printf("Consider %x:%x.%x\n", curdev->dev.bus, curdev->dev.device, curdev->dev.function);
@@ -707,6 +1791,12 @@ linuxDevPCIFindCB(
 
             /* Match found */
 
+            if (!(opt&DEVLIB_FIND_NORESOLVE) && !epicsAtomicGetIntT(&curdev->resolved)) {
+                epicsMutexMustLock(curdev->devLock);
+                resolve_device(curdev);
+                epicsMutexUnlock(curdev->devLock);
+            }
+
             err=searchfn(arg,&curdev->dev);
             if(err==0) /* Continue search */
                 continue;
@@ -714,18 +1804,12 @@ linuxDevPCIFindCB(
                 ret=0;
             else /* Abort search Err */
                 ret=err;
-            epicsMutexUnlock(curdev->devLock);
-            goto done;
+            return ret;
 
         }
 
-        epicsMutexUnlock(curdev->devLock);
-
     }
 
-done:
-    epicsMutexUnlock(pciLock);
-
     return ret;
 }
 
@@ -741,6 +1825,25 @@ static const char* fd2filename(int fd, char* buffer, size_t buffersize)
     return buffer;
 }
 
+/* Length of the mapping of a BAR, including the offset from the start of the page.
+ * Fails if the BAR is too large for the address space of this process.
+ */
+static
+int
+bar_map_size(const osdPCIDevice *osd, unsigned int bar, size_t *size)
+{
+    epicsUInt64 len = osd->offset[bar]+osd->len[bar];
+
+    *size = (size_t)len;
+    if (*size!=len) {
+        fprintf(stderr, "Can't map BAR %u of PCI device %04x:%02x:%02x.%x: %llu bytes is too large for this address space\n",
+                bar, osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function,
+                (unsigned long long)osd->len[bar]);
+        return S_dev_addrMapFail;
+    }
+    return 0;
+}
+
 static
 int
 map_bar(
@@ -751,6 +1854,7 @@ map_bar(
 {
     int mapno;
     int mapfd;
+    size_t size;
 
     if ( osd->dev.bar[bar].ioport ) {
         fprintf(stderr, "Failed to MMAP BAR %u of PCI device %04x:%02x:%02x.%x -- mapping of IOPORTS is not possible\n", bar,
@@ -758,6 +1862,9 @@ map_bar(
         return S_dev_addrMapFail;
     }
 
+    if ( bar_map_size(osd, bar, &size) )
+        return S_dev_addrMapFail;
+
     if ( (mapfd = osd->rfd[bar]) >= 0 ) {
         mapno = 0;
     } else {
@@ -777,64 +1884,329 @@ map_bar(
             }
         }
 
-        if ( mapno < 0 ) {
-            return S_dev_addrMapFail;
-        }
-        mapfd = osd->fd;
+        if ( mapno < 0 ) {
+            return S_dev_addrMapFail;
+        }
+        mapfd = osd->fd;
+    }
+
+    osd->base[bar] = mmap(NULL, size,
+                          PROT_READ|PROT_WRITE, MAP_SHARED,
+                          mapfd, mapno*pagesize);
+    if(devPCIDebug>0)
+    {
+        char mapfilename[128];
+        int err = errno;
+
+        fprintf(stderr, "mmap fd=%d %s, size=%#lx, offset=%#lx returned %p (errno=%d)\n",
+                mapfd, fd2filename(mapfd, mapfilename, sizeof(mapfilename)),
+                (unsigned long)size, mapno*pagesize, osd->base[bar], err);
+    }
+
+    if (osd->base[bar]==MAP_FAILED) {
+        osd->base[bar] = NULL;
+        if (osd->rfd[bar]) {
+            close(osd->rfd[bar]);
+            osd->rfd[bar] = -1;
+        }
+        return S_dev_addrMapFail;
+    }
+    return 0;
+}
+
+/* Map resource#_wc, which the kernel provides only for prefetchable BARs.
+ * The descriptor is not needed once mapped.
+ */
+static
+int
+map_bar_wc(
+        osdPCIDevice *osd,
+        unsigned int bar
+        )
+{
+    int   ret  = S_dev_addrMapFail;
+    int   fd   = -1;
+    char *fname=NULL;
+    void *base;
+    size_t size;
+
+    if ( osd->dev.bar[bar].ioport || bar_map_size(osd, bar, &size) )
+        return ret;
+
+    if ( ! (fname = allocPrintf(RESNUMWC, pciroot, osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function, bar)) )
+        goto fail;
+
+    if ( (fd = open(fname, O_RDWR)) < 0 ) {
+        if(devPCIDebug>0 || errno!=ENOENT)
+            fprintf(stderr, "Failed to open %s: %s\n", fname, strerror(errno));
+        goto fail;
+    }
+
+    base = mmap(NULL, size,
+                PROT_READ|PROT_WRITE, MAP_SHARED,
+                fd, 0);
+    if(devPCIDebug>0)
+        fprintf(stderr, "mmap %s, size=%#lx returned %p (errno=%d)\n",
+                fname, (unsigned long)size, base, errno);
+
+    if ( base==MAP_FAILED )
+        goto fail;
+
+    osd->base_wc[bar] = base;
+    ret = 0;
+fail:
+    if ( fd >= 0 )
+        close(fd);
+    free(fname);
+    return ret;
+}
+
+/* Map the whole BAR, or take another reference to an existing mapping.
+ * Caller must hold devLock
+ */
+static
+int
+map_whole(
+        osdPCIDevice *osd,
+        unsigned int bar,
+        volatile void **ppLocalAddr,
+        unsigned int opt
+        )
+{
+    if (opt&DEVLIB_MAP_WC) {
+        if (!osd->base_wc[bar])
+            (void)map_bar_wc(osd, bar);
+        if (osd->base_wc[bar]) {
+            osd->refs_wc[bar]++;
+            *ppLocalAddr=((volatile char*)osd->base_wc[bar]) + osd->offset[bar];
+            return 0;
+        }
+        /* no write combining available, fall back to normal mapping */
+    }
+
+    if (!osd->base[bar]) {
+        if (open_res(osd, bar)!=0 || map_bar(osd, bar, opt)!=0) {
+            if (open_uio(osd)!=0 || map_bar(osd, bar, opt)!=0) {
+                fprintf(stderr, "Can neither mmap resource file nor uio file of PCI device %04x:%02x:%02x.%x BAR %u\n",
+                        osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function, bar);
+                return S_dev_addrMapFail;
+            }
+        }
+    }
+    osd->refs[bar]++;
+    *ppLocalAddr=((volatile char*)osd->base[bar]) + osd->offset[bar];
+    return 0;
+}
+
+static
+int
+linuxDevPCIToLocalAddr(
+        const epicsPCIDevice* dev,
+        unsigned int bar,
+        volatile void **ppLocalAddr,
+        unsigned int opt
+        )
+{
+    osdPCIDevice *osd=CONTAINER((epicsPCIDevice*)dev,osdPCIDevice,dev);
+    int ret;
+
+    epicsMutexMustLock(osd->devLock);
+    ret = map_whole(osd, bar, ppLocalAddr, opt);
+    epicsMutexUnlock(osd->devLock);
+    return ret;
+}
+
+/* mmap() only the pages of the resource#(_wc) file covering a window.
+ * UIO can only map whole regions, so has no equivalent.
+ */
+static
+int
+map_window(
+        osdPCIDevice *osd,
+        osdPCIWindow *win
+        )
+{
+    epicsUInt64 start = osd->offset[win->bar] + win->offset,
+                pgstart = start & ~(epicsUInt64)(pagesize-1),
+                maplen = start + win->len - pgstart;
+    int   ret  = S_dev_addrMapFail;
+    int   fd   = -1;
+    char *fname=NULL;
+    void *base;
+
+    if ( osd->dev.bar[win->bar].ioport || (size_t)maplen!=maplen )
+        return ret;
+
+    if ( ! (fname = allocPrintf((win->opt&DEVLIB_MAP_WC) ? RESNUMWC : RESNUM, pciroot,
+                                osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function, win->bar)) )
+        goto fail;
+
+    if ( (fd = open(fname, O_RDWR)) < 0 ) {
+        if(devPCIDebug>0)
+            fprintf(stderr, "Failed to open %s: %s\n", fname, strerror(errno));
+        goto fail;
+    }
+
+    base = mmap(NULL, (size_t)maplen,
+                PROT_READ|PROT_WRITE, MAP_SHARED,
+                fd, (off_t)pgstart);
+    if(devPCIDebug>0)
+        fprintf(stderr, "mmap %s, size=%#lx, offset=%#llx returned %p (errno=%d)\n",
+                fname, (unsigned long)maplen, (unsigned long long)pgstart, base, errno);
+
+    if ( base==MAP_FAILED )
+        goto fail;
+
+    win->base = base;
+    win->maplen = (size_t)maplen;
+    win->addr = (volatile char*)base + (size_t)(start - pgstart);
+    ret = 0;
+fail:
+    if ( fd >= 0 )
+        close(fd);
+    free(fname);
+    return ret;
+}
+
+static
+int
+linuxDevPCIMapWindow(
+        const epicsPCIDevice* dev,
+        unsigned int bar,
+        epicsUInt64 offset,
+        epicsUInt64 len,
+        volatile void **ppLocalAddr,
+        unsigned int opt
+        )
+{
+    osdPCIDevice *osd=CONTAINER((epicsPCIDevice*)dev,osdPCIDevice,dev);
+    osdPCIWindow *win;
+    ELLNODE *cur;
+    int ret = 0;
+
+    if (len==0 || offset>osd->len[bar] || len>osd->len[bar]-offset)
+        return S_dev_badArgument;
+
+    epicsMutexMustLock(osd->devLock);
+
+    /* an existing mapping of the whole BAR also covers this window */
+    if ((opt&DEVLIB_MAP_WC) && osd->base_wc[bar]) {
+        osd->refs_wc[bar]++;
+        *ppLocalAddr=((volatile char*)osd->base_wc[bar]) + osd->offset[bar] + offset;
+        goto done;
+    } else if (!(opt&DEVLIB_MAP_WC) && osd->base[bar]) {
+        osd->refs[bar]++;
+        *ppLocalAddr=((volatile char*)osd->base[bar]) + osd->offset[bar] + offset;
+        goto done;
     }
 
-    osd->base[bar] = mmap(NULL, osd->offset[bar]+osd->len[bar],
-                          PROT_READ|PROT_WRITE, MAP_SHARED,
-                          mapfd, mapno*pagesize);
-    if(devPCIDebug>0)
-    {
-        char mapfilename[128];
-        int err = errno;
+    for(cur=ellFirst(&osd->windows); cur; cur=ellNext(cur)) {
+        win = CONTAINER(cur, osdPCIWindow, node);
+        if (win->bar==bar && win->offset==offset && win->len==len
+                && (win->opt&DEVLIB_MAP_WC)==(opt&DEVLIB_MAP_WC)) {
+            win->refs++;
+            *ppLocalAddr = win->addr;
+            goto done;
+        }
+    }
 
-        fprintf(stderr, "mmap fd=%d %s, size=%#lx, offset=%#lx returned %p (errno=%d)\n",
-                mapfd, fd2filename(mapfd, mapfilename, sizeof(mapfilename)),
-                (long)(osd->offset[bar]+osd->len[bar]), mapno*pagesize, osd->base[bar], err);
+    if (!(win=calloc(1, sizeof(*win)))) {
+        ret = S_dev_noMemory;
+        goto done;
+    }
+    win->bar = bar;
+    win->offset = offset;
+    win->len = len;
+    win->opt = opt&DEVLIB_MAP_WC;
+
+    ret = map_window(osd, win);
+    if (ret && (win->opt&DEVLIB_MAP_WC)) {
+        /* no write combining available, fall back to normal mapping */
+        win->opt = 0;
+        ret = map_window(osd, win);
     }
 
-    if (osd->base[bar]==MAP_FAILED) {
-        osd->base[bar] = NULL;
-        if (osd->rfd[bar]) {
-            close(osd->rfd[bar]);
-            osd->rfd[bar] = -1;
-        }
-        return S_dev_addrMapFail;
+    if (ret) {
+        /* no resource file (eg. UIO only), map the whole BAR */
+        volatile void *base;
+
+        free(win);
+        ret = map_whole(osd, bar, &base, opt);
+        if (!ret)
+            *ppLocalAddr = (volatile char*)base + offset;
+        goto done;
     }
-    return 0;
+
+    win->refs = 1;
+    ellAdd(&osd->windows, &win->node);
+    *ppLocalAddr = win->addr;
+
+done:
+    epicsMutexUnlock(osd->devLock);
+    return ret;
 }
 
+/* Is 'addr' within the mapping of a whole BAR at 'base'? */
 static
 int
-linuxDevPCIToLocalAddr(
+in_whole(const osdPCIDevice *osd, unsigned int bar, volatile void *base, volatile void *addr)
+{
+    volatile char *start = (volatile char*)base + osd->offset[bar];
+
+    return base && (volatile char*)addr>=start && (epicsUInt64)((volatile char*)addr-start)<osd->len[bar];
+}
+
+static
+int
+linuxDevPCIUnmap(
         const epicsPCIDevice* dev,
         unsigned int bar,
-        volatile void **ppLocalAddr,
-        unsigned int opt
+        volatile void *addr
         )
 {
     osdPCIDevice *osd=CONTAINER((epicsPCIDevice*)dev,osdPCIDevice,dev);
+    ELLNODE *cur;
+    int ret = 0;
 
-    if (!osd->base[bar]) {
-        epicsMutexMustLock(osd->devLock);
-        if (!osd->base[bar]) {
-            if (open_res(osd, bar)!=0 || map_bar(osd, bar, opt)!=0) {
-                if (open_uio(osd)!=0 || map_bar(osd, bar, opt)!=0) {
-                    fprintf(stderr, "Can neither mmap resource file nor uio file of PCI device %04x:%02x:%02x.%x BAR %u\n",
-                            osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function, bar);
-                    epicsMutexUnlock(osd->devLock);
-                    return S_dev_addrMapFail;
-                }
+    epicsMutexMustLock(osd->devLock);
+
+    for(cur=ellFirst(&osd->windows); cur; cur=ellNext(cur)) {
+        osdPCIWindow *win = CONTAINER(cur, osdPCIWindow, node);
+        if (win->bar!=bar || win->addr!=addr)
+            continue;
+
+        if (--win->refs==0) {
+            munmap(win->base, win->maplen);
+            ellDelete(&osd->windows, &win->node);
+            free(win);
+        }
+        goto done;
+    }
+
+    if (in_whole(osd, bar, osd->base_wc[bar], addr) && osd->refs_wc[bar]) {
+        if (--osd->refs_wc[bar]==0) {
+            munmap((void*)osd->base_wc[bar], (size_t)(osd->offset[bar]+osd->len[bar]));
+            osd->base_wc[bar] = NULL;
+        }
+
+    } else if (in_whole(osd, bar, osd->base[bar], addr) && osd->refs[bar]) {
+        if (--osd->refs[bar]==0) {
+            munmap((void*)osd->base[bar], (size_t)(osd->offset[bar]+osd->len[bar]));
+            osd->base[bar] = NULL;
+            /* a /dev/uio# descriptor is shared, and kept for interrupts */
+            if (osd->rfd[bar] >= 0) {
+                close(osd->rfd[bar]);
+                osd->rfd[bar] = -1;
             }
-            epicsMutexUnlock(osd->devLock);
         }
+
+    } else {
+        ret = S_dev_badArgument;
     }
-    *ppLocalAddr=((volatile char*)osd->base[bar]) + osd->offset[bar];
 
-    return 0;
+done:
+    epicsMutexUnlock(osd->devLock);
+    return ret;
 }
 
 static
@@ -846,6 +2218,26 @@ linuxDevPCIBarLen(
         )
 {
     osdPCIDevice *osd=CONTAINER(dev,osdPCIDevice,dev);
+    int ret = 0;
+
+    epicsMutexMustLock(osd->devLock);
+    if (osd->len[bar] > 0xffffffffu)
+        ret = S_dev_badArgument;
+    else
+        *len=osd->len[bar];
+    epicsMutexUnlock(osd->devLock);
+    return ret;
+}
+
+static
+int
+linuxDevPCIBarLen64(
+        const epicsPCIDevice* dev,
+        unsigned int bar,
+        epicsUInt64 *len
+        )
+{
+    osdPCIDevice *osd=CONTAINER(dev,osdPCIDevice,dev);
 
     epicsMutexMustLock(osd->devLock);
     *len=osd->len[bar];
@@ -853,6 +2245,20 @@ linuxDevPCIBarLen(
     return 0;
 }
 
+static
+int
+linuxDevPCIResolve(const epicsPCIDevice* dev)
+{
+    osdPCIDevice *osd=CONTAINER((epicsPCIDevice*)dev,osdPCIDevice,dev);
+
+    if (!epicsAtomicGetIntT(&osd->resolved)) {
+        epicsMutexMustLock(osd->devLock);
+        resolve_device(osd);
+        epicsMutexUnlock(osd->devLock);
+    }
+    return 0;
+}
+
 static
 int linuxDevPCIConnectInterrupt(
         const epicsPCIDevice *dev,
@@ -867,18 +2273,15 @@ int linuxDevPCIConnectInterrupt(
     osdISR *other, *isr=calloc(1,sizeof(osdISR));
     int     ret = S_dev_vecInstlFail;
 
-    (void) opt;
     if (!isr) return S_dev_noMemory;
 
     isr->fptr=pFunction;
     isr->param=parameter;
-    isr->osd=osd;
-    isr->waiter_status=osdISRStarting;
-    isr->done=epicsEventMustCreate(epicsEventEmpty);
+    isr->opt=opt;
 
     epicsMutexMustLock(osd->devLock);
 
-    if ( open_uio(osd) ) {
+    if ( osd->removed || open_uio(osd) ) {
         epicsMutexUnlock(osd->devLock);
         ret = S_dev_noDevice;
         goto error;
@@ -894,22 +2297,57 @@ int linuxDevPCIConnectInterrupt(
         }
     }
 
-    epicsSnprintf(name,NELEMENTS(name),"PCIISR%04x:%02x:%02x.%x",dev->domain,dev->bus,dev->device,dev->function);
-    name[NELEMENTS(name)-1]='\0';
+    epicsThreadOnce(&reactor_once, &reactorInit, NULL);
+
+    if (reactor_fd>=0) {
+        if (!osd->armed) {
+            struct epoll_event ev;
+            ev.events = EPOLLIN|EPOLLONESHOT;
+            ev.data.ptr = osd;
+            if (epoll_ctl(reactor_fd, EPOLL_CTL_ADD, osd->fd, &ev)) {
+                epicsMutexUnlock(osd->devLock);
+                fprintf(stderr, "Failed to add PCI device %04x:%02x:%02x.%x to ISR reactor: %s\n",
+                        osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function, strerror(errno));
+                goto error;
+            }
+            osd->armed = 1;
+            osd->next = 0;
+        }
 
-    /* Ensure that "IRQ" thread has higher priority
-     * then all other EPICS threads.
-     */
-    isr->waiter = epicsThreadCreate(name,
-                                    epicsThreadPriorityMax-1,
-                                    epicsThreadGetStackSize(epicsThreadStackMedium),
-                                    isrThread,
-                                    isr
-                                    );
-    if (!isr->waiter) {
-        epicsMutexUnlock(osd->devLock);
-        fprintf(stderr, "Failed to create ISR thread %s\n", name);
-        goto error;
+    } else if (osd->waiter_status==osdWaiterIdle) {
+        /* first ISR of this device starts the waiter */
+
+        if ((osd->wakefd = eventfd(0, 0))<0) {
+            epicsMutexUnlock(osd->devLock);
+            fprintf(stderr, "Failed to create eventfd: %s\n", strerror(errno));
+            goto error;
+        }
+        if (!osd->waiterDone)
+            osd->waiterDone=epicsEventMustCreate(epicsEventEmpty);
+
+        epicsSnprintf(name,NELEMENTS(name),"PCIISR%04x:%02x:%02x.%x",dev->domain,dev->bus,dev->device,dev->function);
+        name[NELEMENTS(name)-1]='\0';
+
+        osd->waiter_status = osdWaiterRunning;
+        osd->next = 0;
+
+        /* Ensure that "IRQ" thread has higher priority
+         * then all other EPICS threads.
+         */
+        osd->waiter = epicsThreadCreate(name,
+                                        epicsThreadPriorityMax-1,
+                                        epicsThreadGetStackSize(epicsThreadStackMedium),
+                                        isrThread,
+                                        osd
+                                        );
+        if (!osd->waiter) {
+            osd->waiter_status = osdWaiterIdle;
+            close(osd->wakefd);
+            osd->wakefd = -1;
+            epicsMutexUnlock(osd->devLock);
+            fprintf(stderr, "Failed to create ISR thread %s\n", name);
+            goto error;
+        }
     }
 
     ellAdd(&osd->isrs,&isr->node);
@@ -917,93 +2355,301 @@ int linuxDevPCIConnectInterrupt(
 
     return 0;
 error:
-    epicsEventDestroy(isr->done);
     free(isr);
     return ret;
 }
 
+/* Call all ISRs of a device for one event.
+ * Caller must take devLock.
+ *
+ * ISRs connected with DEVLIB_ISR_DEVLOCK are called with devLock held.
+ * Others are called with only epicsInterruptLock() held, and
+ * osd->calling tells linuxDevPCIDisconnectInterrupt() to wait for them.
+ */
 static
-void isrThread(void* arg)
+void dispatchISRs(osdPCIDevice *osd, epicsInt32 event)
 {
-    osdISR *isr=arg;
-    osdPCIDevice *osd=isr->osd;
-    int interrupted=0;
-    epicsInt32 event, next=0;
-    const char* name;
+    ELLNODE *cur;
     int isrflag;
 
-    name=epicsThreadGetNameSelf();
-
-    epicsMutexMustLock(osd->devLock);
-
-    if (isr->waiter_status!=osdISRStarting) {
-        isr->waiter_status = osdISRDone;
-        epicsMutexUnlock(osd->devLock);
-        return;
+    if (osd->next!=event && osd->next!=0) {
+        errlogPrintf("PCI ISR %04x:%02x:%02x.%x missed %d events\n",
+                     osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function,
+                     event-osd->next);
     }
+    osd->next=event+1;
 
-    isr->waiter_status = osdISRRunning;
+    for(cur=ellFirst(&osd->isrs); cur; cur=ellNext(cur))
+    {
+        osdISR *isr=CONTAINER(cur,osdISR,node);
 
-    while (isr->waiter_status==osdISRRunning) {
-        int ret;
-        epicsMutexUnlock(osd->devLock);
+        if (isr->opt&DEVLIB_ISR_DEVLOCK) {
+            (isr->fptr)(isr->param);
+
+        } else {
+            osd->calling = isr;
+            epicsMutexUnlock(osd->devLock);
 
-        /* The interrupted flag lets us check
-         * the status flag (taking devLock)
-         * once each iteration
-         */
-        if (interrupted) {
-            interrupted=0;
             isrflag=epicsInterruptLock();
             (isr->fptr)(isr->param);
             epicsInterruptUnlock(isrflag);
+
+            epicsMutexMustLock(osd->devLock);
+            osd->calling = NULL;
+            epicsEventSignal(osd->callDone);
+            /* isr remains in list until osd->calling is cleared */
         }
+    }
+}
 
-        ret=read(osd->fd, &event, sizeof(event));
+static
+void isrThread(void* arg)
+{
+    osdPCIDevice *osd=arg;
+    struct pollfd fds[2];
+    const char* name;
+
+    name=epicsThreadGetNameSelf();
+
+    fds[0].fd = osd->fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = osd->wakefd;
+    fds[1].events = POLLIN;
+
+    epicsMutexMustLock(osd->devLock);
+
+    while (osd->waiter_status==osdWaiterRunning) {
+        int ret, interrupted=0;
+        epicsInt32 event=0;
+        epicsMutexUnlock(osd->devLock);
+
+        ret=poll(fds, 2, -1);
         if (ret==-1) {
-            switch(errno) {
-            case EINTR: /* interrupted by a signal */
-                break;
-            default:
-                errlogPrintf("isrThread '%s' read error %d\n",
+            if (errno!=EINTR) {
+                errlogPrintf("isrThread '%s' poll error %d\n",
                              name,errno);
                 epicsThreadSleep(0.5);
             }
-        } else
-            interrupted=1;
 
-        if (next!=event && next!=0) {
-            errlogPrintf("isrThread '%s' missed %d events\n",
-                         name, event-next);
+        } else {
+            if (fds[1].revents) {
+                epicsUInt64 junk;
+                if (read(osd->wakefd, &junk, sizeof(junk))<0) {}
+            }
+
+            if (fds[0].revents&POLLIN) {
+                ret=read(osd->fd, &event, sizeof(event));
+                if (ret==-1) {
+                    switch(errno) {
+                    case EINTR: /* interrupted by a signal */
+                        break;
+                    default:
+                        errlogPrintf("isrThread '%s' read error %d\n",
+                                     name,errno);
+                        epicsThreadSleep(0.5);
+                    }
+                } else
+                    interrupted=1;
+
+            } else if (fds[0].revents) {
+                errlogPrintf("isrThread '%s' poll error events %x\n",
+                             name,(unsigned)fds[0].revents);
+                epicsThreadSleep(0.5);
+            }
         }
-        next=event+1;
 
         epicsMutexMustLock(osd->devLock);
+
+        if (interrupted && osd->waiter_status==osdWaiterRunning)
+            dispatchISRs(osd, event);
+    }
+
+    osd->waiter_status = osdWaiterDone;
+
+    epicsMutexUnlock(osd->devLock);
+    epicsEventSignal(osd->waiterDone);
+}
+
+/* Read the event count and call all ISRs of a device,
+ * then re-arm.
+ */
+static
+void reactorDispatch(osdPCIDevice *osd)
+{
+    epicsInt32 event;
+    ssize_t ret;
+
+    ret=read(osd->fd, &event, sizeof(event));
+
+    epicsMutexMustLock(osd->devLock);
+
+    if (ret==sizeof(event)) {
+        dispatchISRs(osd, event);
+
+    } else if (ret==-1 && errno!=EINTR && errno!=EAGAIN) {
+        errlogPrintf("PCI ISR %04x:%02x:%02x.%x read error %d\n",
+                     osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function,
+                     errno);
     }
 
-    isr->waiter_status = osdISRDone;
+    if (osd->armed) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN|EPOLLONESHOT;
+        ev.data.ptr = osd;
+        if (epoll_ctl(reactor_fd, EPOLL_CTL_MOD, osd->fd, &ev))
+            errlogPrintf("PCI ISR %04x:%02x:%02x.%x can't re-arm %d\n",
+                         osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function,
+                         errno);
+    }
 
     epicsMutexUnlock(osd->devLock);
-    epicsEventSignal(isr->done);
 }
 
-/* Caller must take devLock */
+static
+void reactorThread(void* arg)
+{
+    /* With a pool, take one event at a time so that idle threads
+     * pick up other devices.
+     */
+    struct epoll_event evts[8];
+    int maxevts = reactor_nthreads>1 ? 1 : NELEMENTS(evts);
+    int stop = 0;
+    (void)arg;
+
+    while (!stop) {
+        int i, n;
+
+        n=epoll_wait(reactor_fd, evts, maxevts, -1);
+        if (n==-1) {
+            if (errno==EINTR)
+                continue;
+            errlogPrintf("PCI ISR reactor epoll error %d\n", errno);
+            epicsThreadSleep(0.5);
+            continue;
+        }
+
+        for(i=0; i<n; i++) {
+            if (evts[i].data.ptr)
+                reactorDispatch(evts[i].data.ptr);
+            else
+                stop = 1;
+        }
+    }
+
+    epicsAtomicDecrIntT(&reactor_running);
+    epicsEventSignal(reactor_done);
+}
+
+static
+void reactorInit(void* junk)
+{
+    unsigned i;
+    (void)junk;
+
+    if (devPCIISRThreads<=0)
+        return;
+
+    reactor_fd = epoll_create(1);
+    if (reactor_fd<0) {
+        fprintf(stderr, "Failed to create ISR reactor, using one thread per device: %s\n", strerror(errno));
+        return;
+    }
+    fcntl(reactor_fd, F_SETFD, FD_CLOEXEC);
+
+    {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL;
+        if ((reactor_stopfd = eventfd(0, EFD_CLOEXEC))<0
+                || epoll_ctl(reactor_fd, EPOLL_CTL_ADD, reactor_stopfd, &ev))
+        {
+            fprintf(stderr, "Failed to create ISR reactor, using one thread per device: %s\n", strerror(errno));
+            if (reactor_stopfd>=0)
+                close(reactor_stopfd);
+            reactor_stopfd = -1;
+            close(reactor_fd);
+            reactor_fd = -1;
+            return;
+        }
+    }
+    reactor_done = epicsEventMustCreate(epicsEventEmpty);
+
+    reactor_nthreads = devPCIISRThreads;
+
+    for(i=0; i<reactor_nthreads; i++) {
+        char name[20];
+        epicsSnprintf(name,NELEMENTS(name),"PCIISR%u",i);
+        name[NELEMENTS(name)-1]='\0';
+
+        /* Same priority as one thread per device */
+        epicsAtomicIncrIntT(&reactor_running);
+        if (!epicsThreadCreate(name,
+                               epicsThreadPriorityMax-1,
+                               epicsThreadGetStackSize(epicsThreadStackMedium),
+                               reactorThread,
+                               NULL))
+        {
+            epicsAtomicDecrIntT(&reactor_running);
+            fprintf(stderr, "Failed to create ISR thread %s\n", name);
+        }
+    }
+}
+
+/* Wake all reactor threads, and wait until each has exited.
+ * Afterwards no thread will dispatch to any device.
+ */
+static
+void reactorStop(void)
+{
+    epicsUInt64 one = 1;
+
+    if (reactor_fd<0)
+        return;
+
+    if (write(reactor_stopfd, &one, sizeof(one))<0) {}
+
+    while (epicsAtomicGetIntT(&reactor_running)>0)
+        epicsEventWait(reactor_done);
+
+    close(reactor_stopfd);
+    reactor_stopfd = -1;
+    close(reactor_fd);
+    reactor_fd = -1;
+}
+
+/* Stop waiting for interrupts from this device.
+ * Caller must take devLock
+ */
 static
 void
-stopIsrThread(osdISR *isr)
+stopIsrThread(osdPCIDevice *osd)
 {
-    if (isr->waiter_status==osdISRDone)
+    if (osd->armed) {
+        (void)epoll_ctl(reactor_fd, EPOLL_CTL_DEL, osd->fd, NULL);
+        osd->armed = 0;
+    }
+
+    if (osd->waiter_status==osdWaiterIdle)
         return;
 
-    isr->waiter_status = osdISRStopping;
+    if (osd->waiter_status==osdWaiterRunning) {
+        epicsUInt64 one = 1;
+        osd->waiter_status = osdWaiterStopping;
+        if (write(osd->wakefd, &one, sizeof(one))<0) {}
+    }
 
-    while (isr->waiter_status!=osdISRDone) {
-        epicsMutexUnlock(isr->osd->devLock);
+    while (osd->waiter_status!=osdWaiterDone) {
+        epicsMutexUnlock(osd->devLock);
 
-        epicsEventWait(isr->done);
+        epicsEventWait(osd->waiterDone);
 
-        epicsMutexMustLock(isr->osd->devLock);
+        epicsMutexMustLock(osd->devLock);
     }
+
+    close(osd->wakefd);
+    osd->wakefd = -1;
+    osd->waiter = NULL;
+    osd->waiter_status = osdWaiterIdle;
 }
 
 static
@@ -1025,12 +2671,21 @@ int linuxDevPCIDisconnectInterrupt(
 
         if (pFunction==isr->fptr && parameter==isr->param) {
 
-            stopIsrThread(isr);
+            /* wait for a call in progress */
+            while (osd->calling==isr) {
+                epicsMutexUnlock(osd->devLock);
+                epicsEventWait(osd->callDone);
+                epicsMutexMustLock(osd->devLock);
+                /* pass on to any other waiting disconnect */
+                epicsEventSignal(osd->callDone);
+            }
 
             ellDelete(&osd->isrs,cur);
-            epicsEventDestroy(isr->done);
             free(isr);
 
+            if (ellCount(&osd->isrs)==0)
+                stopIsrThread(osd);
+
             ret=0;
             break;
         }
@@ -1040,28 +2695,24 @@ int linuxDevPCIDisconnectInterrupt(
     return ret;
 }
 
+/* Open the config file if not already open.
+ * Caller must take devLock
+ */
 static int
-linuxDevPCIConfigAccess(const epicsPCIDevice *dev, unsigned offset, void *pArg, devPCIAccessMode mode)
+open_config(osdPCIDevice *osd)
 {
-    int           rval    = S_dev_internal;
-    char         *scratch = 0;
-    osdPCIDevice *osd     = CONTAINER((epicsPCIDevice*)dev,osdPCIDevice,dev);
-    ssize_t       st;
-    int           cmode;
-
-    epicsMutexMustLock(osd->devLock);
+    int   rval    = 0;
+    char *scratch = 0;
 
     if ( CMODE_NONE == osd->cmode ) {
         /* have already tried to open */
-        rval = S_dev_badRequest;
-        goto bail;
+        return S_dev_badRequest;
     }
 
     if ( -1 == osd->cfd ) {
         if ( ! (scratch = allocPrintf(BUSBASE"config",
-                                      osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function)) ) {
-            rval = S_dev_noMemory;
-            goto bail;
+                                      pciroot, osd->dev.domain, osd->dev.bus, osd->dev.device, osd->dev.function)) ) {
+            return S_dev_noMemory;
         }
         if ( (osd->cfd = open(scratch, O_RDWR, 0)) < 0 ) {
             fprintf(stderr, "devLibPCIOSD: Unable to open configuration space for writing: %s\n", strerror(errno));
@@ -1070,14 +2721,31 @@ linuxDevPCIConfigAccess(const epicsPCIDevice *dev, unsigned offset, void *pArg,
                 fprintf(stderr, "devLibPCIOSD: Unable to open configuration space for read-only: %s\n", strerror(errno));
                 rval = S_dev_badRequest;
                 osd->cmode = CMODE_NONE;
-                goto bail;
+            } else {
+                osd->cmode = CMODE_RONL;
             }
-            osd->cmode = CMODE_RONL;
         } else {
             osd->cmode = CMODE_RDWR;
         }
     }
 
+    free(scratch);
+    return rval;
+}
+
+static int
+linuxDevPCIConfigAccess(const epicsPCIDevice *dev, unsigned offset, void *pArg, devPCIAccessMode mode)
+{
+    int           rval    = S_dev_internal;
+    osdPCIDevice *osd     = CONTAINER((epicsPCIDevice*)dev,osdPCIDevice,dev);
+    ssize_t       st;
+    int           cmode;
+
+    epicsMutexMustLock(osd->devLock);
+
+    if ( (rval = open_config(osd)) )
+        goto bail;
+
     cmode = (CFG_ACC_WRITE(mode) ? CMODE_WRTE : CMODE_READ);
 
     if ( ! (osd->cmode & cmode) ) {
@@ -1106,7 +2774,31 @@ linuxDevPCIConfigAccess(const epicsPCIDevice *dev, unsigned offset, void *pArg,
     rval = 0;
 
 bail:
-    free(scratch);
+    epicsMutexUnlock(osd->devLock);
+
+    return rval;
+}
+
+static int
+linuxDevPCIConfigReadBlock(const epicsPCIDevice *dev, unsigned offset, void *buf, unsigned len)
+{
+    int           rval;
+    osdPCIDevice *osd     = CONTAINER((epicsPCIDevice*)dev,osdPCIDevice,dev);
+    ssize_t       st;
+
+    epicsMutexMustLock(osd->devLock);
+
+    if ( !(rval = open_config(osd)) ) {
+        st = pread( osd->cfd, buf, len, offset );
+
+        if ( (ssize_t)len != st ) {
+            /* without CAP_SYS_ADMIN, only the first 64 bytes are readable */
+            if ( st < 0 )
+                fprintf(stderr, "devLibPCIOSD: Unable to read %u bytes from configuration space: %s\n",
+                        len, strerror(errno));
+            rval = S_dev_internal;
+        }
+    }
 
     epicsMutexUnlock(osd->devLock);
 
@@ -1140,6 +2832,12 @@ devLibPCI plinuxPCI = {
     .pDevPCIDisconnectInterrupt = linuxDevPCIDisconnectInterrupt,
     .pDevPCIConfigAccess = linuxDevPCIConfigAccess,
     .pDevPCISwitchInterrupt = linuxDevPCISwitchInterrupt,
+    .pDevPCIResolve = linuxDevPCIResolve,
+    .pDevPCIRescan = linuxDevPCIRescan,
+    .pDevPCIConfigReadBlock = linuxDevPCIConfigReadBlock,
+    .pDevPCIBarLen64 = linuxDevPCIBarLen64,
+    .pDevPCIMapWindow = linuxDevPCIMapWindow,
+    .pDevPCIUnmap = linuxDevPCIUnmap,
 };
 #include <epicsExport.h>
 
@@ -0,0 +1,618 @@
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+
+#include <epicsStdio.h>
+#include <errlog.h>
+#include <epicsString.h>
+#include <epicsThread.h>
+#include <epicsMutex.h>
+#include <iocsh.h>
+
+#include "devLibPCIImpl.h"
+
+/**@file devLibPCISim.c
+ * @brief Simulated PCI bus
+ *
+ * devLibPCI implementation "sim", selected with devLibPCIUse("sim"),
+ * which presents the devices listed in description files loaded with
+ * devLibPCISimLoad().
+ *
+ * Each BAR is backed by shared memory (memfd).
+ * Each device has an eventfd, and an interrupt is injected by
+ * writing to it, see devLibPCISimInterrupt().
+ *
+ * Note on locking: When taking both simLock and a device lock
+ *                  always take simLock first.
+ */
+
+#ifndef CONTAINER
+# ifdef __GNUC__
+#   define CONTAINER(ptr, structure, member) ({                     \
+    const __typeof(((structure*)0)->member) *_ptr = (ptr);      \
+    (structure*)((char*)_ptr - offsetof(structure, member));    \
+    })
+# else
+#   define CONTAINER(ptr, structure, member) \
+    ((structure*)((char*)(ptr) - offsetof(structure, member)))
+# endif
+#endif
+
+#define SIMCFGSIZE 4096
+
+typedef struct {
+    ELLNODE node;
+    void (*fptr)(void*);
+    void  *param;
+} simISR;
+
+/**@brief Info of a single simulated PCI device
+ *
+ * Lifetime: Created by devLibPCISimLoad() and never free'd
+ */
+typedef struct {
+    epicsPCIDevice dev; /* "public" data */
+
+    epicsUInt32    len[PCIBARCOUNT];
+    int            memfd[PCIBARCOUNT];
+    volatile void *base[PCIBARCOUNT];
+
+    /* little endian, as on the bus */
+    epicsUInt8 cfg[SIMCFGSIZE];
+
+    int efd; /* eventfd for interrupt injection */
+    int irqoff; /* interrupt disabled by devPCIDisableInterrupt() */
+    epicsUInt64 pending; /* events received while disabled */
+    epicsThreadId isrthread;
+
+    epicsMutexId devLock; /* guard access to isrs list and irq state */
+
+    ELLNODE node;
+
+    ELLLIST isrs; /* contains simISR */
+} simPCIDevice;
+
+static ELLLIST simdevices = ELLLIST_INIT;
+
+static epicsMutexId simLock;
+
+static epicsThreadOnceId simOnce = EPICS_THREAD_ONCE_INIT;
+
+static
+void simInitOnce(void *junk)
+{
+    (void)junk;
+    simLock = epicsMutexMustCreate();
+}
+
+/* Shared memory backing a BAR.  Prefer memfd, else an unlinked temporary file */
+static
+int sim_shm(const char *name, epicsUInt32 len)
+{
+    int fd = -1;
+#ifdef SYS_memfd_create
+    fd = syscall(SYS_memfd_create, name, 0);
+#endif
+    if(fd<0) {
+        char tmpl[] = "/tmp/devlibpcisimXXXXXX";
+        if((fd = mkstemp(tmpl))<0)
+            return -1;
+        unlink(tmpl);
+    }
+    if(ftruncate(fd, len)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static
+void cfg_put16(simPCIDevice *sim, unsigned offset, epicsUInt16 val)
+{
+    sim->cfg[offset]   = val;
+    sim->cfg[offset+1] = val>>8;
+}
+
+static
+void cfg_put32(simPCIDevice *sim, unsigned offset, epicsUInt32 val)
+{
+    cfg_put16(sim, offset, val);
+    cfg_put16(sim, offset+2, val>>16);
+}
+
+/* Fill in a type 0 configuration header from the device description */
+static
+void sim_fill_cfg(simPCIDevice *sim)
+{
+    unsigned i;
+    epicsUInt32 addr = 0x80000000u;
+
+    cfg_put16(sim, 0x00, sim->dev.id.vendor);
+    cfg_put16(sim, 0x02, sim->dev.id.device);
+    cfg_put16(sim, 0x04, 0x0006); /* memory space and bus master enabled */
+    sim->cfg[0x08] = sim->dev.id.revision;
+    sim->cfg[0x09] = sim->dev.id.pci_class;
+    sim->cfg[0x0a] = sim->dev.id.pci_class>>8;
+    sim->cfg[0x0b] = sim->dev.id.pci_class>>16;
+
+    for(i=0; i<PCIBARCOUNT; i++) {
+        if(!sim->len[i])
+            continue;
+        cfg_put32(sim, 0x10+4*i, addr);
+        addr += sim->len[i];
+    }
+
+    cfg_put16(sim, 0x2c, sim->dev.id.sub_vendor);
+    cfg_put16(sim, 0x2e, sim->dev.id.sub_device);
+    sim->cfg[0x3c] = sim->dev.irq;
+    sim->cfg[0x3d] = 1; /* INTA */
+}
+
+static
+int sim_parse_line(char *line, const char *fname, unsigned lineno)
+{
+    simPCIDevice *sim;
+    char *save = NULL, *tok;
+    char *slot = NULL; /* owned by sim->dev once added */
+    unsigned i;
+
+    tok = strtok_r(line, " \t\r\n", &save);
+    if(!tok)
+        return 0; /* blank line */
+
+    sim = calloc(1, sizeof(*sim));
+    if(!sim)
+        return S_dev_noMemory;
+
+    sim->efd = -1;
+    for(i=0; i<PCIBARCOUNT; i++)
+        sim->memfd[i] = -1;
+    sim->dev.slot = DEVPCI_NO_SLOT;
+    sim->dev.driver = "sim";
+
+    if(sscanf(tok, "%x:%x:%x.%x", &sim->dev.domain, &sim->dev.bus,
+              &sim->dev.device, &sim->dev.function)!=4)
+    {
+        sim->dev.domain = 0;
+        if(sscanf(tok, "%x:%x.%x", &sim->dev.bus,
+                  &sim->dev.device, &sim->dev.function)!=3)
+        {
+            fprintf(stderr, "%s:%u: Expected [dom:]B:D.F not '%s'\n", fname, lineno, tok);
+            free(sim);
+            return S_dev_badArgument;
+        }
+    }
+
+    while((tok = strtok_r(NULL, " \t\r\n", &save))!=NULL) {
+        char *val = strchr(tok, '=');
+        unsigned long ival;
+
+        if(!val) {
+            fprintf(stderr, "%s:%u: Expected key=value not '%s'\n", fname, lineno, tok);
+            free(slot);
+            free(sim);
+            return S_dev_badArgument;
+        }
+        *val++ = '\0';
+        ival = strtoul(val, NULL, 0);
+
+        if(strcmp(tok, "vendor")==0) {
+            sim->dev.id.vendor = ival;
+        } else if(strcmp(tok, "device")==0) {
+            sim->dev.id.device = ival;
+        } else if(strcmp(tok, "subvendor")==0) {
+            sim->dev.id.sub_vendor = ival;
+        } else if(strcmp(tok, "subdevice")==0) {
+            sim->dev.id.sub_device = ival;
+        } else if(strcmp(tok, "class")==0) {
+            sim->dev.id.pci_class = ival;
+        } else if(strcmp(tok, "revision")==0) {
+            sim->dev.id.revision = ival;
+        } else if(strcmp(tok, "irq")==0) {
+            sim->dev.irq = ival;
+        } else if(strcmp(tok, "slot")==0) {
+            free(slot);
+            slot = epicsStrDup(val);
+        } else if(strncmp(tok, "bar", 3)==0 && isdigit((unsigned char)tok[3]) && !tok[4]
+                  && (unsigned)(tok[3]-'0')<PCIBARCOUNT) {
+            sim->len[tok[3]-'0'] = ival;
+        } else {
+            fprintf(stderr, "%s:%u: Unknown key '%s'\n", fname, lineno, tok);
+            free(slot);
+            free(sim);
+            return S_dev_badArgument;
+        }
+    }
+
+    for(i=0; i<PCIBARCOUNT; i++) {
+        char name[32];
+        void *base;
+
+        if(!sim->len[i])
+            continue;
+
+        epicsSnprintf(name, sizeof(name), "pcisim%x:%x.%x-%u",
+                      sim->dev.bus, sim->dev.device, sim->dev.function, i);
+        name[sizeof(name)-1] = '\0';
+
+        if((sim->memfd[i] = sim_shm(name, sim->len[i]))<0) {
+            fprintf(stderr, "%s:%u: Failed to allocate BAR %u: %s\n", fname, lineno, i, strerror(errno));
+            goto fail;
+        }
+        base = mmap(NULL, sim->len[i], PROT_READ|PROT_WRITE, MAP_SHARED, sim->memfd[i], 0);
+        if(base==MAP_FAILED) {
+            fprintf(stderr, "%s:%u: Failed to map BAR %u: %s\n", fname, lineno, i, strerror(errno));
+            goto fail;
+        }
+        sim->base[i] = base;
+    }
+
+    if((sim->efd = eventfd(0, EFD_CLOEXEC))<0) {
+        fprintf(stderr, "%s:%u: Failed to create eventfd: %s\n", fname, lineno, strerror(errno));
+        goto fail;
+    }
+
+    sim_fill_cfg(sim);
+
+    sim->devLock = epicsMutexMustCreate();
+    if(slot)
+        sim->dev.slot = slot;
+
+    if(devPCIDebug>=1)
+        fprintf(stderr, "pcisim add %04x:%02x:%02x.%x %04x:%04x\n",
+                sim->dev.domain, sim->dev.bus, sim->dev.device, sim->dev.function,
+                sim->dev.id.vendor, sim->dev.id.device);
+
+    epicsMutexMustLock(simLock);
+    ellAdd(&simdevices, &sim->node);
+    epicsMutexUnlock(simLock);
+
+    devLibPCIInvalidateIndex();
+    return 0;
+fail:
+    for(i=0; i<PCIBARCOUNT; i++) {
+        if(sim->base[i])
+            munmap((void*)sim->base[i], sim->len[i]);
+        if(sim->memfd[i]>=0)
+            close(sim->memfd[i]);
+    }
+    if(sim->efd>=0)
+        close(sim->efd);
+    free(slot);
+    free(sim);
+    return S_dev_noMemory;
+}
+
+int devLibPCISimLoad(const char *fname)
+{
+    FILE *fp;
+    char line[256];
+    unsigned lineno = 0;
+    int ret = 0;
+
+    epicsThreadOnce(&simOnce, &simInitOnce, NULL);
+
+    if(!fname) {
+        fprintf(stderr, "devLibPCISimLoad: file name required\n");
+        return S_dev_badArgument;
+    }
+
+    if(!(fp = fopen(fname, "r"))) {
+        fprintf(stderr, "devLibPCISimLoad: Unable to open %s: %s\n", fname, strerror(errno));
+        return S_dev_badArgument;
+    }
+
+    while(!ret && fgets(line, sizeof(line), fp)) {
+        char *comment = strchr(line, '#');
+        lineno++;
+        if(comment)
+            *comment = '\0';
+        ret = sim_parse_line(line, fname, lineno);
+    }
+
+    fclose(fp);
+    return ret;
+}
+
+static
+void simISRThread(void *arg)
+{
+    simPCIDevice *sim = arg;
+
+    while(1) {
+        epicsUInt64 count;
+        ELLNODE *cur;
+
+        if(read(sim->efd, &count, sizeof(count))!=sizeof(count)) {
+            if(errno==EINTR)
+                continue;
+            fprintf(stderr, "pcisim %x:%x.%x interrupt thread error: %s\n",
+                    sim->dev.bus, sim->dev.device, sim->dev.function, strerror(errno));
+            break;
+        }
+
+        epicsMutexMustLock(sim->devLock);
+        if(sim->irqoff) {
+            sim->pending += count;
+        } else {
+            for(cur=ellFirst(&sim->isrs); cur; cur=ellNext(cur)) {
+                simISR *isr = CONTAINER(cur, simISR, node);
+                (*isr->fptr)(isr->param);
+            }
+        }
+        epicsMutexUnlock(sim->devLock);
+    }
+}
+
+int devLibPCISimInterrupt(const epicsPCIDevice *dev)
+{
+    simPCIDevice *sim = CONTAINER((epicsPCIDevice*)dev, simPCIDevice, dev);
+    epicsUInt64 one = 1;
+
+    if(write(sim->efd, &one, sizeof(one))!=sizeof(one))
+        return S_dev_internal;
+    return 0;
+}
+
+int devLibPCISimEventFD(const epicsPCIDevice *dev)
+{
+    simPCIDevice *sim = CONTAINER((epicsPCIDevice*)dev, simPCIDevice, dev);
+    return sim->efd;
+}
+
+static
+int simDevPCIInit(void)
+{
+    epicsThreadOnce(&simOnce, &simInitOnce, NULL);
+    return 0;
+}
+
+static
+int simDevPCIFind(const epicsPCIID *idlist, devPCISearchFn searchfn, void *arg, unsigned int opt)
+{
+    int err=0, ret=0;
+    ELLNODE *cur;
+    const epicsPCIID *search;
+
+    (void)opt;
+    if(!searchfn || !idlist)
+        return S_dev_badArgument;
+
+    epicsMutexMustLock(simLock);
+
+    for(cur=ellFirst(&simdevices); cur; cur=ellNext(cur)) {
+        simPCIDevice *sim = CONTAINER(cur, simPCIDevice, node);
+
+        for(search=idlist; search->device!=DEVPCI_LAST_DEVICE; search++) {
+
+            if(!devLibPCIMatch(search, &sim->dev.id))
+                continue;
+
+            err=searchfn(arg,&sim->dev);
+            if(err==0) /* Continue search */
+                continue;
+            else if(err==1) /* Abort search OK */
+                ret=0;
+            else /* Abort search Err */
+                ret=err;
+            goto done;
+        }
+    }
+
+done:
+    epicsMutexUnlock(simLock);
+    return ret;
+}
+
+static
+int simDevPCIToLocalAddr(const epicsPCIDevice* dev, unsigned int bar, volatile void **ppLocalAddr, unsigned int opt)
+{
+    simPCIDevice *sim = CONTAINER((epicsPCIDevice*)dev, simPCIDevice, dev);
+
+    (void)opt;
+    if(!sim->base[bar])
+        return S_dev_addrMapFail;
+    *ppLocalAddr = sim->base[bar];
+    return 0;
+}
+
+static
+int simDevPCIBarLen(const epicsPCIDevice* dev, unsigned int bar, epicsUInt32 *len)
+{
+    simPCIDevice *sim = CONTAINER((epicsPCIDevice*)dev, simPCIDevice, dev);
+
+    *len = sim->len[bar];
+    return 0;
+}
+
+static
+int simDevPCIConnectInterrupt(const epicsPCIDevice *dev, void (*pFunction)(void *), void *parameter, unsigned int opt)
+{
+    simPCIDevice *sim = CONTAINER((epicsPCIDevice*)dev, simPCIDevice, dev);
+    simISR *isr;
+    ELLNODE *cur;
+    int ret = 0;
+
+    (void)opt;
+
+    epicsMutexMustLock(sim->devLock);
+
+    for(cur=ellFirst(&sim->isrs); cur; cur=ellNext(cur)) {
+        isr = CONTAINER(cur, simISR, node);
+        if(isr->fptr==pFunction && isr->param==parameter) {
+            fprintf(stderr, "ISR already registered\n");
+            ret = S_dev_vecInstlFail;
+            goto done;
+        }
+    }
+
+    if(!sim->isrthread) {
+        char name[20];
+        epicsSnprintf(name, NELEMENTS(name), "PCISIM%02x:%02x.%x", dev->bus, dev->device, dev->function);
+        name[NELEMENTS(name)-1] = '\0';
+
+        sim->isrthread = epicsThreadCreate(name,
+                                           epicsThreadPriorityMax-1,
+                                           epicsThreadGetStackSize(epicsThreadStackMedium),
+                                           simISRThread, sim);
+        if(!sim->isrthread) {
+            fprintf(stderr, "Failed to create ISR thread %s\n", name);
+            ret = S_dev_vecInstlFail;
+            goto done;
+        }
+    }
+
+    if(!(isr = calloc(1, sizeof(*isr)))) {
+        ret = S_dev_noMemory;
+        goto done;
+    }
+    isr->fptr = pFunction;
+    isr->param = parameter;
+    ellAdd(&sim->isrs, &isr->node);
+
+done:
+    epicsMutexUnlock(sim->devLock);
+    return ret;
+}
+
+static
+int simDevPCIDisconnectInterrupt(const epicsPCIDevice *dev, void (*pFunction)(void *), void *parameter)
+{
+    simPCIDevice *sim = CONTAINER((epicsPCIDevice*)dev, simPCIDevice, dev);
+    ELLNODE *cur;
+    int ret = S_dev_intDisconnect;
+
+    epicsMutexMustLock(sim->devLock);
+
+    for(cur=ellFirst(&sim->isrs); cur; cur=ellNext(cur)) {
+        simISR *isr = CONTAINER(cur, simISR, node);
+        if(isr->fptr==pFunction && isr->param==parameter) {
+            ellDelete(&sim->isrs, cur);
+            free(isr);
+            ret = 0;
+            break;
+        }
+    }
+
+    epicsMutexUnlock(sim->devLock);
+    return ret;
+}
+
+static
+int simDevPCIConfigAccess(const epicsPCIDevice *dev, unsigned offset, void *pArg, devPCIAccessMode mode)
+{
+    simPCIDevice *sim = CONTAINER((epicsPCIDevice*)dev, simPCIDevice, dev);
+
+    if(offset+CFG_ACC_WIDTH(mode)>SIMCFGSIZE)
+        return S_dev_badArgument;
+
+    epicsMutexMustLock(sim->devLock);
+    if(CFG_ACC_WRITE(mode))
+        memcpy(&sim->cfg[offset], pArg, CFG_ACC_WIDTH(mode));
+    else
+        memcpy(pArg, &sim->cfg[offset], CFG_ACC_WIDTH(mode));
+    epicsMutexUnlock(sim->devLock);
+    return 0;
+}
+
+static
+int simDevPCIConfigReadBlock(const epicsPCIDevice *dev, unsigned offset, void *buf, unsigned len)
+{
+    simPCIDevice *sim = CONTAINER((epicsPCIDevice*)dev, simPCIDevice, dev);
+
+    if(offset+len>SIMCFGSIZE)
+        return S_dev_badArgument;
+
+    epicsMutexMustLock(sim->devLock);
+    memcpy(buf, &sim->cfg[offset], len);
+    epicsMutexUnlock(sim->devLock);
+    return 0;
+}
+
+static
+int simDevPCISwitchInterrupt(const epicsPCIDevice *dev, int level)
+{
+    simPCIDevice *sim = CONTAINER((epicsPCIDevice*)dev, simPCIDevice, dev);
+    epicsUInt64 pending;
+
+    epicsMutexMustLock(sim->devLock);
+    sim->irqoff = !!level;
+    pending = sim->irqoff ? 0 : sim->pending;
+    sim->pending = 0;
+    epicsMutexUnlock(sim->devLock);
+
+    /* re-deliver events which arrived while disabled */
+    if(pending && write(sim->efd, &pending, sizeof(pending))!=sizeof(pending))
+        return S_dev_internal;
+    return 0;
+}
+
+static
+devLibPCI psimPCI = {
+    "sim",
+    simDevPCIInit,
+    NULL,
+    simDevPCIFind,
+    simDevPCIToLocalAddr,
+    simDevPCIBarLen,
+    simDevPCIConnectInterrupt,
+    simDevPCIDisconnectInterrupt,
+    simDevPCIConfigAccess,
+    simDevPCISwitchInterrupt,
+    NULL,
+    NULL,
+    simDevPCIConfigReadBlock,
+};
+
+static const iocshArg devLibPCISimLoadArg0 = { "description file",iocshArgString};
+static const iocshArg * const devLibPCISimLoadArgs[1] =
+{&devLibPCISimLoadArg0};
+static const iocshFuncDef devLibPCISimLoadFuncDef =
+{"devLibPCISimLoad",1,devLibPCISimLoadArgs};
+static void devLibPCISimLoadCallFunc(const iocshArgBuf *args)
+{
+    devLibPCISimLoad(args[0].sval);
+}
+
+static const iocshArg devLibPCISimInterruptArg0 = { "PCI device spec",iocshArgString};
+static const iocshArg * const devLibPCISimInterruptArgs[1] =
+{&devLibPCISimInterruptArg0};
+static const iocshFuncDef devLibPCISimInterruptFuncDef =
+{"devLibPCISimInterrupt",1,devLibPCISimInterruptArgs};
+static void devLibPCISimInterruptCallFunc(const iocshArgBuf *args)
+{
+    static const epicsPCIID anypci[] = {
+        DEVPCI_DEVICE_VENDOR(DEVPCI_ANY_DEVICE, DEVPCI_ANY_VENDOR),
+        DEVPCI_END
+    };
+    const epicsPCIDevice *dev = NULL;
+
+    if(strcmp(devLibPCIDriverName() ? devLibPCIDriverName() : "", "sim")!=0) {
+        fprintf(stderr, "PCI bus driver \"sim\" not selected\n");
+    } else if(devPCIFindSpec(anypci, args[0].sval, &dev, 0)) {
+        fprintf(stderr, "No such PCI device\n");
+    } else {
+        devLibPCISimInterrupt(dev);
+    }
+}
+
+#include <epicsExport.h>
+
+void devLibPCIRegisterSim(void)
+{
+    epicsThreadOnce(&simOnce, &simInitOnce, NULL);
+    devLibPCIRegisterDriver(&psimPCI);
+    iocshRegister(&devLibPCISimLoadFuncDef,devLibPCISimLoadCallFunc);
+    iocshRegister(&devLibPCISimInterruptFuncDef,devLibPCISimInterruptCallFunc);
+}
+epicsExportRegistrar(devLibPCIRegisterSim);
@@ -143,6 +143,12 @@ devLibPCI prtemsPCI = {
     rtemsDevPCIDisconnectInterrupt,
     rtemsDevPCIConfigAccess,
     NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
     {NULL,NULL}
 };
 
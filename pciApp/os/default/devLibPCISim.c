@@ -0,0 +1,29 @@
+
+#include <epicsExport.h>
+#include "devLibPCIImpl.h"
+
+/* The simulated PCI bus is only implemented for Linux.
+ * Only exists so that this registrar will be present for all targets
+ */
+void devLibPCIRegisterSim(void)
+{
+}
+epicsExportRegistrar(devLibPCIRegisterSim);
+
+int devLibPCISimLoad(const char *fname)
+{
+    (void)fname;
+    return S_dev_noDevice;
+}
+
+int devLibPCISimInterrupt(const epicsPCIDevice *dev)
+{
+    (void)dev;
+    return S_dev_noDevice;
+}
+
+int devLibPCISimEventFD(const epicsPCIDevice *dev)
+{
+    (void)dev;
+    return -1;
+}
@@ -19,6 +19,7 @@
 #include <iocsh.h>
 #include <epicsMMIO.h>
 #include <devLibPCI.h>
+#include <devLibMMIO.h>
 
 static const epicsPCIDevice *diagdev;
 static volatile void *diagbase;
@@ -142,10 +143,15 @@ void pciwrite(int dmod, int offset, int value)
 
 void pciread(int dmod, int offset, int count)
 {
-    epicsUInt32 tval;
+    /* one line of output */
+    union {
+        epicsUInt8  u8[16];
+        epicsUInt16 u16[8];
+        epicsUInt32 u32[4];
+    } line;
     volatile char* dptr;
     short dbytes;
-    int i;
+    int i, j, n;
 
     if(!diagbase) {
         fprintf(stderr, "Run pcidiagset first\n");
@@ -160,16 +166,25 @@ void pciread(int dmod, int offset, int count)
     count/=dbytes;
     if(count==0) count=1;
 
-    for(i=0, dptr=offset+(volatile char*)diagbase; i<count; i++, dptr+=dbytes) {
-        if ((i*dbytes)%16==0)
-            printf("\n0x%08x ",i*dbytes);
-        else if ((i*dbytes)%4==0)
-            printf(" ");
+    for(i=0, dptr=offset+(volatile char*)diagbase; i<count; i+=n, dptr+=n*dbytes) {
+        n = count-i < 16/dbytes ? count-i : 16/dbytes;
 
         switch(dmod){
-        case 8:  tval=ioread8(dptr); printf("%02x",tval);break;
-        case 16: tval=nat_ioread16(dptr);printf("%04x",tval);break;
-        case 32: tval=nat_ioread32(dptr);printf("%08x",tval);break;
+        case 8:  ioread8_block(dptr, line.u8, n); break;
+        case 16: nat_ioread16_block(dptr, line.u16, n); break;
+        case 32: nat_ioread32_block(dptr, line.u32, n); break;
+        }
+
+        printf("\n0x%08x ",i*dbytes);
+        for(j=0; j<n; j++) {
+            if (j && (j*dbytes)%4==0)
+                printf(" ");
+
+            switch(dmod){
+            case 8:  printf("%02x",line.u8[j]);break;
+            case 16: printf("%04x",line.u16[j]);break;
+            case 32: printf("%08x",(unsigned)line.u32[j]);break;
+            }
         }
     }
     printf("\n");
@@ -0,0 +1,304 @@
+/*************************************************************************\
+* devLib2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+#include <string.h>
+
+#include "epicsEndian.h"
+#include "epicsTypes.h"
+#include "epicsUnitTest.h"
+#include "testMain.h"
+
+#include "epicsMMIO.h"
+#include "devLibMMIO.h"
+
+/* more than the internal chunk size, and not a multiple of any vector width */
+#define N 101
+
+/* aligned for four byte access */
+static union {
+    epicsUInt64 align;
+    epicsUInt8 bytes[4*N+8];
+} memu;
+#define mem memu.bytes
+
+/* bytes 0, 1, 2, ... */
+static void fillmem(void)
+{
+    size_t i;
+    for(i=0; i<sizeof(mem); i++)
+        mem[i] = (epicsUInt8)i;
+}
+
+static void testSwap(void)
+{
+    epicsUInt16 b16[N];
+    epicsUInt32 b32[N];
+    size_t count, i;
+    int ok16 = 1, ok32 = 1;
+
+    testDiag("bswap*_array() of all lengths up to %u", (unsigned)N);
+
+    for(count=0; count<=N; count++) {
+        for(i=0; i<N; i++) {
+            b16[i] = (epicsUInt16)(0x0102u*i + 0x1122u);
+            b32[i] = 0x01020304u*(epicsUInt32)i + 0x11223344u;
+        }
+        bswap16_array(b16, count);
+        bswap32_array(b32, count);
+        for(i=0; i<N; i++) {
+            epicsUInt16 e16 = (epicsUInt16)(0x0102u*i + 0x1122u);
+            epicsUInt32 e32 = 0x01020304u*(epicsUInt32)i + 0x11223344u;
+            if(i<count) {
+                e16 = bswap16(e16);
+                e32 = bswap32(e32);
+            }
+            if(b16[i]!=e16) {
+                testDiag("bswap16_array count=%u [%u] %04x != %04x", (unsigned)count, (unsigned)i, b16[i], e16);
+                ok16 = 0;
+            }
+            if(b32[i]!=e32) {
+                testDiag("bswap32_array count=%u [%u] %08x != %08x", (unsigned)count, (unsigned)i, (unsigned)b32[i], (unsigned)e32);
+                ok32 = 0;
+            }
+        }
+    }
+    testOk(ok16, "bswap16_array");
+    testOk(ok32, "bswap32_array");
+}
+
+static void testSwap64(void)
+{
+    epicsUInt64 b64[N];
+    size_t count, i;
+    int ok = 1;
+
+    testDiag("bswap64_array() of all lengths up to %u", (unsigned)N);
+
+    for(count=0; count<=N; count++) {
+        for(i=0; i<N; i++)
+            b64[i] = 0x0102030405060708ull*i + 0x1122334455667788ull;
+        bswap64_array(b64, count);
+        for(i=0; i<N; i++) {
+            epicsUInt64 e64 = 0x0102030405060708ull*i + 0x1122334455667788ull;
+            if(i<count)
+                e64 = bswap64(e64);
+            if(b64[i]!=e64) {
+                testDiag("bswap64_array count=%u [%u] %016llx != %016llx", (unsigned)count, (unsigned)i,
+                         (unsigned long long)b64[i], (unsigned long long)e64);
+                ok = 0;
+            }
+        }
+    }
+    testOk(ok, "bswap64_array");
+    testOk1(bswap64(0x0102030405060708ull)==0x0807060504030201ull);
+}
+
+static void testBlock64(void)
+{
+    epicsUInt64 b64[N/2];
+    size_t i;
+    int ok;
+
+    testDiag("64-bit transfers");
+
+    fillmem();
+
+    testOk1(be_ioread64(mem)==0x0001020304050607ull);
+    testOk1(le_ioread64(mem)==0x0706050403020100ull);
+
+    be_ioread64_block(mem, b64, N/2);
+    for(i=0, ok=1; i<N/2; i++)
+        ok &= b64[i]==be_ioread64(mem+8*i);
+    testOk(ok, "be_ioread64_block");
+
+    for(i=0; i<N/2; i++)
+        b64[i] = 0x0102030405060708ull*(epicsUInt64)i;
+
+    le_iowrite64_block(mem, b64, N/2);
+    for(i=0, ok=1; i<N/2; i++)
+        ok &= le_ioread64(mem+8*i)==b64[i];
+    testOk(ok, "le_iowrite64_block");
+    testOk1(b64[1]==0x0102030405060708ull); /* input unchanged */
+
+    be_iowrite64(mem, 0x1122334455667788ull);
+    testOk1(mem[0]==0x11 && mem[7]==0x88);
+}
+
+static void testBlock(void)
+{
+    epicsUInt16 b16[N];
+    epicsUInt32 b32[N];
+    size_t i;
+    int ok;
+
+    testDiag("Block transfers");
+
+    fillmem();
+
+    be_ioread32_block(mem, b32, N);
+    for(i=0, ok=1; i<N; i++)
+        ok &= b32[i]==be_ioread32(mem+4*i);
+    testOk(ok, "be_ioread32_block");
+
+    le_ioread32_block(mem, b32, N);
+    for(i=0, ok=1; i<N; i++)
+        ok &= b32[i]==le_ioread32(mem+4*i);
+    testOk(ok, "le_ioread32_block");
+
+    nat_ioread32_block(mem, b32, N);
+    testOk1(memcmp(b32, mem, sizeof(b32))==0);
+
+    be_ioread16_block(mem, b16, N);
+    for(i=0, ok=1; i<N; i++)
+        ok &= b16[i]==be_ioread16(mem+2*i);
+    testOk(ok, "be_ioread16_block");
+
+    le_ioread16_block(mem, b16, N);
+    for(i=0, ok=1; i<N; i++)
+        ok &= b16[i]==le_ioread16(mem+2*i);
+    testOk(ok, "le_ioread16_block");
+
+    for(i=0; i<N; i++)
+        b32[i] = 0x01020304u*(epicsUInt32)i;
+
+    memset(mem, 0, sizeof(mem));
+    be_iowrite32_block(mem, b32, N);
+    for(i=0, ok=1; i<N; i++)
+        ok &= be_ioread32(mem+4*i)==b32[i];
+    testOk(ok, "be_iowrite32_block");
+    testOk1(b32[1]==0x01020304u); /* input unchanged */
+    testOk1(mem[4*N]==0);
+
+    le_iowrite32_block(mem, b32, N);
+    for(i=0, ok=1; i<N; i++)
+        ok &= le_ioread32(mem+4*i)==b32[i];
+    testOk(ok, "le_iowrite32_block");
+
+    for(i=0; i<N; i++)
+        b16[i] = (epicsUInt16)(0x0102u*i);
+
+    be_iowrite16_block(mem, b16, N);
+    for(i=0, ok=1; i<N; i++)
+        ok &= be_ioread16(mem+2*i)==b16[i];
+    testOk(ok, "be_iowrite16_block");
+
+    le_iowrite16_block(mem, b16, N);
+    for(i=0, ok=1; i<N; i++)
+        ok &= le_ioread16(mem+2*i)==b16[i];
+    testOk(ok, "le_iowrite16_block");
+}
+
+static void testRep(void)
+{
+    epicsUInt32 b32[N];
+    epicsUInt8 b8[4] = {1, 2, 3, 4};
+    size_t i;
+    int ok;
+
+    testDiag("Repeated access of one register");
+
+    fillmem();
+
+    be_ioread32_rep(mem+4, b32, N);
+    for(i=0, ok=1; i<N; i++)
+        ok &= b32[i]==be_ioread32(mem+4);
+    testOk(ok, "be_ioread32_rep");
+
+    for(i=0; i<N; i++)
+        b32[i] = (epicsUInt32)i;
+    le_iowrite32_rep(mem, b32, N);
+    testOk1(le_ioread32(mem)==N-1);
+    testOk1(mem[4]==4);
+
+    iowrite8_rep(mem, b8, 4);
+    testOk1(mem[0]==4 && mem[1]==0);
+}
+
+static void testRelaxed(void)
+{
+    testDiag("Relaxed single element operations");
+
+    fillmem();
+
+    testOk1(ioread8_relaxed(mem+5)==ioread8(mem+5));
+    testOk1(be_ioread16_relaxed(mem+2)==be_ioread16(mem+2));
+    testOk1(le_ioread32_relaxed(mem+4)==le_ioread32(mem+4));
+
+    be_iowrite32_relaxed(mem, 0x11223344u);
+    le_iowrite16_relaxed(mem+4, 0x5566u);
+    iowrite8_relaxed(mem+6, 0x77u);
+    devlib_wbarr();
+    testOk1(be_ioread32(mem)==0x11223344u);
+    testOk1(le_ioread16(mem+4)==0x5566u && mem[6]==0x77);
+}
+
+#define STR2(X) #X
+#define STR(X) STR2(X)
+
+static void testBarriers(void)
+{
+    const char *rb = STR(devlib_rbarr()),
+               *wb = STR(devlib_wbarr());
+
+    testDiag("Barriers of this module, whichever epicsMMIO.h is in use");
+    testDiag("devlib_rbarr() -> %s", rb);
+    testDiag("devlib_wbarr() -> %s", wb);
+
+#if defined(__GNUC__)
+    testOk(strstr(rb, "lfence") || strstr(rb, "dsb ld") || strstr(rb, "sync"),
+           "devlib_rbarr() is a load barrier");
+    testOk(strstr(wb, "sfence") || strstr(wb, "dsb st") || strstr(wb, "sync"),
+           "devlib_wbarr() is a store barrier");
+#else
+    testSkip(2, "barrier instructions only known for GCC");
+#endif
+
+    devlib_rbarr();
+    devlib_wbarr();
+    devlib_rwbarr();
+    testPass("barriers execute");
+}
+
+static void testMemcpy(void)
+{
+    epicsUInt8 buf[64], expect[64];
+    int ok = 1;
+    unsigned off, len, i;
+
+    testDiag("memcpy_fromio/toio with all alignments");
+
+    for(off=0; off<4; off++) {
+        for(len=0; len<20; len++) {
+            fillmem();
+            memset(buf, 0xff, sizeof(buf));
+            memcpy_fromio(buf, mem+off, len);
+            for(i=0; i<len; i++)
+                ok &= buf[i]==(epicsUInt8)(off+i);
+            ok &= buf[len]==0xff;
+
+            for(i=0; i<len; i++)
+                buf[i] = (epicsUInt8)(0x80+i);
+            memcpy(expect, mem, sizeof(expect));
+            memcpy(expect+off, buf, len);
+            memcpy_toio(mem+off, buf, len);
+            ok &= memcmp(mem, expect, sizeof(expect))==0;
+        }
+    }
+    testOk(ok, "memcpy_fromio/toio");
+}
+
+MAIN(devLibMMIOTest)
+{
+    testPlan(34);
+    testSwap();
+    testSwap64();
+    testBlock();
+    testBlock64();
+    testRep();
+    testRelaxed();
+    testBarriers();
+    testMemcpy();
+    return testDone();
+}
@@ -0,0 +1,300 @@
+/*
+ * Time enumeration and search of the Linux PCI bus implementation
+ * against synthetic sysfs trees of increasing size.
+ *
+ * pcienumbench [-t <threads>] [-k] [N ...]
+ * pcienumbench -g <dir> <N>
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <ftw.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <epicsGetopt.h>
+#include <devLibPCI.h>
+#include <devLibPCIImpl.h>
+
+static const
+epicsPCIID allids[] = {
+    DEVPCI_DEVICE_ANY(),
+    DEVPCI_END
+};
+
+static const
+epicsPCIID noids[] = {
+    DEVPCI_DEVICE_VENDOR(0xffff, 0xffff),
+    DEVPCI_END
+};
+
+/* device i is at 0000:BB:DD.0 in slot "i" */
+#define DEV_BUS(i) (1u + (i)/32u)
+#define DEV_DEV(i) ((i)%32u)
+
+static
+int usage(int argc, char *argv[])
+{
+    (void)argc;
+    fprintf(stderr, "Usage: %s [-h] [-t <threads>] [-k] [N ...]\n"
+                    "       %s -g <dir> <N>\n"
+                    "\n"
+                    " -t <threads>  Set devPCIEnumThreads\n"
+                    " -k            Keep generated trees\n"
+                    " -g <dir>      Only generate a tree with N devices in <dir>\n",
+            argv[0], argv[0]);
+    return 1;
+}
+
+static
+int writefile(const char *dir, const char *name, const char *content)
+{
+    char path[PATH_MAX];
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    if(!(fp=fopen(path, "w"))) {
+        fprintf(stderr, "Can't create %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    fputs(content, fp);
+    return fclose(fp) ? 1 : 0;
+}
+
+static
+int mkdirs(const char *root, const char *rel)
+{
+    char path[PATH_MAX], *sep;
+
+    snprintf(path, sizeof(path), "%s/%s", root, rel);
+    for(sep=strchr(path+strlen(root)+1, '/'); ; sep=strchr(sep+1, '/')) {
+        if(sep) *sep = '\0';
+        if(mkdir(path, 0755) && errno!=EEXIST) {
+            fprintf(stderr, "Can't create %s: %s\n", path, strerror(errno));
+            return 1;
+        }
+        if(!sep) break;
+        *sep = '/';
+    }
+    return 0;
+}
+
+/* Create <root>/sys/bus/pci/devices/ and slots/ with N devices */
+static
+int generate(const char *root, unsigned ndevs)
+{
+    char dir[PATH_MAX], buf[512];
+    unsigned i, b;
+
+    if(mkdir(root, 0755) && errno!=EEXIST) {
+        fprintf(stderr, "Can't create %s: %s\n", root, strerror(errno));
+        return 1;
+    }
+    if(mkdirs(root, "sys/bus/pci/devices") || mkdirs(root, "sys/bus/pci/slots"))
+        return 1;
+
+    for(i=0; i<ndevs; i++) {
+        size_t pos = 0;
+
+        snprintf(dir, sizeof(dir), "%s/sys/bus/pci/devices/0000:%02x:%02x.0", root, DEV_BUS(i), DEV_DEV(i));
+        if(mkdir(dir, 0755)) {
+            fprintf(stderr, "Can't create %s: %s\n", dir, strerror(errno));
+            return 1;
+        }
+
+        if(writefile(dir, "vendor", "0x10ee\n") ||
+                writefile(dir, "device", "0x7011\n") ||
+                writefile(dir, "subsystem_vendor", "0x1a3e\n"))
+            return 1;
+
+        snprintf(buf, sizeof(buf), "0x%04x\n", i&0xffff);
+        if(writefile(dir, "subsystem_device", buf) ||
+                writefile(dir, "class", "0xff0000\n"))
+            return 1;
+
+        snprintf(buf, sizeof(buf), "%u\n", 16+i%200);
+        if(writefile(dir, "irq", buf))
+            return 1;
+
+        /* BAR0 of 64KB, then 5 unused BARs and ROM */
+        for(b=0; b<7; b++) {
+            unsigned long long start = b==0 ? 0xf0000000ull+0x10000ull*i : 0;
+            pos += snprintf(buf+pos, sizeof(buf)-pos, "0x%016llx 0x%016llx 0x%016llx\n",
+                            start, start ? start+0xffff : 0ull, start ? 0x40200ull : 0ull);
+        }
+        if(writefile(dir, "resource", buf))
+            return 1;
+
+        snprintf(dir, sizeof(dir), "%s/sys/bus/pci/slots/%u", root, i);
+        if(mkdir(dir, 0755)) {
+            fprintf(stderr, "Can't create %s: %s\n", dir, strerror(errno));
+            return 1;
+        }
+        snprintf(buf, sizeof(buf), "0000:%02x:%02x\n", DEV_BUS(i), DEV_DEV(i));
+        if(writefile(dir, "address", buf))
+            return 1;
+    }
+    return 0;
+}
+
+static
+int rmentry(const char *path, const struct stat *sb, int flag, struct FTW *ftw)
+{
+    (void)sb; (void)flag; (void)ftw;
+    return remove(path);
+}
+
+static
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static
+int nothing(void *arg, const epicsPCIDevice *dev)
+{
+    (void)arg; (void)dev;
+    return 0;
+}
+
+#define NSEARCH 1000
+
+/* In a child process, since the PCI bus can only be initialized once */
+static
+int bench(const char *root, unsigned ndevs)
+{
+    const epicsPCIDevice *dev;
+    char spec[32];
+    double T0, Tinit, Tbdf, Tslot, Tshow;
+    unsigned i;
+    int devnull, saved;
+
+    setenv("DEVLIB2_PCI_ROOT", root, 1);
+    unsetenv("DEVLIB2_PCI_CACHE");
+
+    devLibPCIRegisterBaseDefault();
+
+    T0 = now();
+    if(devPCIFindCB(noids, &nothing, NULL, 0))
+        return 1;
+    Tinit = now()-T0;
+
+    snprintf(spec, sizeof(spec), "%x:%x.0", DEV_BUS(ndevs-1), DEV_DEV(ndevs-1));
+    T0 = now();
+    for(i=0; i<NSEARCH; i++) {
+        if(devPCIFindSpec(allids, spec, &dev, 0)) {
+            fprintf(stderr, "Failed to find %s\n", spec);
+            return 1;
+        }
+    }
+    Tbdf = (now()-T0)/NSEARCH;
+
+    snprintf(spec, sizeof(spec), "slot=%u", ndevs-1);
+    T0 = now();
+    for(i=0; i<NSEARCH; i++) {
+        if(devPCIFindSpec(allids, spec, &dev, 0)) {
+            fprintf(stderr, "Failed to find %s\n", spec);
+            return 1;
+        }
+    }
+    Tslot = (now()-T0)/NSEARCH;
+
+    fflush(stdout);
+    saved = dup(1);
+    devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, 1);
+    T0 = now();
+    devPCIShow(0, 0, 0, 0);
+    fflush(stdout);
+    Tshow = now()-T0;
+    dup2(saved, 1);
+    close(devnull);
+    close(saved);
+
+    printf("%8u %12.3f %12.2f %12.2f %12.3f\n", ndevs,
+           Tinit*1e3, Tbdf*1e6, Tslot*1e6, Tshow*1e3);
+    fflush(stdout);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static const unsigned defsizes[] = {10, 100, 1000, 5000};
+    const char *genonly = NULL;
+    int opt, keep = 0, ret = 0, i, nsizes;
+
+    while ((opt=getopt(argc, argv, "hkt:g:"))!=-1) {
+        switch(opt) {
+        case 'k':
+            keep = 1;
+            break;
+        case 't':
+            devPCIEnumThreads = atoi(optarg);
+            break;
+        case 'g':
+            genonly = optarg;
+            break;
+        case 'h':
+            return usage(argc, argv);
+        default:
+            fprintf(stderr, "Unknown argument '%c'\n", opt);
+            return usage(argc, argv);
+        }
+    }
+    nsizes = argc-optind;
+
+    if(genonly) {
+        if(nsizes!=1)
+            return usage(argc, argv);
+        return generate(genonly, atoi(argv[optind]));
+    }
+
+    printf("# devPCIEnumThreads=%d\n", devPCIEnumThreads);
+    printf("# %6s %12s %12s %12s %12s\n", "devices", "init (ms)", "BDF (us)", "slot (us)", "show (ms)");
+    fflush(stdout);
+
+    for(i=0; i<(nsizes ? nsizes : (int)NELEMENTS(defsizes)); i++) {
+        unsigned ndevs = nsizes ? (unsigned)atoi(argv[optind+i]) : defsizes[i];
+        char root[] = "/tmp/pcienumbench.XXXXXX";
+        pid_t pid;
+        int sts = 0;
+
+        if(ndevs<1 || ndevs>32u*255u) {
+            fprintf(stderr, "Device count %u out of range\n", ndevs);
+            return 1;
+        }
+
+        if(!mkdtemp(root)) {
+            perror("mkdtemp");
+            return 1;
+        }
+
+        if(generate(root, ndevs)) {
+            ret = 1;
+
+        } else if((pid=fork())==0) {
+            _exit(bench(root, ndevs));
+
+        } else if(pid<0 || waitpid(pid, &sts, 0)<0 || !WIFEXITED(sts) || WEXITSTATUS(sts)) {
+            fprintf(stderr, "Benchmark of %u devices failed\n", ndevs);
+            ret = 1;
+        }
+
+        if(keep)
+            printf("# kept %s\n", root);
+        else
+            nftw(root, &rmentry, 16, FTW_DEPTH|FTW_PHYS);
+    }
+
+    return ret;
+}
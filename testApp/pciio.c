@@ -7,6 +7,7 @@
 #include <epicsMMIO.h>
 #include <devLibPCI.h>
 #include <devLibPCIImpl.h>
+#include <devLibMMIO.h>
 
 int verbose=0;
 
@@ -30,6 +31,7 @@ int main(int argc, char *argv[])
     volatile void *base;
     int width = 32;
     epicsUInt32 len = 0,
+                maplen,
                 start = 0,
                 count = 0;
     FILE *io = stdout;
@@ -78,14 +80,6 @@ int main(int argc, char *argv[])
         fprintf(stderr, "Found '%s'\n", argv[optind]);
     }
 
-    ret = devPCIToLocalAddr(dev, bar, &base, 0);
-    if(ret) {
-        fprintf(stderr, "Failed to map bar %d\n", bar);
-        return 1;
-    } else if(verbose) {
-        fprintf(stderr, "Mapped bar %d to %p\n", bar, base);
-    }
-
     ret = devPCIBarLen(dev, bar, &len);
     if(ret) {
         fprintf(stderr, "Failed to find length of bar %d\n", bar);
@@ -94,8 +88,27 @@ int main(int argc, char *argv[])
         fprintf(stderr, "bar %d length %u\n", bar, (unsigned)len);
     }
 
-    if(count>0 && count<len)
+    if(start>=len) {
+        fprintf(stderr, "Start %u beyond end of bar %d\n", (unsigned)start, bar);
+        return 1;
+    }
+    len -= start;
+    /* whole words, unless this would go past the end of the bar */
+    maplen = len;
+    if(count>0 && count<len) {
         len = count;
+        if(maplen > ((len+3u)&~3u))
+            maplen = (len+3u)&~3u;
+    }
+
+    /* only the range to be accessed */
+    ret = devPCIMapWindow(dev, bar, start, maplen, &base, 0);
+    if(ret) {
+        fprintf(stderr, "Failed to map bar %d\n", bar);
+        return 1;
+    } else if(verbose) {
+        fprintf(stderr, "Mapped bar %d from %u to %p\n", bar, (unsigned)start, base);
+    }
 
     width /= 8;
     if(width<=0 || width>4) {
@@ -104,7 +117,8 @@ int main(int argc, char *argv[])
     }
 
     if(strcmp("read", argv[optind+1])==0) {
-        epicsUInt32 i = start, end = start+len;
+        epicsUInt32 buf[1024];
+        epicsUInt32 i = 0, end = maplen/4u, nbytes = len;
         if(nargs>=3) {
             io = fopen(argv[optind+2], "wb");
             if(!io) {
@@ -117,14 +131,25 @@ int main(int argc, char *argv[])
             fprintf(stderr, "Read %u bytes\n", (unsigned)len);
         }
 
-        for(; i<end; i+=4) {
-            epicsUInt32 val = le_ioread32(((volatile char*)base)+i);
-            fwrite(&val, 4, 1, io);
+        while(i<end && nbytes) {
+            epicsUInt32 n = end-i < NELEMENTS(buf) ? end-i : NELEMENTS(buf);
+            le_ioread32_block(((volatile char*)base)+4u*i, buf, n);
+            n = 4u*n < nbytes ? 4u*n : nbytes;
+            fwrite(buf, 1, n, io);
+            nbytes -= n;
+            i += (n+3u)/4u;
+        }
+        /* partial word at the end of the bar */
+        for(i*=4u; nbytes; i++, nbytes--) {
+            epicsUInt8 b = ioread8(((volatile char*)base)+i);
+            fwrite(&b, 1, 1, io);
         }
 
+        (void)devPCIUnmap(dev, bar, base);
         return 0;
     } else {
         fprintf(stderr, "Unknown command '%s'\n", argv[optind+1]);
+        (void)devPCIUnmap(dev, bar, base);
         return 1;
     }
 }
@@ -0,0 +1,155 @@
+/*
+ * Exercise the simulated PCI bus driver.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsMMIO.h>
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include "devLibPCI.h"
+#include "devLibPCIImpl.h"
+
+static const epicsPCIID simdev[] = {
+    DEVPCI_DEVICE_VENDOR(0x7011, 0x10ee),
+    DEVPCI_END
+};
+
+static epicsEventId irqevt;
+static int irqcount;
+
+static void simisr(void *raw)
+{
+    (void)raw;
+    irqcount++;
+    epicsEventSignal(irqevt);
+}
+
+MAIN(pcisimtest)
+{
+    const epicsPCIDevice *dev = NULL;
+    volatile void *bar0 = NULL, *bar0b = NULL;
+    epicsUInt32 len = 0;
+    epicsUInt64 len64 = 0;
+    epicsUInt16 val16 = 0;
+    FILE *fp;
+
+    testPlan(45);
+
+    fp = fopen("pcisimtest.txt", "w");
+    if(!fp)
+        testAbort("Can't write description file");
+    fprintf(fp, "# test device\n"
+                "\n"
+                "2:1.0 vendor=0x10ee device=0x7011 subvendor=0x1a3e subdevice=0x1234 class=0xff0000 bar0=0x1000 slot=4\n");
+    fclose(fp);
+
+    devLibPCIRegisterSim();
+    testOk1(devLibPCISimLoad("pcisimtest.txt")==0);
+    testOk1(devLibPCIUse("sim")==0);
+
+    testOk1(devPCIFindSpec(simdev, "slot=4", &dev, 0)==0);
+    if(!dev)
+        testAbort("Device not found");
+    testOk(dev->bus==2 && dev->device==1 && dev->function==0,
+           "found %x:%x.%x", dev->bus, dev->device, dev->function);
+    testOk1(dev->id.sub_vendor==0x1a3e);
+
+    testOk1(devPCIConfigRead16(dev, 0, &val16)==0 && val16==0x10ee);
+    testOk1(devPCIConfigRead16(dev, 0x2e, &val16)==0 && val16==0x1234);
+
+    testOk1(devPCIBarLen(dev, 0, &len)==0 && len==0x1000);
+    testOk1(devPCIBarLen64(dev, 0, &len64)==0 && len64==0x1000);
+    testOk1(devPCIToLocalAddr(dev, 0, &bar0, 0)==0 && bar0);
+    testOk1(devPCIToLocalAddr(dev, 1, &bar0b, 0)!=0);
+    testOk1(devPCIMapWindow(dev, 0, 0x100, 0x10, &bar0b, 0)==0 && bar0b==(volatile char*)bar0+0x100);
+    testOk1(devPCIUnmap(dev, 0, bar0b)==0);
+    testOk1(devPCIMapWindow(dev, 0, 0xff0, 0x20, &bar0b, 0)==S_dev_badArgument);
+    testOk1(devPCIMapWindow(dev, 0, 0, 0, &bar0b, 0)==S_dev_badArgument);
+
+    nat_iowrite32(bar0, 0x12345678);
+    testOk1(nat_ioread32(bar0)==0x12345678);
+
+    testDiag("Configuration space block read and capabilities");
+    {
+        epicsUInt8 blk[6];
+        unsigned off = 0;
+
+        testOk1(devPCIConfigReadBlock(dev, 0x2a, blk, sizeof(blk))==0
+                && blk[2]==0x3e && blk[3]==0x1a && blk[4]==0x34 && blk[5]==0x12);
+        testOk1(devPCIConfigReadBlock(dev, 0xffe, blk, 4)==S_dev_badArgument);
+
+        /* PM at 0x40 -> PCIe at 0x50.  AER at 0x100 -> DSN at 0x140 */
+        devPCIConfigWrite16(dev, 0x06, 0x0010);
+        devPCIConfigWrite8(dev, 0x34, 0x40);
+        devPCIConfigWrite16(dev, 0x40, 0x5001);
+        devPCIConfigWrite16(dev, 0x50, 0x0010);
+        devPCIConfigWrite32(dev, 0x100, 0x14010001);
+        devPCIConfigWrite32(dev, 0x140, 0x00010003);
+
+        testOk1(devPCIFindCapability(dev, DEVPCI_CAP_EXP, &off)==0 && off==0x50);
+        testOk1(devPCIFindCapability(dev, DEVPCI_CAP_PM, &off)==0 && off==0x40);
+        testOk1(devPCIFindCapability(dev, DEVPCI_CAP_MSI, &off)==S_dev_noDevice);
+        testOk1(devPCIFindExtCapability(dev, DEVPCI_EXT_CAP_DSN, &off)==0 && off==0x140);
+        testOk1(devPCIFindExtCapability(dev, DEVPCI_EXT_CAP_AER, &off)==0 && off==0x100);
+        testOk1(devPCIFindExtCapability(dev, DEVPCI_CAP_EXP, &off)==S_dev_noDevice);
+
+        /* list is remembered */
+        devPCIConfigWrite8(dev, 0x34, 0);
+        testOk1(devPCIFindCapability(dev, DEVPCI_CAP_EXP, &off)==0 && off==0x50);
+    }
+
+    testDiag("Interrupt injection");
+    irqevt = epicsEventMustCreate(epicsEventEmpty);
+
+    testOk1(devPCIConnectInterrupt(dev, &simisr, NULL, 0)==0);
+    testOk1(devLibPCISimInterrupt(dev)==0);
+    testOk1(epicsEventWaitWithTimeout(irqevt, 5.0)==epicsEventOK && irqcount==1);
+
+    testOk1(devPCIDisconnectInterrupt(dev, &simisr, NULL)==0);
+    testOk1(devPCIDisconnectInterrupt(dev, &simisr, NULL)!=0);
+
+    testDiag("Lookup of devices added after init");
+    fp = fopen("pcisimtest.txt", "w");
+    if(!fp)
+        testAbort("Can't write description file");
+    fprintf(fp, "2:2.0 vendor=0x10ee device=0x7011 slot=5\n"
+                "2:2.1 vendor=0x10ee device=0x7011 slot=5\n");
+    fclose(fp);
+    testOk1(devLibPCISimLoad("pcisimtest.txt")==0);
+
+    {
+        const epicsPCIDevice *dev2 = NULL;
+        static const epicsPCIID otherdev[] = {
+            DEVPCI_DEVICE_VENDOR(0x1234, 0x10ee),
+            DEVPCI_END
+        };
+
+        testOk1(devPCIFindDBDF(simdev, 0, 2, 2, 1, &dev2, 0)==0 && dev2 && dev2->function==1);
+        testOk1(devPCIFindSpec(simdev, "slot=5", &dev2, 0)==0 && dev2->device==2 && dev2->function==0);
+        testOk1(devPCIFindSpec(simdev, "slot=5 instance=2", &dev2, 0)==0 && dev2->function==1);
+        testOk1(devPCIFindDBDF(otherdev, 0, 2, 1, 0, &dev2, 0)==S_dev_noDevice);
+
+        testDiag("Match by identity");
+        testOk1(devPCIFindSpec(simdev, "sub=1a3e:1234", &dev2, 0)==0 && dev2==dev);
+        testOk1(devPCIFindSpec(simdev, "sub=0x1a3e", &dev2, 0)==0 && dev2==dev);
+        testOk1(devPCIFindSpec(simdev, "sub=1a3e:1235", &dev2, 0)==S_dev_noDevice);
+        testOk1(devPCIFindSpec(simdev, "vendor=10ee device=7011 instance=3", &dev2, 0)==0
+                && dev2->device==2 && dev2->function==1);
+        testOk1(devPCIFindSpec(simdev, "class=ff", &dev2, 0)==0 && dev2==dev);
+        testOk1(devPCIFindSpec(simdev, "class=ff01", &dev2, 0)==S_dev_noDevice);
+        testOk1(devPCIFindSpec(simdev, "slot=4 class=0xff0000", &dev2, 0)==0 && dev2==dev);
+        testOk1(devPCIFindSpec(simdev, "2:2.1 device=7012", &dev2, 0)==S_dev_noDevice);
+        testOk1(devPCIFindSpec(simdev, "vendor=10000", &dev2, 0)==S_dev_badArgument);
+        /* same string again */
+        testOk1(devPCIFindSpec(simdev, "sub=1a3e:1234", &dev2, 0)==0 && dev2==dev);
+    }
+
+    remove("pcisimtest.txt");
+
+    return testDone();
+}
@@ -0,0 +1,340 @@
+/*
+ * Linux PCI enumeration from a synthetic sysfs tree ($DEVLIB2_PCI_ROOT).
+ * The enumeration cache ($DEVLIB2_PCI_CACHE), and devPCIRescan().
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <ftw.h>
+
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include "devLibPCI.h"
+#include "devLibPCIImpl.h"
+
+static const
+epicsPCIID allids[] = {
+    DEVPCI_DEVICE_ANY(),
+    DEVPCI_END
+};
+
+static const char * const sysdirs[] = {
+    "sys", "sys/bus", "sys/bus/pci", "sys/bus/pci/devices", "sys/bus/pci/slots",
+};
+
+static char root[] = "/tmp/pcisysfstest.XXXXXX";
+static char cachefile[PATH_MAX];
+
+static
+int writefile(const char *dir, const char *name, const char *content)
+{
+    char path[PATH_MAX];
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    if(!(fp=fopen(path, "w"))) {
+        testDiag("Can't create %s: %s", path, strerror(errno));
+        return 1;
+    }
+    fputs(content, fp);
+    return fclose(fp) ? 1 : 0;
+}
+
+static
+void devdir(char *buf, size_t len, unsigned i)
+{
+    snprintf(buf, len, "%s/sys/bus/pci/devices/0000:01:%02x.0", root, i);
+}
+
+/* Device i at 0000:01:ii.0 in slot "i", with BAR0 of 'bar0len' bytes */
+static
+int adddev(unsigned i, unsigned bar0len)
+{
+    char dir[PATH_MAX], buf[512];
+    size_t pos = 0;
+    unsigned b;
+
+    devdir(dir, sizeof(dir), i);
+    if(mkdir(dir, 0755)) {
+        testDiag("Can't create %s: %s", dir, strerror(errno));
+        return 1;
+    }
+
+    snprintf(buf, sizeof(buf), "0x%04x\n", i);
+    if(writefile(dir, "vendor", "0x10ee\n") ||
+            writefile(dir, "device", "0x7011\n") ||
+            writefile(dir, "subsystem_vendor", "0x1a3e\n") ||
+            writefile(dir, "subsystem_device", buf) ||
+            writefile(dir, "class", "0xff0000\n") ||
+            writefile(dir, "irq", "16\n") ||
+            writefile(dir, "config", "\xee\x10\x11\x70"))
+        return 1;
+
+    for(b=0; b<7; b++) {
+        unsigned long long start = b==0 ? 0xf0000000ull+0x100000ull*i : 0;
+        pos += snprintf(buf+pos, sizeof(buf)-pos, "0x%016llx 0x%016llx 0x%016llx\n",
+                        start, start ? start+bar0len-1 : 0ull, start ? 0x40200ull : 0ull);
+    }
+    if(writefile(dir, "resource", buf))
+        return 1;
+
+    snprintf(buf, sizeof(buf), "%s/driver", dir);
+    if(symlink("../../../../bus/pci/drivers/testdrv", buf)) {
+        testDiag("Can't create %s: %s", buf, strerror(errno));
+        return 1;
+    }
+
+    snprintf(dir, sizeof(dir), "%s/sys/bus/pci/slots/%u", root, i);
+    if(mkdir(dir, 0755)) {
+        testDiag("Can't create %s: %s", dir, strerror(errno));
+        return 1;
+    }
+    snprintf(buf, sizeof(buf), "0000:01:%02x\n", i);
+    return writefile(dir, "address", buf);
+}
+
+static
+int rmentry(const char *path, const struct stat *sb, int flag, struct FTW *ftw)
+{
+    (void)sb; (void)flag; (void)ftw;
+    return remove(path);
+}
+
+static
+int count(void *arg, const epicsPCIDevice *dev)
+{
+    (void)dev;
+    (*(unsigned*)arg)++;
+    return 0;
+}
+
+/* In a child process, since the PCI bus can only be initialized once.
+ * Check that device 0 has the expected driver and BAR0 length.
+ */
+static
+int checkInit(unsigned ndevs, const char *driver, epicsUInt64 bar0len)
+{
+    const epicsPCIDevice *dev = NULL;
+    epicsUInt64 len = 0;
+    unsigned n = 0;
+
+    devLibPCIRegisterBaseDefault();
+
+    if(devPCIFindCB(allids, &count, &n, 0) || n!=ndevs) {
+        fprintf(stderr, "found %u devices, not %u\n", n, ndevs);
+        return 1;
+    }
+    if(devPCIFindSpec(allids, "1:0.0", &dev, 0)) {
+        fprintf(stderr, "device 0 not found\n");
+        return 1;
+    }
+    if(!dev->driver || strcmp(dev->driver, driver)!=0) {
+        fprintf(stderr, "driver '%s' not '%s'\n", dev->driver ? dev->driver : "", driver);
+        return 1;
+    }
+    if(devPCIBarLen64(dev, 0, &len) || len!=bar0len) {
+        fprintf(stderr, "BAR0 length %llx not %llx\n", (unsigned long long)len, (unsigned long long)bar0len);
+        return 1;
+    }
+    return 0;
+}
+
+static
+int childInit(unsigned ndevs, const char *driver, epicsUInt64 bar0len)
+{
+    pid_t pid;
+    int sts = 0;
+
+    fflush(stdout);
+    fflush(stderr);
+    if((pid=fork())==0)
+        _exit(checkInit(ndevs, driver, bar0len));
+
+    return pid>0 && waitpid(pid, &sts, 0)==pid && WIFEXITED(sts) && WEXITSTATUS(sts)==0;
+}
+
+/* Replace each "testdrv" in the cache file with "cachdrv" */
+static
+int tamperCache(void)
+{
+    char buf[4096], *p;
+    size_t n;
+    FILE *fp;
+
+    if(!(fp=fopen(cachefile, "r")))
+        return 1;
+    n = fread(buf, 1, sizeof(buf)-1, fp);
+    fclose(fp);
+    buf[n] = '\0';
+
+    for(p=buf; (p=strstr(p, "testdrv"))!=NULL; p+=7)
+        memcpy(p, "cachdrv", 7);
+
+    if(!(fp=fopen(cachefile, "w")))
+        return 1;
+    fwrite(buf, 1, n, fp);
+    return fclose(fp) ? 1 : 0;
+}
+
+static
+void testCache(void)
+{
+    char dir[PATH_MAX], buf[512];
+    size_t pos = 0;
+    unsigned b;
+
+    testDiag("Enumeration cache");
+
+    testOk(childInit(3, "testdrv", 0x10000), "enumerate sysfs");
+    testOk(access(cachefile, R_OK)==0, "cache written");
+
+    testOk1(tamperCache()==0);
+    testOk(childInit(3, "cachdrv", 0x10000), "warm start from cache");
+
+    /* re-assign BAR0 of device 0 */
+    for(b=0; b<7; b++) {
+        unsigned long long start = b==0 ? 0xf0000000ull : 0;
+        pos += snprintf(buf+pos, sizeof(buf)-pos, "0x%016llx 0x%016llx 0x%016llx\n",
+                        start, start ? start+0x1ffff : 0ull, start ? 0x40200ull : 0ull);
+    }
+    devdir(dir, sizeof(dir), 0);
+    testOk1(writefile(dir, "resource", buf)==0);
+    testOk(childInit(3, "testdrv", 0x20000), "changed resource forces a fresh scan");
+}
+
+#define MAXEVENTS 8
+
+static struct {
+    const epicsPCIDevice *dev;
+    unsigned device;
+    devPCIHotplugEvent event;
+} events[MAXEVENTS];
+static unsigned nevents;
+
+static
+void notify(void *arg, const epicsPCIDevice *dev, devPCIHotplugEvent event)
+{
+    (void)arg;
+    if(nevents<MAXEVENTS) {
+        events[nevents].dev = dev;
+        events[nevents].device = dev->id.device;
+        events[nevents].event = event;
+    }
+    nevents++;
+}
+
+static
+const epicsPCIDevice *find(const char *spec)
+{
+    const epicsPCIDevice *dev = NULL;
+    return devPCIFindSpec(allids, spec, &dev, 0) ? NULL : dev;
+}
+
+static
+int rescan(unsigned expect)
+{
+    nevents = 0;
+    if(devPCIRescan()) {
+        testDiag("devPCIRescan() fails");
+        return 0;
+    }
+    if(nevents!=expect)
+        testDiag("%u events, not %u", nevents, expect);
+    return nevents==expect;
+}
+
+/* expect removal of 'old' followed by the addition of a new device at the same address */
+static
+void testReplaced(const epicsPCIDevice *old, unsigned device)
+{
+    testOk(events[0].event==devPCIHotplugRemove && events[0].dev==old, "old device removed");
+    testOk(events[1].event==devPCIHotplugAdd && events[1].dev!=old
+           && events[1].device==device, "new device added");
+}
+
+static
+void testRescan(void)
+{
+    const epicsPCIDevice *dev, *old;
+    char dir[PATH_MAX], path[PATH_MAX], tmp[PATH_MAX];
+
+    testDiag("Rescan");
+
+    devLibPCIRegisterBaseDefault();
+    testOk1(devPCIHotplugRegister(&notify, NULL)==0);
+    testOk1(find("1:0.0")!=NULL);
+
+    testOk(rescan(0), "no change");
+
+    testOk1(adddev(3, 0x10000)==0);
+    testOk(rescan(1) && events[0].event==devPCIHotplugAdd, "device 3 added");
+    testOk1((dev=find("1:3.0"))!=NULL && events[0].dev==dev);
+    testOk(find("slot=3")==dev, "slot of new device");
+
+    old = find("1:2.0");
+    devdir(dir, sizeof(dir), 2);
+    testOk1(nftw(dir, &rmentry, 16, FTW_DEPTH|FTW_PHYS)==0);
+    testOk(rescan(1) && events[0].event==devPCIHotplugRemove && events[0].dev==old,
+           "device 2 removed");
+    testOk1(find("1:2.0")==NULL);
+
+    /* re-created config space, same IDs */
+    old = find("1:1.0");
+    devdir(dir, sizeof(dir), 1);
+    snprintf(path, sizeof(path), "%s/config", dir);
+    snprintf(tmp, sizeof(tmp), "%s/config.new", dir);
+    testOk1(writefile(dir, "config.new", "\xee\x10\x11\x70")==0 && rename(tmp, path)==0);
+    testOk(rescan(2), "device 1 replaced");
+    testReplaced(old, 0x7011);
+    testOk1((dev=find("1:1.0"))!=NULL && dev!=old);
+
+    /* different device ID */
+    old = find("1:0.0");
+    devdir(dir, sizeof(dir), 0);
+    testOk1(writefile(dir, "device", "0x7012\n")==0);
+    testOk(rescan(2), "device 0 replaced");
+    testReplaced(old, 0x7012);
+    testOk1((dev=find("1:0.0"))!=NULL && dev->id.device==0x7012);
+
+    testOk1(devPCIHotplugUnregister(&notify, NULL)==0);
+}
+
+MAIN(pcisysfstest)
+{
+    unsigned i;
+
+    testPlan(27);
+
+    if(!mkdtemp(root))
+        testAbort("mkdtemp: %s", strerror(errno));
+    for(i=0; i<sizeof(sysdirs)/sizeof(sysdirs[0]); i++) {
+        char dir[PATH_MAX];
+        snprintf(dir, sizeof(dir), "%s/%s", root, sysdirs[i]);
+        if(mkdir(dir, 0755))
+            testAbort("Can't create %s: %s", dir, strerror(errno));
+    }
+    for(i=0; i<3; i++) {
+        if(adddev(i, 0x10000))
+            testAbort("Can't create synthetic sysfs tree in %s", root);
+    }
+
+    snprintf(cachefile, sizeof(cachefile), "%s/cache", root);
+    setenv("DEVLIB2_PCI_ROOT", root, 1);
+    setenv("DEVLIB2_PCI_CACHE", cachefile, 1);
+
+    testCache();
+    testRescan();
+
+    nftw(root, &rmentry, 16, FTW_DEPTH|FTW_PHYS);
+
+    return testDone();
+}